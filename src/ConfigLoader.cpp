@@ -4,7 +4,9 @@
 
 #include <EssaUtil/GenericParser.hpp>
 #include <EssaUtil/Stream/File.hpp>
+#include <cmath>
 #include <iostream>
+#include <random>
 #include <sstream>
 
 Config::ErrorOr<Config::Config> ConfigLoader::load(std::string const& filename, World&) {
@@ -176,6 +178,69 @@ Config::ErrorOr<Config::Statement> ConfigLoader::parse_statement() {
         }
         return Util::ParseError { "orbiting_planet must define apoapsis+periapsis or major_axis+eccentrity", { m_reader.location(), {} } };
     }
+    if (keyword == "belt") {
+        PropertyMap properties = TRY(read_properties());
+        Config::Belt belt;
+        belt.around = Util::UString { properties.get("around") };
+        belt.direction = properties.get("direction") == "left" ? Config::Direction::CounterClockwise : Config::Direction::Clockwise;
+        belt.count = TRY(properties.get_int("count", 1000));
+        belt.inner_radius = TRY(properties.get_distance("inner_radius"));
+        belt.outer_radius = TRY(properties.get_distance("outer_radius"));
+        belt.max_eccentricity = TRY(properties.get_double("max_eccentricity"));
+        belt.max_inclination = Util::Angle::degrees(TRY(properties.get_double("max_inclination")));
+        belt.color = { TRY(properties.get_byte("colorr", 255)), TRY(properties.get_byte("colorg", 255)), TRY(properties.get_byte("colorb", 255)) };
+        belt.trail_count = TRY(properties.get_int("trail_count", 0));
+        belt.trail_length = TRY(properties.get_int("trail_length", 600));
+        belt.seed = TRY(properties.get_int("seed", 0));
+        if (belt.count < 0 || belt.trail_count < 0 || belt.trail_length < 0)
+            return Util::ParseError { "count, trail_count and trail_length must be non-negative", { m_reader.location(), {} } };
+        if (belt.inner_radius.value() <= 0 || belt.outer_radius.value() < belt.inner_radius.value())
+            return Util::ParseError { "belt must have 0 < inner_radius <= outer_radius", { m_reader.location(), {} } };
+        if (belt.max_eccentricity < 0 || belt.max_eccentricity >= 1)
+            return Util::ParseError { "max_eccentricity must be in range [0, 1)", { m_reader.location(), {} } };
+        return belt;
+    }
+    if (keyword == "simulation") {
+        PropertyMap properties = TRY(read_properties());
+        Config::Simulation simulation;
+        if (properties.contains("gravity_solver")) {
+            auto name = properties.get("gravity_solver");
+            simulation.gravity_solver = Gravity::solver_from_string(name.encode());
+            if (!simulation.gravity_solver)
+                return Util::ParseError { "Invalid gravity_solver: '" + name.encode() + "'", { m_reader.location(), {} } };
+        }
+        if (properties.contains("opening_angle"))
+            simulation.opening_angle = TRY(properties.get_double("opening_angle"));
+        if (properties.contains("expansion_order"))
+            simulation.expansion_order = TRY(properties.get_int("expansion_order", Gravity::FastMultipole::DefaultExpansionOrder));
+        if (properties.contains("integrator")) {
+            auto name = properties.get("integrator");
+            simulation.integrator = Integrator::method_from_string(name.encode());
+            if (!simulation.integrator)
+                return Util::ParseError { "Invalid integrator: '" + name.encode() + "'", { m_reader.location(), {} } };
+        }
+        if (properties.contains("hermite_accuracy"))
+            simulation.hermite_accuracy = TRY(properties.get_double("hermite_accuracy"));
+        if (properties.contains("adaptive_tick")) {
+            auto value = properties.get("adaptive_tick");
+            if (value != "true" && value != "false")
+                return Util::ParseError { "Invalid adaptive_tick: '" + value.encode() + "', expected true or false", { m_reader.location(), {} } };
+            simulation.adaptive_tick = value == "true";
+        }
+        if (properties.contains("adaptive_tick_accuracy"))
+            simulation.adaptive_tick_accuracy = TRY(properties.get_double("adaptive_tick_accuracy"));
+        if (properties.contains("reversible")) {
+            auto value = properties.get("reversible");
+            if (value != "true" && value != "false")
+                return Util::ParseError { "Invalid reversible: '" + value.encode() + "', expected true or false", { m_reader.location(), {} } };
+            simulation.reversible = value == "true";
+        }
+        if (properties.contains("keyframe_interval"))
+            simulation.keyframe_interval = TRY(properties.get_int("keyframe_interval", 0));
+        if (properties.contains("history_precision"))
+            simulation.history_precision = TRY(properties.get_int("history_precision", History::LosslessPrecision));
+        return simulation;
+    }
     if (keyword == "light_source") {
         auto name = TRY(m_reader.consume_while(isalnum));
         return Config::LightSource { Util::UString { name } };
@@ -201,6 +266,39 @@ Config::ErrorOr<std::pair<Util::UString, Util::UString>> ConfigLoader::parse_key
     return std::pair { std::move(name), std::move(value) };
 }
 
+namespace {
+
+// Position and velocity of a particle on a Keplerian orbit, relative to the
+// central object. Orbits with zero inclination lie in the XY plane and go
+// counterclockwise, like orbiting planets.
+std::pair<Util::DeprecatedVector3d, Util::DeprecatedVector3d> orbital_state(double gravity_factor, double semi_major_axis, double eccentricity,
+    double inclination, double ascending_node, double argument_of_periapsis, double true_anomaly) {
+    double const semi_latus_rectum = semi_major_axis * (1 - eccentricity * eccentricity);
+    double const distance = semi_latus_rectum / (1 + eccentricity * std::cos(true_anomaly));
+    double const speed_factor = std::sqrt(gravity_factor / semi_latus_rectum);
+
+    // In the orbital plane, with periapsis on the X axis.
+    double const pos_x = distance * std::cos(true_anomaly);
+    double const pos_y = distance * std::sin(true_anomaly);
+    double const vel_x = -speed_factor * std::sin(true_anomaly);
+    double const vel_y = speed_factor * (eccentricity + std::cos(true_anomaly));
+
+    // Rotate by argument of periapsis, inclination and ascending node.
+    double const cos_node = std::cos(ascending_node), sin_node = std::sin(ascending_node);
+    double const cos_periapsis = std::cos(argument_of_periapsis), sin_periapsis = std::sin(argument_of_periapsis);
+    double const cos_inclination = std::cos(inclination), sin_inclination = std::sin(inclination);
+    auto rotate = [&](double x, double y) {
+        double const px = cos_periapsis * x - sin_periapsis * y;
+        double const py = sin_periapsis * x + cos_periapsis * y;
+        double const iy = cos_inclination * py;
+        double const iz = sin_inclination * py;
+        return Util::DeprecatedVector3d { cos_node * px - sin_node * iy, sin_node * px + cos_node * iy, iz };
+    };
+    return { rotate(pos_x, pos_y), rotate(vel_x, vel_y) };
+}
+
+}
+
 Config::ErrorOr<void> Config::Config::apply(World& world) {
     // TODO: Use UString in Object
     for (auto const& stmt : statements) {
@@ -255,6 +353,31 @@ Config::ErrorOr<void> Config::Config::apply(World& world) {
                         0.0_deg));
                     return {};
                 },
+                [&world](Belt const& belt) -> ErrorOr<void> {
+                    auto* around = world.get_object_by_name(belt.around);
+                    if (!around) {
+                        return Util::ParseError { "Invalid planet for belt: '" + belt.around.encode() + "'" };
+                    }
+                    // Seeded, so that the world is the same every time.
+                    std::mt19937_64 random { belt.seed };
+                    std::uniform_real_distribution<double> uniform;
+                    double const inner_squared = belt.inner_radius.value() * belt.inner_radius.value();
+                    double const outer_squared = belt.outer_radius.value() * belt.outer_radius.value();
+                    for (int i = 0; i < belt.count; i++) {
+                        double const semi_major_axis = std::sqrt(inner_squared + uniform(random) * (outer_squared - inner_squared));
+                        double const eccentricity = uniform(random) * belt.max_eccentricity;
+                        double const inclination = uniform(random) * belt.max_inclination.rad();
+                        double const ascending_node = uniform(random) * 2 * M_PI;
+                        double const argument_of_periapsis = uniform(random) * 2 * M_PI;
+                        double const true_anomaly = uniform(random) * 2 * M_PI;
+                        auto [pos, vel] = orbital_state(around->gravity_factor(), semi_major_axis, eccentricity, inclination, ascending_node, argument_of_periapsis, true_anomaly);
+                        if (belt.direction == Direction::Clockwise)
+                            vel = -vel;
+                        world.add_test_particle({ .pos = around->pos() + pos, .vel = around->vel() + vel, .color = belt.color },
+                            i < belt.trail_count ? static_cast<size_t>(belt.trail_length) : 0);
+                    }
+                    return {};
+                },
                 [&world](LightSource const& source) -> ErrorOr<void> {
                     auto* planet = world.get_object_by_name(source.planet_name);
                     if (!planet) {
@@ -263,6 +386,47 @@ Config::ErrorOr<void> Config::Config::apply(World& world) {
                     world.set_light_source(planet);
                     return {};
                 },
+                [&world](Simulation const& simulation) -> ErrorOr<void> {
+                    if (simulation.gravity_solver)
+                        world.set_gravity_solver(*simulation.gravity_solver);
+                    if (simulation.opening_angle) {
+                        if (*simulation.opening_angle < 0)
+                            return Util::ParseError { "opening_angle must be non-negative" };
+                        world.set_barnes_hut_opening_angle(*simulation.opening_angle);
+                    }
+                    if (simulation.expansion_order) {
+                        if (*simulation.expansion_order < 1 || *simulation.expansion_order > static_cast<int>(Gravity::FastMultipole::MaxExpansionOrder))
+                            return Util::ParseError { "expansion_order out of range" };
+                        world.set_fmm_expansion_order(*simulation.expansion_order);
+                    }
+                    if (simulation.integrator)
+                        world.set_integrator(*simulation.integrator);
+                    if (simulation.hermite_accuracy) {
+                        if (*simulation.hermite_accuracy <= 0)
+                            return Util::ParseError { "hermite_accuracy must be positive" };
+                        world.set_hermite_accuracy(*simulation.hermite_accuracy);
+                    }
+                    if (simulation.adaptive_tick)
+                        world.set_adaptive_tick(*simulation.adaptive_tick);
+                    if (simulation.adaptive_tick_accuracy) {
+                        if (*simulation.adaptive_tick_accuracy <= 0)
+                            return Util::ParseError { "adaptive_tick_accuracy must be positive" };
+                        world.set_adaptive_tick_accuracy(*simulation.adaptive_tick_accuracy);
+                    }
+                    if (simulation.reversible)
+                        world.set_reversible(*simulation.reversible);
+                    if (simulation.keyframe_interval) {
+                        if (*simulation.keyframe_interval < 0)
+                            return Util::ParseError { "keyframe_interval must be non-negative" };
+                        world.set_keyframe_interval(*simulation.keyframe_interval);
+                    }
+                    if (simulation.history_precision) {
+                        if (*simulation.history_precision < 1 || *simulation.history_precision > static_cast<int>(History::LosslessPrecision))
+                            return Util::ParseError { "history_precision out of range" };
+                        world.set_history_precision(*simulation.history_precision);
+                    }
+                    return {};
+                },
             },
             stmt));
     }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Object.hpp"
+#include "gravity/Solver.hpp"
+#include "integrator/Method.hpp"
 
 #include <EssaUtil/GenericParser.hpp>
 #include <EssaUtil/Stream.hpp>
@@ -45,11 +47,42 @@ struct EccentrityDefinedOrbitingPlanet : public OrbitingPlanet {
     double eccentrity;
 };
 
+// Test particles on random orbits around a planet, with semi-major axes
+// between the radii and uniform surface density.
+struct Belt {
+    Util::UString around;
+    Direction direction;
+    int count;
+    Distance inner_radius;
+    Distance outer_radius;
+    double max_eccentricity;
+    Util::Angle max_inclination;
+    Util::Color color;
+    // Number of particles (the first ones) that get a trail.
+    int trail_count;
+    int trail_length;
+    unsigned seed;
+};
+
 struct LightSource {
     Util::UString planet_name;
 };
 
-using Statement = std::variant<AbsolutePlanet, ApPeDefinedOrbitingPlanet, EccentrityDefinedOrbitingPlanet, LightSource>;
+// World-wide simulation settings. Unset fields keep their defaults.
+struct Simulation {
+    std::optional<Gravity::Solver> gravity_solver;
+    std::optional<double> opening_angle;
+    std::optional<int> expansion_order;
+    std::optional<Integrator::Method> integrator;
+    std::optional<double> hermite_accuracy;
+    std::optional<bool> adaptive_tick;
+    std::optional<double> adaptive_tick_accuracy;
+    std::optional<bool> reversible;
+    std::optional<int> keyframe_interval;
+    std::optional<int> history_precision;
+};
+
+using Statement = std::variant<AbsolutePlanet, ApPeDefinedOrbitingPlanet, EccentrityDefinedOrbitingPlanet, Belt, LightSource, Simulation>;
 
 template<class T>
 using ErrorOr = Util::ErrorOr<T, Util::ParseError, Util::OsError>;
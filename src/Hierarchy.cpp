@@ -0,0 +1,125 @@
+#include "Hierarchy.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+void Hierarchy::build(PhysicsState const& state) {
+    auto const size = state.size();
+    m_parent.assign(size, NoParent);
+    m_hill_radius.assign(size, 0);
+
+    m_by_mass.assign(state.active.begin(), state.active.end());
+    if (m_by_mass.empty())
+        return;
+
+    // Parents are always more massive, so they are processed (and their Hill
+    // radii known) before their children.
+    std::stable_sort(m_by_mass.begin(), m_by_mass.end(), [&](uint32_t a, uint32_t b) {
+        return state.gravity_factor[a] > state.gravity_factor[b];
+    });
+
+    auto const root = m_by_mass.front();
+    double const root_gravity_factor = state.gravity_factor[root];
+    if (root_gravity_factor == 0)
+        return;
+    m_hill_radius[root] = std::numeric_limits<double>::infinity();
+
+    // Everything orbits the root, unless it's inside a smaller Hill sphere.
+    m_parent_hill_radius.assign(size, std::numeric_limits<double>::infinity());
+    for (auto s : m_by_mass) {
+        if (state.gravity_factor[s] < root_gravity_factor)
+            m_parent[s] = root;
+    }
+
+    double const lightest_gravity_factor = state.gravity_factor[m_by_mass.back()];
+    if (lightest_gravity_factor == root_gravity_factor)
+        return;
+
+    m_tree.build(state, 8);
+    auto const nodes = m_tree.nodes();
+    auto const order = m_tree.order();
+
+    for (size_t r = 1; r < m_by_mass.size(); r++) {
+        auto const object = m_by_mass[r];
+        auto const parent = m_parent[object];
+        double const gravity_factor = state.gravity_factor[object];
+        if (parent == NoParent || gravity_factor == 0)
+            continue;
+
+        double const x = state.pos_x[object];
+        double const y = state.pos_y[object];
+        double const z = state.pos_z[object];
+        double const parent_dist_x = state.pos_x[parent] - x;
+        double const parent_dist_y = state.pos_y[parent] - y;
+        double const parent_dist_z = state.pos_z[parent] - z;
+        double const parent_distance = std::sqrt(parent_dist_x * parent_dist_x + parent_dist_y * parent_dist_y + parent_dist_z * parent_dist_z);
+        double const radius = parent_distance * std::cbrt(gravity_factor / (3 * state.gravity_factor[parent]));
+        m_hill_radius[object] = radius;
+
+        // Only less massive objects can orbit this one.
+        if (gravity_factor <= lightest_gravity_factor)
+            continue;
+
+        // Less massive objects inside the Hill sphere whose parent's Hill
+        // sphere is bigger.
+        double const radius_squared = radius * radius;
+        m_stack.clear();
+        m_stack.push_back(0);
+        while (!m_stack.empty()) {
+            auto const& node = nodes[m_stack.back()];
+            m_stack.pop_back();
+
+            double const outside_x = std::max(std::abs(node.center_x - x) - node.half_size, 0.0);
+            double const outside_y = std::max(std::abs(node.center_y - y) - node.half_size, 0.0);
+            double const outside_z = std::max(std::abs(node.center_z - z) - node.half_size, 0.0);
+            if (outside_x * outside_x + outside_y * outside_y + outside_z * outside_z > radius_squared)
+                continue;
+
+            if (!node.is_leaf()) {
+                for (uint32_t c = node.first_child; c < node.first_child + node.child_count; c++)
+                    m_stack.push_back(c);
+                continue;
+            }
+
+            for (uint32_t s = node.first_object; s < node.first_object + node.object_count; s++) {
+                auto const other = order[s];
+                if (state.gravity_factor[other] >= gravity_factor || radius >= m_parent_hill_radius[other])
+                    continue;
+                double const dist_x = state.pos_x[other] - x;
+                double const dist_y = state.pos_y[other] - y;
+                double const dist_z = state.pos_z[other] - z;
+                if (dist_x * dist_x + dist_y * dist_y + dist_z * dist_z > radius_squared)
+                    continue;
+                m_parent[other] = object;
+                m_parent_hill_radius[other] = radius;
+            }
+        }
+    }
+}
+
+void Hierarchy::append() {
+    m_parent.push_back(NoParent);
+    m_hill_radius.push_back(0);
+}
+
+void Hierarchy::erase(size_t index) {
+    assert(index < size());
+    m_parent.erase(m_parent.begin() + index);
+    m_hill_radius.erase(m_hill_radius.begin() + index);
+
+    for (auto& parent : m_parent) {
+        if (parent == NoParent)
+            continue;
+        if (parent == index)
+            parent = NoParent;
+        else if (parent > index)
+            parent--;
+    }
+}
+
+void Hierarchy::clear() {
+    m_parent.clear();
+    m_hill_radius.clear();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "PhysicsState.hpp"
+#include "gravity/Octree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Which object every object orbits, e.g. the Moon orbits the Earth and the
+// Earth orbits the Sun. Used for trails, apoapsis/periapsis tracking and
+// the focused object GUI.
+//
+// The parent of an object is the more massive object with the smallest Hill
+// sphere (r * cbrt(m / 3M), the region where its gravity dominates over the
+// gravity of its own parent) that contains the object. The most massive
+// object is the root and its Hill sphere is infinite.
+//
+// The hierarchy changes on orbital timescales, so instead of tracking it in
+// the force loop, World rebuilds it every few ticks (see
+// World::update_hierarchy(), called from World::tick() and
+// World::choose_tick_length()).
+// Indices correspond to PhysicsState indices, and append() / erase() keep
+// them in sync between rebuilds.
+class Hierarchy {
+public:
+    static constexpr size_t NoParent = PhysicsState::NoObject;
+
+    // Rebuilds the hierarchy of alive objects. O(N log N), unless there
+    // are a lot of objects inside Hill spheres of other objects.
+    void build(PhysicsState const&);
+
+    size_t size() const { return m_parent.size(); }
+
+    // NoParent for the root, for objects that aren't less massive than any
+    // other object and for objects added since the last build().
+    size_t parent(size_t index) const { return m_parent[index]; }
+
+    // Infinite for the root, 0 for other objects without a parent and for
+    // massless objects.
+    double hill_radius(size_t index) const { return m_hill_radius[index]; }
+
+    void append();
+
+    // Shifts indices like PhysicsState::erase(). Children of the erased
+    // object lose their parent until the next build().
+    void erase(size_t index);
+    void clear();
+
+private:
+    std::vector<size_t> m_parent;
+    std::vector<double> m_hill_radius;
+
+    Gravity::Octree m_tree;
+    std::vector<uint32_t> m_by_mass;
+    std::vector<double> m_parent_hill_radius;
+    std::vector<uint32_t> m_stack;
+};
@@ -1,59 +1,322 @@
 #include "History.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
-#include <iostream>
 
-History::History(unsigned segments, Entry first_entry) : m_segments(segments), m_first_entry(first_entry){
-    m_entry_list.push_back(first_entry);
-    m_side = 0;
+namespace {
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint64_t>& words)
+        : m_words(words) { }
+
+    // Writes the low `bits` bits of the value.
+    void write(uint64_t value, unsigned bits) {
+        if (bits == 0)
+            return;
+        if (bits < 64)
+            value &= (uint64_t(1) << bits) - 1;
+        if (m_used == 64) {
+            m_words.push_back(0);
+            m_used = 0;
+        }
+        m_words.back() |= value << m_used;
+        auto const written = std::min(bits, 64 - m_used);
+        m_used += written;
+        if (written < bits) {
+            m_words.push_back(value >> written);
+            m_used = bits - written;
+        }
+    }
+
+    // The next write starts a new word.
+    void align() { m_used = 64; }
+
+private:
+    std::vector<uint64_t>& m_words;
+    unsigned m_used = 64;
+};
+
+class BitReader {
+public:
+    explicit BitReader(uint64_t const* words)
+        : m_words(words) { }
+
+    uint64_t read(unsigned bits) {
+        if (bits == 0)
+            return 0;
+        uint64_t value = *m_words >> m_used;
+        auto const available = 64 - m_used;
+        if (bits < available) {
+            m_used += bits;
+        }
+        else {
+            // Don't read the next word if this one ends exactly, it may be
+            // past the end.
+            m_words++;
+            m_used = bits - available;
+            if (m_used > 0)
+                value |= *m_words << available;
+        }
+        return bits < 64 ? value & ((uint64_t(1) << bits) - 1) : value;
+    }
+
+private:
+    uint64_t const* m_words;
+    unsigned m_used = 0;
+};
+
+constexpr uint64_t SignBit = uint64_t(1) << 63;
+
+// Maps doubles to integers ordered like them (-0 just below +0), in which
+// predictions are extrapolated exactly, so encoding and decoding always
+// agree on them. Within a binade, the mapping is linear.
+uint64_t to_ordered(double value) {
+    auto const bits = std::bit_cast<uint64_t>(value);
+    return bits & SignBit ? ~(bits & ~SignBit) : bits;
 }
 
-std::optional<History::Entry> History::move_forward(const Entry entry) {
-    if(m_side == 0){
-        m_entry_list.push_back(entry);
+double from_ordered(uint64_t ordered) {
+    return std::bit_cast<double>(ordered & SignBit ? ~ordered | SignBit : ordered);
+}
+
+// Quadratic extrapolation from the last three values, or fewer at the start
+// of a chunk. Wraps around like the residuals do.
+class Predictor {
+public:
+    uint64_t predict() const {
+        switch (m_count) {
+        case 0:
+            return 0;
+        case 1:
+            return m_last[0];
+        case 2:
+            return 2 * m_last[0] - m_last[1];
+        default:
+            return 3 * m_last[0] - 3 * m_last[1] + m_last[2];
+        }
+    }
+
+    void push(uint64_t value) {
+        m_last[2] = m_last[1];
+        m_last[1] = m_last[0];
+        m_last[0] = value;
+        m_count++;
+    }
+
+private:
+    uint64_t m_last[3] {};
+    unsigned m_count = 0;
+};
 
-        if(m_entry_list.size() > m_segments)
-            m_entry_list.pop_front();
-        return {};
-    }else{
-        if(m_entry_list.size() > 0){
-            auto value = m_entry_list.front();
-            m_entry_list.pop_front();
+// A residual is stored after a control bit, in as many bits as the last one
+// with a new width, unless it doesn't fit or is much shorter. The control bit
+// is then set and followed by the new width.
+constexpr unsigned WidthBits = 7;
+constexpr unsigned MaxWastedBits = 8;
 
-            return value;
-        }else {
-            m_side = 0;
-            m_entry_list.push_back(entry);
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
 
-            return {};
+}
+
+History::History(size_t memory_budget)
+    : m_memory_budget(memory_budget) { }
+
+void History::set_precision(unsigned precision) {
+    m_precision = std::clamp(precision, 1u, LosslessPrecision);
+}
+
+History::Move History::move_forward() {
+    if (m_raw_size == ChunkLength)
+        compress();
+    return { m_raw_size++, false };
+}
+
+History::Move History::move_backward() {
+    assert(size() > 0);
+    if (m_raw_size == 0) {
+        decompress(m_chunks.back());
+        m_compressed_size -= m_chunks.back().memory_size();
+        m_chunks.pop_back();
+        m_raw_size = ChunkLength;
+    }
+    return { --m_raw_size, true };
+}
+
+void History::record(Move move, PhysicsState const& state, size_t first, size_t last) {
+    assert(!move.replay && last <= m_object_count);
+    auto copy = [&](std::vector<double> const& from, size_t index) {
+        std::copy(from.begin() + first, from.begin() + last, component(move.entry, index) + first);
+    };
+    copy(state.pos_x, 0);
+    copy(state.pos_y, 1);
+    copy(state.pos_z, 2);
+    copy(state.vel_x, 3);
+    copy(state.vel_y, 4);
+    copy(state.vel_z, 5);
+}
+
+void History::replay(Move move, PhysicsState& state, size_t first, size_t last) const {
+    assert(move.replay && last <= m_object_count);
+    auto copy = [&](std::vector<double>& to, size_t index) {
+        auto const* from = component(move.entry, index);
+        std::copy(from + first, from + last, to.begin() + first);
+    };
+    copy(state.pos_x, 0);
+    copy(state.pos_y, 1);
+    copy(state.pos_z, 2);
+    copy(state.vel_x, 3);
+    copy(state.vel_y, 4);
+    copy(state.vel_z, 5);
+}
+
+// Encodes the raw entries of an object. Predictions are made from the values
+// as they will be decoded, so that rounding errors don't add up.
+void History::encode_object(Chunk& chunk, size_t index) const {
+    BitWriter writer { chunk.words };
+    writer.align();
+    chunk.offsets.push_back(chunk.words.size());
+
+    for (size_t c = 0; c < Components; c++) {
+        Predictor predictor;
+        unsigned width = 0;
+        for (size_t e = 0; e < ChunkLength; e++) {
+            auto const prediction = predictor.predict();
+            auto residual = static_cast<int64_t>(to_ordered(component(e, c)[index]) - prediction);
+            if (chunk.shift > 0)
+                residual = (residual + (int64_t(1) << (chunk.shift - 1))) >> chunk.shift;
+            predictor.push(prediction + (static_cast<uint64_t>(residual) << chunk.shift));
+
+            auto const encoded = zigzag(residual);
+            auto const residual_width = static_cast<unsigned>(std::bit_width(encoded));
+            if (residual_width <= width && residual_width + MaxWastedBits > width) {
+                // Usually in one write with the residual.
+                if (width < 64) {
+                    writer.write(encoded << 1, width + 1);
+                    continue;
+                }
+                writer.write(0, 1);
+            }
+            else {
+                width = residual_width;
+                writer.write(1 | width << 1, WidthBits + 1);
+            }
+            writer.write(encoded, width);
         }
     }
 }
 
-std::optional<History::Entry> History::move_backward(const Entry entry) {
-    if(m_side == 1){
-        m_entry_list.push_front(entry);
+void History::compress() {
+    assert(m_raw_size == ChunkLength);
+    Chunk chunk;
+    chunk.shift = LosslessPrecision - m_precision;
+    chunk.offsets.reserve(m_object_count + 1);
+    for (size_t s = 0; s < m_object_count; s++)
+        encode_object(chunk, s);
+    chunk.offsets.push_back(chunk.words.size());
+    chunk.words.shrink_to_fit();
+
+    m_compressed_size += chunk.memory_size();
+    m_chunks.push_back(std::move(chunk));
+    m_raw_size = 0;
+    while (m_compressed_size > m_memory_budget && !m_chunks.empty()) {
+        m_compressed_size -= m_chunks.front().memory_size();
+        m_chunks.pop_front();
+    }
+}
+
+void History::decompress(Chunk const& chunk) {
+    for (size_t s = 0; s < m_object_count; s++) {
+        BitReader reader { chunk.words.data() + chunk.offsets[s] };
+        for (size_t c = 0; c < Components; c++) {
+            auto* values = component(0, c) + s;
+            Predictor predictor;
+            unsigned width = 0;
+            for (size_t e = 0; e < ChunkLength; e++) {
+                if (reader.read(1))
+                    width = reader.read(WidthBits);
+                auto const residual = unzigzag(reader.read(width));
+                auto const ordered = predictor.predict() + (static_cast<uint64_t>(residual) << chunk.shift);
+                values[e * Components * m_stride] = from_ordered(ordered);
+                predictor.push(ordered);
+            }
+        }
+    }
+}
 
-        if(m_entry_list.size() > m_segments)
-            m_entry_list.pop_back();
-        return {};
-    }else{
-        if(m_entry_list.size() > 0){
-            auto value = m_entry_list.back();
-            m_entry_list.pop_back();
+// Raw entries are laid out with room for `m_stride` objects, which grows
+// geometrically.
+void History::reserve_objects(size_t count) {
+    if (count <= m_stride)
+        return;
+    auto const stride = std::max({ count, m_stride * 2, size_t(64) });
+    auto data = std::make_unique_for_overwrite<double[]>(ChunkLength * Components * stride);
+    for (size_t entry = 0; entry < m_raw_size; entry++) {
+        for (size_t c = 0; c < Components; c++) {
+            auto const* from = component(entry, c);
+            std::copy(from, from + m_object_count, data.get() + (entry * Components + c) * stride);
+        }
+    }
+    m_data = std::move(data);
+    m_stride = stride;
+}
 
-            return value;
-        }else {
-            m_side = 1;
-            m_entry_list.push_front(entry);
+void History::append(PhysicsState const& state) {
+    assert(state.size() == m_object_count + 1);
+    reserve_objects(m_object_count + 1);
+    auto const index = m_object_count++;
+    double const values[Components] { state.pos_x[index], state.pos_y[index], state.pos_z[index], state.vel_x[index], state.vel_y[index],
+        state.vel_z[index] };
+    // Chunks are encoded from the raw entries, so fill all of them. Entries
+    // past m_raw_size are overwritten before they are used.
+    for (size_t entry = 0; entry < ChunkLength; entry++) {
+        for (size_t c = 0; c < Components; c++)
+            component(entry, c)[index] = values[c];
+    }
+    for (auto& chunk : m_chunks) {
+        m_compressed_size -= chunk.memory_size();
+        chunk.offsets.pop_back();
+        encode_object(chunk, index);
+        chunk.offsets.push_back(chunk.words.size());
+        m_compressed_size += chunk.memory_size();
+    }
+}
 
-            return {};
+void History::erase(size_t index) {
+    assert(index < m_object_count);
+    for (size_t entry = 0; entry < m_raw_size; entry++) {
+        for (size_t c = 0; c < Components; c++) {
+            auto* values = component(entry, c);
+            std::copy(values + index + 1, values + m_object_count, values + index);
         }
     }
+    for (auto& chunk : m_chunks) {
+        m_compressed_size -= chunk.memory_size();
+        auto const first = chunk.offsets[index];
+        auto const length = chunk.offsets[index + 1] - first;
+        chunk.words.erase(chunk.words.begin() + first, chunk.words.begin() + first + length);
+        chunk.offsets.erase(chunk.offsets.begin() + index);
+        for (size_t s = index; s < chunk.offsets.size(); s++)
+            chunk.offsets[s] -= length;
+        m_compressed_size += chunk.memory_size();
+    }
+    m_object_count--;
 }
 
 void History::reset() {
-    m_entry_list.clear();
-    m_entry_list.push_back(m_first_entry);
-    m_side = 0;
+    m_raw_size = 0;
+    m_chunks.clear();
+    m_compressed_size = 0;
+}
+
+void History::clear() {
+    reset();
+    m_object_count = 0;
 }
@@ -1,34 +1,107 @@
 #pragma once
 
-#include <EssaUtil/Vector.hpp>
-#include <list>
-#include <optional>
+#include "PhysicsState.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <vector>
 
+// Positions and velocities of all objects in the last ticks. The newest
+// ChunkLength entries are kept as raw doubles: pos_x of all objects, then
+// pos_y, ..., vel_z, so recording or replaying a tick is six contiguous
+// copies. Older entries are compressed in chunks of ChunkLength, oldest
+// chunks being dropped when they take more than `memory_budget` bytes.
+//
+// A chunk stores every value as the residual of a prediction extrapolated
+// from the previous values of the same series, which for orbits takes
+// roughly half of the bits. With a precision below 52 mantissa bits,
+// residuals are also rounded, so that values are restored with a relative
+// error of about 2^-precision and the same memory covers more ticks.
+//
+// move_forward() records the state as a new entry and move_backward()
+// replays the last entry and drops it.
+//
+// Indices correspond to PhysicsState indices, and append() / erase() keep
+// them in sync.
 class History {
-    struct Entry {
-        Util::DeprecatedVector3d pos, vel;
-    };
+public:
+    static constexpr size_t ChunkLength = 64;
+    static constexpr unsigned LosslessPrecision = 52;
 
-    std::list<Entry> m_entry_list;
+    explicit History(size_t memory_budget);
 
-    bool m_side;
+    History(History const&) = delete;
+    History& operator=(History const&) = delete;
+    History(History&&) = default;
+    History& operator=(History&&) = default;
 
-    const unsigned m_segments;
-    const Entry m_first_entry;
+    // Where the state of a tick goes to or comes from.
+    struct Move {
+        size_t entry;
+        bool replay;
+    };
 
-public:
-    History(unsigned segments, Entry first_entry);
+    // Only update the bookkeeping (and compress or decompress a chunk when
+    // needed). The state is then copied by record() or replay(), which can
+    // be split between workers. move_backward() requires size() > 0.
+    Move move_forward();
+    Move move_backward();
 
-    History(History const&) = delete;
-    History& operator=(History const&) = delete;
-    History(History&&) = delete;
-    History& operator=(History&&) = delete;
+    // Copy objects with indices in [first, last).
+    void record(Move, PhysicsState const&, size_t first, size_t last);
+    void replay(Move, PhysicsState&, size_t first, size_t last) const;
 
-    std::optional<Entry> move_forward(const Entry entry);
-    std::optional<Entry> move_backward(const Entry entry);
+    size_t size() const { return m_raw_size + m_chunks.size() * ChunkLength; }
+    size_t object_count() const { return m_object_count; }
+    // Bytes taken by compressed chunks.
+    size_t compressed_size() const { return m_compressed_size; }
 
-    Entry first_entry() const{return m_first_entry;}
+    // Mantissa bits kept in chunks compressed from now on.
+    unsigned precision() const { return m_precision; }
+    void set_precision(unsigned precision);
 
+    // Appends the last object of the state. It stays where it is now in all
+    // existing entries.
+    void append(PhysicsState const&);
+    void erase(size_t index);
+
+    // Drops all entries.
     void reset();
+    // Drops all entries and objects.
+    void clear();
+
+private:
+    static constexpr size_t Components = 6;
+
+    // Every object is encoded separately, starting at word offsets[index],
+    // so that objects can be appended and erased without decoding.
+    struct Chunk {
+        std::vector<uint64_t> words;
+        std::vector<size_t> offsets;
+        // Residuals are rounded to multiples of 2^shift.
+        unsigned shift = 0;
+
+        size_t memory_size() const { return words.size() * sizeof(uint64_t) + offsets.size() * sizeof(size_t); }
+    };
+
+    double* component(size_t entry, size_t index) const { return m_data.get() + (entry * Components + index) * m_stride; }
+    void reserve_objects(size_t count);
+    void compress();
+    void decompress(Chunk const&);
+    void encode_object(Chunk&, size_t index) const;
+
+    size_t m_memory_budget;
+    unsigned m_precision = LosslessPrecision;
+    size_t m_stride = 0;
+    size_t m_object_count = 0;
+
+    // The newest entries, not compressed yet.
+    std::unique_ptr<double[]> m_data;
+    size_t m_raw_size = 0;
+
+    // Oldest first.
+    std::deque<Chunk> m_chunks;
+    size_t m_compressed_size = 0;
 };
@@ -0,0 +1,88 @@
+#include "Keyframes.hpp"
+
+#include <algorithm>
+
+void Keyframes::save(int64_t tick, Util::SimulationClock::time_point date, int tick_length, PhysicsState const& state, TestParticles const& particles) {
+    while (!m_keyframes.empty() && m_keyframes.back().tick >= tick)
+        m_keyframes.pop_back();
+
+    m_keyframes.push_back({
+        .tick = tick,
+        .date = date,
+        .tick_length = tick_length,
+        .pos_x = state.pos_x,
+        .pos_y = state.pos_y,
+        .pos_z = state.pos_z,
+        .vel_x = state.vel_x,
+        .vel_y = state.vel_y,
+        .vel_z = state.vel_z,
+        .gravity_factor = state.gravity_factor,
+        .particle_pos_x = particles.pos_x,
+        .particle_pos_y = particles.pos_y,
+        .particle_pos_z = particles.pos_z,
+        .particle_vel_x = particles.vel_x,
+        .particle_vel_y = particles.vel_y,
+        .particle_vel_z = particles.vel_z,
+    });
+}
+
+Keyframes::Keyframe const* Keyframes::last_before(int64_t tick) const {
+    auto it = std::lower_bound(m_keyframes.begin(), m_keyframes.end(), tick, [](Keyframe const& keyframe, int64_t tick) {
+        return keyframe.tick < tick;
+    });
+    if (it == m_keyframes.begin())
+        return nullptr;
+    return &*std::prev(it);
+}
+
+void Keyframes::restore(Keyframe const& keyframe, PhysicsState& state, TestParticles& particles) const {
+    auto copy = [](std::vector<double> const& from, std::vector<double>& to, size_t first, size_t last) {
+        std::copy(from.begin() + first, from.begin() + last, to.begin() + first);
+    };
+    auto copy_objects = [&](Keyframe const& from, size_t first, size_t last) {
+        copy(from.pos_x, state.pos_x, first, last);
+        copy(from.pos_y, state.pos_y, first, last);
+        copy(from.pos_z, state.pos_z, first, last);
+        copy(from.vel_x, state.vel_x, first, last);
+        copy(from.vel_y, state.vel_y, first, last);
+        copy(from.vel_z, state.vel_z, first, last);
+        copy(from.gravity_factor, state.gravity_factor, first, last);
+    };
+
+    auto restored = std::min(keyframe.object_count(), state.size());
+    copy_objects(keyframe, 0, restored);
+    for (auto it = m_keyframes.begin() + (&keyframe - m_keyframes.data()) + 1; it != m_keyframes.end() && restored < state.size(); ++it) {
+        auto const count = std::min(it->object_count(), state.size());
+        if (count > restored) {
+            copy_objects(*it, restored, count);
+            restored = count;
+        }
+    }
+
+    auto const particle_count = std::min(keyframe.particle_pos_x.size(), particles.size());
+    copy(keyframe.particle_pos_x, particles.pos_x, 0, particle_count);
+    copy(keyframe.particle_pos_y, particles.pos_y, 0, particle_count);
+    copy(keyframe.particle_pos_z, particles.pos_z, 0, particle_count);
+    copy(keyframe.particle_vel_x, particles.vel_x, 0, particle_count);
+    copy(keyframe.particle_vel_y, particles.vel_y, 0, particle_count);
+    copy(keyframe.particle_vel_z, particles.vel_z, 0, particle_count);
+}
+
+void Keyframes::erase(size_t index) {
+    for (auto& keyframe : m_keyframes) {
+        if (index >= keyframe.object_count())
+            continue;
+        auto erase_at = [index](std::vector<double>& vector) { vector.erase(vector.begin() + index); };
+        erase_at(keyframe.pos_x);
+        erase_at(keyframe.pos_y);
+        erase_at(keyframe.pos_z);
+        erase_at(keyframe.vel_x);
+        erase_at(keyframe.vel_y);
+        erase_at(keyframe.vel_z);
+        erase_at(keyframe.gravity_factor);
+    }
+}
+
+void Keyframes::clear() {
+    m_keyframes.clear();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "PhysicsState.hpp"
+#include "TestParticles.hpp"
+
+#include <EssaUtil/SimulationClock.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Full states of all objects and test particles, saved every few ticks, so
+// that World can go back to any earlier tick by restoring the closest
+// keyframe before it and integrating forward again (see
+// World::set_keyframe_interval()).
+//
+// Object indices correspond to PhysicsState indices. Objects added after a
+// keyframe was saved are not in it; restore() takes their state from the
+// first later keyframe that has them, which World saves when they are added.
+class Keyframes {
+public:
+    struct Keyframe {
+        int64_t tick;
+        Util::SimulationClock::time_point date;
+        int tick_length;
+
+        std::vector<double> pos_x, pos_y, pos_z;
+        std::vector<double> vel_x, vel_y, vel_z;
+        std::vector<double> gravity_factor;
+
+        std::vector<double> particle_pos_x, particle_pos_y, particle_pos_z;
+        std::vector<double> particle_vel_x, particle_vel_y, particle_vel_z;
+
+        size_t object_count() const { return gravity_factor.size(); }
+    };
+
+    // Drops keyframes at `tick` and later, which belong to a future that
+    // is being replaced.
+    void save(int64_t tick, Util::SimulationClock::time_point, int tick_length, PhysicsState const&, TestParticles const&);
+
+    // The last keyframe saved before `tick`, or nullptr.
+    Keyframe const* last_before(int64_t tick) const;
+
+    // Test particles added since the keyframe keep their current state.
+    void restore(Keyframe const&, PhysicsState&, TestParticles&) const;
+
+    size_t size() const { return m_keyframes.size(); }
+
+    // Shifts object indices like PhysicsState::erase().
+    void erase(size_t index);
+    void clear();
+
+private:
+    // Sorted by tick.
+    std::vector<Keyframe> m_keyframes;
+};
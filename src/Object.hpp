@@ -1,23 +1,32 @@
 #pragma once
 
-#include <GL/glew.h>
-
-#include "History.hpp"
-#include "SimulationView.hpp"
+#include "PhysicsState.hpp"
 #include "Trail.hpp"
-#include "glwrapper/Sphere.hpp"
 #include "pyssa/Object.hpp"
 #include "pyssa/WrappedObject.hpp"
 
+#include <EssaUtil/Angle.hpp>
+#include <EssaUtil/Color.hpp>
 #include <EssaUtil/SimulationClock.hpp>
+#include <EssaUtil/UString.hpp>
 #include <EssaUtil/Units.hpp>
 #include <EssaUtil/Vector.hpp>
+#include <cstdint>
 #include <limits>
 #include <list>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
+namespace Gfx {
+class Painter;
+}
+
+class SimulationView;
+class Sphere;
+class World;
+
 class Object : public PySSA::WrappedObject<Object> {
 public:
     Object(double mass, double radius, Util::DeprecatedVector3d pos, Util::DeprecatedVector3d vel, Util::Color color, Util::UString name, unsigned period);
@@ -31,20 +40,16 @@ public:
     Object(Object&& other) = delete;
     Object& operator=(Object&& other) = delete;
 
-    Util::DeprecatedVector3d render_position() const { return m_pos / Util::Constants::AU; }
+    Util::DeprecatedVector3d render_position() const { return pos() / Util::Constants::AU; }
 
     Util::UString name() const { return m_name; }
 
-    // Called before each force calculation pass (currently Leapfrog step)
-    void clear_forces();
-
     // Called before anything physical is done on the Object.
     void before_update();
 
-    void update_forces_against(Object&);
-    void update(int speed);
-
     Trail& trail() { return m_trail; }
+
+    // Drawing functions are defined in the rendering layer (render/Object.cpp).
     static Sphere& sphere();
 
     // Draw the object in world's coordinates.
@@ -69,19 +74,39 @@ public:
     // the given point.
     void require_orbit_point(Util::DeprecatedVector3d);
 
-    double mass() const { return m_gravity_factor / Util::Constants::Gravity; }
-    double gravity_factor() const { return m_gravity_factor; }
-
-    Util::DeprecatedVector3d pos() const { return m_pos; }
-    void set_pos(const Util::DeprecatedVector3d& pos) { m_pos = pos; }
-
-    Util::DeprecatedVector3d vel() const { return m_vel; }
-    void set_vel(const Util::DeprecatedVector3d& vel) { m_vel = vel; }
-
-    Util::DeprecatedVector3d acc() const { return m_attraction_factor; }
+    double mass() const { return gravity_factor() / Util::Constants::Gravity; }
+    double gravity_factor() const { return m_physics ? m_physics->gravity_factor[m_physics_index] : m_detached_state.gravity_factor; }
+
+    Util::DeprecatedVector3d pos() const { return m_physics ? m_physics->pos(m_physics_index) : m_detached_state.pos; }
+    void set_pos(const Util::DeprecatedVector3d& pos) {
+        if (m_physics) {
+            m_physics->set_pos(m_physics_index, pos);
+            physics_edited();
+        }
+        else {
+            m_detached_state.pos = pos;
+        }
+    }
+
+    Util::DeprecatedVector3d vel() const { return m_physics ? m_physics->vel(m_physics_index) : m_detached_state.vel; }
+    void set_vel(const Util::DeprecatedVector3d& vel) {
+        if (m_physics) {
+            m_physics->set_vel(m_physics_index, vel);
+            physics_edited();
+        }
+        else {
+            m_detached_state.vel = vel;
+        }
+    }
+
+    Util::DeprecatedVector3d acc() const { return m_physics ? m_physics->acc(m_physics_index) : m_detached_state.acc; }
 
     Util::Color color() const { return m_color; }
 
+    // Assigned by World when the object is added, in increasing order, and
+    // not reused until the world is reset, unlike indices and addresses.
+    uint64_t id() const { return m_id; }
+
     Util::SimulationClock::time_point creation_date() const { return m_creation_date; }
 
     Util::SimulationClock::time_point deletion_date() const { return m_deletion_date; }
@@ -96,7 +121,8 @@ public:
     double radius() const { return m_radius; }
     void set_radius(double radius);
 
-    Object* most_attracting_object() const { return m_most_attracting_object; }
+    // Object that this one orbits, see Hierarchy.
+    Object* most_attracting_object() const;
     void delete_most_attracting_object();
 
     struct Info {
@@ -116,14 +142,22 @@ public:
 
     Info get_info() const;
 
-    void reset_history();
-
 private:
     friend class World;
     friend std::ostream& operator<<(std::ostream& out, Object const&);
 
     void update_closest_approaches();
 
+    void set_gravity_factor(double);
+
+    // Makes the object a handle into World's physics state. Called by
+    // World when the object is added to its object list.
+    void attach_physics(PhysicsState&, size_t index);
+
+    // Copies the physical state back into the object. Called by World
+    // before the object is removed from its object list.
+    void detach_physics();
+
     // Called after everything physical is done on the Object.
     // Used for trails / apoapsis & periapsis / everything that doesn't
     // influence physical behavior
@@ -151,15 +185,18 @@ private:
 
     double m_density;
     Trail m_trail;
-    History m_history;
 
     // NOTE: We only keep that for Python. It's not used anywhere.
     Util::DeprecatedVector3d attraction(const Object&);
     void recalculate_trails_with_offset();
+    void physics_edited();
 
-    Util::DeprecatedVector3d m_pos;
-    Util::DeprecatedVector3d m_vel;
-    Util::DeprecatedVector3d m_attraction_factor;
+    // Physical state lives in World's PhysicsState while the object
+    // is a part of a World, and in m_detached_state otherwise.
+    PhysicsState* m_physics = nullptr;
+    size_t m_physics_index = 0;
+    PhysicsState::Body m_detached_state;
+    uint64_t m_id = 0;
 
     bool m_deleted = false;
     bool m_is_forward_simulated = false;
@@ -170,16 +207,13 @@ private:
     double m_ap_vel = 0, m_pe_vel = 0;
     float m_prev_zoom;
     double m_orbit_len, eccentrity;
-    double m_gravity_factor {};
     double m_radius {};
 
     Util::SimulationClock::time_point m_creation_date, m_deletion_date;
     Util::UString m_name;
     Util::Color m_color;
 
-    double m_max_attraction = 0;
     Object* m_old_most_attracting_object = nullptr;
-    Object* m_most_attracting_object = nullptr;
 
     struct ClosestApproachEntry {
         Util::DeprecatedVector3d this_position;
@@ -1,29 +1,43 @@
 #include "ObjectHistory.hpp"
 #include <EssaUtil/SimulationClock.hpp>
 
-void ObjectHistory::clear_history(unsigned long to_index) {
-    m_entries.resize(std::min<size_t>(to_index, m_entries.size()));
-    m_pos = to_index - 1;
-}
+#include <algorithm>
 
-bool ObjectHistory::set_time(Util::SimulationClock::time_point time) {
-    m_pos = 0;
+void ObjectHistory::add_event(Util::SimulationClock::time_point date, Object* object) {
+    auto it = std::upper_bound(m_events.begin(), m_events.end(), date, [](auto date, Event const& event) { return date < event.date; });
+    m_events.insert(it, { date, object });
+    if (date <= m_time)
+        m_cursor++;
+}
 
-    for (auto& e : m_entries) {
-        if (e->creation_date() > time)
-            return true;
-        m_pos++;
+void ObjectHistory::remove_event(Util::SimulationClock::time_point date, Object const* object) {
+    auto it = std::lower_bound(m_events.begin(), m_events.end(), date, [](Event const& event, auto date) { return event.date < date; });
+    for (; it != m_events.end() && it->date == date; ++it) {
+        if (it->object != object)
+            continue;
+        if (static_cast<size_t>(it - m_events.begin()) < m_cursor)
+            m_cursor--;
+        m_events.erase(it);
+        return;
     }
-    return false;
 }
 
-void ObjectHistory::push_to_entry(std::unique_ptr<Object> obj) {
-    obj->reset_history();
-    m_entries.push_back(std::move(obj));
+void ObjectHistory::remove_events(Object const* object) {
+    size_t kept = 0;
+    size_t kept_before_cursor = 0;
+    for (size_t e = 0; e < m_events.size(); e++) {
+        if (m_events[e].object == object)
+            continue;
+        if (e < m_cursor)
+            kept_before_cursor++;
+        m_events[kept++] = m_events[e];
+    }
+    m_events.resize(kept);
+    m_cursor = kept_before_cursor;
 }
 
-std::unique_ptr<Object> ObjectHistory::pop_from_entries() {
-    auto object = std::move(m_entries.back());
-    m_entries.pop_back();
-    return object;
+void ObjectHistory::clear() {
+    m_events.clear();
+    m_cursor = 0;
+    m_time = {};
 }
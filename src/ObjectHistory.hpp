@@ -1,24 +1,47 @@
 #pragma once
 
 #include "Object.hpp"
-#include <memory>
+#include <EssaUtil/SimulationClock.hpp>
 #include <vector>
-class ObjectHistory {
 
-    std::vector<std::unique_ptr<Object>> m_entries;
+// Creation and deletion dates of objects, sorted, with a cursor at the
+// current date. Moving the date only visits the events that it passes, so a
+// tick costs the same however many objects are created or deleted at other
+// dates.
+class ObjectHistory {
+public:
+    struct Event {
+        Util::SimulationClock::time_point date;
+        Object* object;
+    };
 
-    unsigned m_pos = 0;
+private:
+    std::vector<Event> m_events;
+    // Events up to m_time are before m_cursor.
+    size_t m_cursor = 0;
+    Util::SimulationClock::time_point m_time;
 
 public:
     ObjectHistory() = default;
 
-    unsigned get_pos() const { return m_pos; }
-    void clear_history(unsigned long to_index);
-    bool set_time(Util::SimulationClock::time_point time);
+    // Calls `callback(Object&)` for every event between the last time and
+    // `time`, in the order they are passed.
+    template<class Callback>
+    void set_time(Util::SimulationClock::time_point time, Callback&& callback) {
+        while (m_cursor < m_events.size() && m_events[m_cursor].date <= time)
+            callback(*m_events[m_cursor++].object);
+        while (m_cursor > 0 && m_events[m_cursor - 1].date > time)
+            callback(*m_events[--m_cursor].object);
+        m_time = time;
+    }
+
+    // Events at the same date stay in the order they were added.
+    void add_event(Util::SimulationClock::time_point date, Object* object);
+    void remove_event(Util::SimulationClock::time_point date, Object const* object);
+    void remove_events(Object const* object);
 
-    void push_to_entry(std::unique_ptr<Object> obj);
-    std::unique_ptr<Object> pop_from_entries();
-    std::unique_ptr<Object>& back() { return m_entries.back(); }
+    size_t size() const { return m_events.size(); }
 
-    unsigned size() const { return m_entries.size(); }
+    // Also forgets the time, like a newly created history.
+    void clear();
 };
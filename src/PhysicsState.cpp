@@ -0,0 +1,73 @@
+#include "PhysicsState.hpp"
+
+#include <cassert>
+
+size_t PhysicsState::append(Body const& body) {
+    pos_x.push_back(body.pos.x());
+    pos_y.push_back(body.pos.y());
+    pos_z.push_back(body.pos.z());
+    vel_x.push_back(body.vel.x());
+    vel_y.push_back(body.vel.y());
+    vel_z.push_back(body.vel.z());
+    acc_x.push_back(body.acc.x());
+    acc_y.push_back(body.acc.y());
+    acc_z.push_back(body.acc.z());
+    gravity_factor.push_back(body.gravity_factor);
+    alive.push_back(1);
+    active.push_back(size() - 1);
+    return size() - 1;
+}
+
+PhysicsState::Body PhysicsState::body(size_t index) const {
+    return Body {
+        .pos = pos(index),
+        .vel = vel(index),
+        .acc = acc(index),
+        .gravity_factor = gravity_factor[index],
+    };
+}
+
+void PhysicsState::erase(size_t index) {
+    assert(index < size());
+    auto erase_at = [index](auto& vector) { vector.erase(vector.begin() + index); };
+    erase_at(pos_x);
+    erase_at(pos_y);
+    erase_at(pos_z);
+    erase_at(vel_x);
+    erase_at(vel_y);
+    erase_at(vel_z);
+    erase_at(acc_x);
+    erase_at(acc_y);
+    erase_at(acc_z);
+    erase_at(gravity_factor);
+    erase_at(alive);
+
+    std::erase(active, index);
+    for (auto& other : active) {
+        if (other > index)
+            other--;
+    }
+}
+
+void PhysicsState::clear() {
+    pos_x.clear();
+    pos_y.clear();
+    pos_z.clear();
+    vel_x.clear();
+    vel_y.clear();
+    vel_z.clear();
+    acc_x.clear();
+    acc_y.clear();
+    acc_z.clear();
+    gravity_factor.clear();
+    alive.clear();
+    active.clear();
+}
+
+void PhysicsState::update_active() {
+    active.clear();
+    for (size_t s = 0; s < size(); s++) {
+        if (alive[s])
+            active.push_back(s);
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <EssaUtil/Vector.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Physical state of all objects of a World, stored as structure of arrays
+// so that the force loop and the integrator can stream through it without
+// touching the rest of the Object (trails, history, names...).
+//
+// Index i corresponds to the i-th object in the World's object list. Objects
+// added to a World become handles into this storage (see Object::m_physics).
+struct PhysicsState {
+    static constexpr size_t NoObject = static_cast<size_t>(-1);
+
+    // State of a single object that is not (yet) a part of any World.
+    struct Body {
+        Util::DeprecatedVector3d pos;
+        Util::DeprecatedVector3d vel;
+        Util::DeprecatedVector3d acc;
+        double gravity_factor {};
+    };
+
+    std::vector<double> pos_x, pos_y, pos_z;
+    std::vector<double> vel_x, vel_y, vel_z;
+    std::vector<double> acc_x, acc_y, acc_z;
+    std::vector<double> gravity_factor;
+
+    // Objects that take part in the simulation at the current date. Objects
+    // that are not alive (not created yet or deleted) stay in the arrays as
+    // tombstones, so that going back in time can bring them back. Updated by
+    // World when the date crosses a creation or deletion date.
+    std::vector<uint8_t> alive;
+
+    // Indices of alive objects in ascending order. Loops over objects iterate
+    // over this instead of checking alive, so that they never touch
+    // tombstones.
+    std::vector<size_t> active;
+
+    size_t size() const { return gravity_factor.size(); }
+
+    size_t append(Body const&);
+    Body body(size_t index) const;
+
+    // Removes the object at the given index, shifting all following objects
+    // by one.
+    void erase(size_t index);
+    void clear();
+
+    // Rebuilds active from alive.
+    void update_active();
+
+    Util::DeprecatedVector3d pos(size_t i) const { return { pos_x[i], pos_y[i], pos_z[i] }; }
+    void set_pos(size_t i, Util::DeprecatedVector3d const& v) {
+        pos_x[i] = v.x();
+        pos_y[i] = v.y();
+        pos_z[i] = v.z();
+    }
+
+    Util::DeprecatedVector3d vel(size_t i) const { return { vel_x[i], vel_y[i], vel_z[i] }; }
+    void set_vel(size_t i, Util::DeprecatedVector3d const& v) {
+        vel_x[i] = v.x();
+        vel_y[i] = v.y();
+        vel_z[i] = v.z();
+    }
+
+    Util::DeprecatedVector3d acc(size_t i) const { return { acc_x[i], acc_y[i], acc_z[i] }; }
+};
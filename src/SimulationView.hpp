@@ -13,6 +13,7 @@
 
 #include <functional>
 #include <optional>
+#include <vector>
 
 class Object;
 class World;
@@ -77,8 +78,6 @@ public:
     void set_show_grid(bool b) { m_show_grid = b; }
     void set_show_trails(bool b) { m_show_trails = b; }
     bool show_trails() const { return m_show_trails; }
-    void set_offset_trails(bool b) { m_offset_trail = b; }
-    bool offset_trails() const { return m_offset_trail; }
     void set_fixed_rotation_on_focus(bool b) { m_fixed_rotation_on_focus = b; }
     void set_display_debug_info(bool b) { m_display_debug_info = b; }
 
@@ -105,6 +104,10 @@ public:
 
     Gfx::FullShaderResource<Essa::Shaders::Basic>& basic_shader() const { return *m_basic_shader; }
 
+    // Reused between frames by World::draw_test_particles(), belts can have
+    // millions of particles.
+    std::vector<Essa::Shaders::Basic::Vertex>& test_particle_vertices() const { return m_test_particle_vertices; }
+
 #ifdef ENABLE_PYSSA
     static void setup_python_bindings(TypeSetup);
 #endif
@@ -179,7 +182,6 @@ private:
     bool m_show_labels = true;
     bool m_show_grid = true;
     bool m_show_trails = true;
-    bool m_offset_trail = true;
     bool m_fixed_rotation_on_focus = true;
     bool m_display_debug_info = false;
 
@@ -192,4 +194,5 @@ private:
     int m_pause_count = 0;
 
     Gfx::FullShaderResource<Essa::Shaders::Basic>* m_basic_shader = nullptr;
+    mutable std::vector<Essa::Shaders::Basic::Vertex> m_test_particle_vertices;
 };
@@ -0,0 +1,40 @@
+#include "TestParticles.hpp"
+
+size_t TestParticles::append(Particle const& particle, size_t trail_length) {
+    pos_x.push_back(particle.pos.x());
+    pos_y.push_back(particle.pos.y());
+    pos_z.push_back(particle.pos.z());
+    vel_x.push_back(particle.vel.x());
+    vel_y.push_back(particle.vel.y());
+    vel_z.push_back(particle.vel.z());
+    acc_x.push_back(0);
+    acc_y.push_back(0);
+    acc_z.push_back(0);
+    color.push_back(particle.color);
+
+    auto index = size() - 1;
+    if (trail_length > 0) {
+        trails.push_back({ index, Trail { trail_length, particle.color } });
+        trails.back().trail.push_back(Util::Point3d::from_deprecated_vector(particle.pos));
+    }
+    return index;
+}
+
+void TestParticles::clear() {
+    // Belts can take hundreds of megabytes, so give the memory back.
+    auto release = [](auto& vector) {
+        vector.clear();
+        vector.shrink_to_fit();
+    };
+    release(pos_x);
+    release(pos_y);
+    release(pos_z);
+    release(vel_x);
+    release(vel_y);
+    release(vel_z);
+    release(acc_x);
+    release(acc_y);
+    release(acc_z);
+    release(color);
+    trails.clear();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Trail.hpp"
+
+#include <EssaUtil/Color.hpp>
+#include <EssaUtil/Vector.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Massless particles (asteroids, debris) that are attracted by objects of
+// a World, but don't attract anything, so they don't take part in the
+// object pair loop. They are much lighter than Objects: no history, closest
+// approaches or name, only the physical state, color and optionally a trail.
+// Stored as structure of arrays like PhysicsState.
+struct TestParticles {
+    struct Particle {
+        Util::DeprecatedVector3d pos;
+        Util::DeprecatedVector3d vel;
+        Util::Color color;
+    };
+
+    std::vector<double> pos_x, pos_y, pos_z;
+    std::vector<double> vel_x, vel_y, vel_z;
+    std::vector<double> acc_x, acc_y, acc_z;
+    std::vector<Util::Color> color;
+
+    // Trails of the few particles that have one.
+    struct ParticleTrail {
+        size_t index;
+        Trail trail;
+    };
+    std::vector<ParticleTrail> trails;
+
+    size_t size() const { return pos_x.size(); }
+
+    // Adds a trail with `trail_length` vertices if it's non-zero.
+    size_t append(Particle const&, size_t trail_length = 0);
+    void clear();
+
+    Util::DeprecatedVector3d pos(size_t i) const { return { pos_x[i], pos_y[i], pos_z[i] }; }
+    Util::DeprecatedVector3d vel(size_t i) const { return { vel_x[i], vel_y[i], vel_z[i] }; }
+};
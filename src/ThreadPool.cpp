@@ -0,0 +1,68 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+void ThreadPool::Worker::sync() {
+    if (m_pool)
+        m_pool->m_barrier.arrive_and_wait();
+}
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : m_barrier(static_cast<std::ptrdiff_t>(std::max<size_t>(thread_count, 1))) {
+    for (size_t index = 1; index < thread_count; index++)
+        m_threads.emplace_back([this, index] { worker_entry(index); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock { m_mutex };
+        m_exiting = true;
+    }
+    m_job_cv.notify_all();
+    // std::jthread joins on destruction.
+    m_threads.clear();
+}
+
+void ThreadPool::run(Job const& job) {
+    if (m_threads.empty()) {
+        run_inline(job);
+        return;
+    }
+
+    {
+        std::lock_guard lock { m_mutex };
+        m_job = &job;
+        m_job_generation++;
+    }
+    m_job_cv.notify_all();
+
+    Worker worker { this, 0, thread_count() };
+    job(worker);
+
+    // Wait for the other workers to finish, so that the job can be destroyed.
+    m_barrier.arrive_and_wait();
+}
+
+void ThreadPool::run_inline(Job const& job) {
+    Worker worker { nullptr, 0, 1 };
+    job(worker);
+}
+
+void ThreadPool::worker_entry(size_t index) {
+    uint64_t last_generation = 0;
+    while (true) {
+        Job const* job;
+        {
+            std::unique_lock lock { m_mutex };
+            m_job_cv.wait(lock, [&] { return m_exiting || m_job_generation != last_generation; });
+            if (m_exiting)
+                return;
+            last_generation = m_job_generation;
+            job = m_job;
+        }
+
+        Worker worker { this, index, thread_count() };
+        (*job)(worker);
+        m_barrier.arrive_and_wait();
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <barrier>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Persistent worker threads that run a job together, splitting the work
+// between them and synchronizing with barriers. The calling thread is
+// worker 0, so that a pool of 1 thread runs the job inline.
+class ThreadPool {
+public:
+    class Worker {
+    public:
+        size_t index() const { return m_index; }
+        size_t count() const { return m_count; }
+
+        // Part of [0, size) handled by this worker. Parts are contiguous,
+        // ordered by worker index and depend only on size and count().
+        std::pair<size_t, size_t> range(size_t size) const {
+            return { size * m_index / m_count, size * (m_index + 1) / m_count };
+        }
+
+        // Waits until all workers reach this point. Every worker of a job
+        // must call it the same number of times.
+        void sync();
+
+    private:
+        friend class ThreadPool;
+
+        Worker(ThreadPool* pool, size_t index, size_t count)
+            : m_pool(pool)
+            , m_index(index)
+            , m_count(count) { }
+
+        ThreadPool* m_pool {};
+        size_t m_index {};
+        size_t m_count {};
+    };
+
+    using Job = std::function<void(Worker&)>;
+
+    explicit ThreadPool(size_t thread_count);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    size_t thread_count() const { return m_threads.size() + 1; }
+
+    // Runs the job on all workers and returns after all of them finish.
+    void run(Job const&);
+
+    // Runs the job on the calling thread only, as a single worker.
+    static void run_inline(Job const&);
+
+private:
+    void worker_entry(size_t index);
+
+    std::vector<std::jthread> m_threads;
+    std::barrier<> m_barrier;
+
+    std::mutex m_mutex;
+    std::condition_variable m_job_cv;
+    Job const* m_job {};
+    uint64_t m_job_generation {};
+    bool m_exiting {};
+};
@@ -1,15 +1,8 @@
 #include "Trail.hpp"
 
-#include "Object.hpp"
-#include "glwrapper/Helpers.hpp"
-
-#include <Essa/Engine/3D/Shaders/Basic.hpp>
-#include <Essa/LLGL/Core/Transform.hpp>
-#include <Essa/LLGL/OpenGL/PrimitiveType.hpp>
-#include <Essa/LLGL/OpenGL/Vertex.hpp>
-#include <Essa/LLGL/OpenGL/VertexArray.hpp>
-#include <EssaUtil/DelayedInit.hpp>
+#include <EssaUtil/Constants.hpp>
 #include <EssaUtil/Vector.hpp>
+#include <cassert>
 #include <cmath>
 #include <iostream>
 
@@ -43,14 +36,14 @@ std::pair<Util::Point3f, Util::Point3f> Trail::m_get_last_two_entries() const {
     if (i2 < 0)
         i2 += m_vertexes.size();
 
-    return std::make_pair(m_vertexes[i1].value<0>(), m_vertexes[i2].value<0>());
+    return std::make_pair(m_vertexes[i1], m_vertexes[i2]);
 }
 
 void Trail::push_back(Util::Point3d pos) {
     // Ensure that the trail always has the beginning
     if (m_length == 1) {
         assert(m_append_offset == 1);
-        m_vertexes[m_append_offset] = Vertex { pos.cast<float>() / Util::Constants::AU, m_color };
+        m_vertexes[m_append_offset] = pos.cast<float>() / Util::Constants::AU;
         m_append_offset++;
         m_length++;
     }
@@ -61,13 +54,13 @@ void Trail::push_back(Util::Point3d pos) {
             return;
         }
     }
-    m_vertexes[m_append_offset] = Vertex { pos.cast<float>() / Util::Constants::AU, m_color };
+    m_vertexes[m_append_offset] = pos.cast<float>() / Util::Constants::AU;
 
     m_append_offset++;
     if (static_cast<size_t>(m_length) < m_vertexes.size())
         m_length++;
     if (static_cast<size_t>(m_append_offset) == m_vertexes.size()) {
-        m_vertexes[0] = Vertex { pos.cast<float>() / Util::Constants::AU, m_color };
+        m_vertexes[0] = pos.cast<float>() / Util::Constants::AU;
         m_append_offset = 1;
     }
 
@@ -83,30 +76,15 @@ void Trail::recalculate_with_offset(Util::Vector3d offset) {
     if (m_offset == offset)
         return;
     for (int s = 0; s < m_length; s++)
-        m_vertexes[s].value<0>() = m_vertexes[s].value<0>() + m_offset.cast<float>() / Util::Constants::AU - offset.cast<float>() / Util::Constants::AU;
+        m_vertexes[s] = m_vertexes[s] + m_offset.cast<float>() / Util::Constants::AU - offset.cast<float>() / Util::Constants::AU;
     m_offset = offset;
 }
 
-void Trail::draw(SimulationView const& sv) const {
-    Essa::Shaders::Basic::Uniforms uniforms;
-    uniforms.set_transform(llgl::Transform {}.translate(m_offset.cast<float>() / Util::Constants::AU).matrix(),
-        sv.camera().view_matrix(),
-        sv.projection().matrix());
-
-    if (static_cast<size_t>(m_length) != m_vertexes.size()) {
-        GL::draw_with_temporary_vao<Vertex>(sv.renderer(), sv.basic_shader(), uniforms, llgl::PrimitiveType::LineStrip, { m_vertexes.data() + 1, static_cast<size_t>(m_append_offset - 1) });
-    }
-    else {
-        GL::draw_with_temporary_vao<Vertex>(sv.renderer(), sv.basic_shader(), uniforms, llgl::PrimitiveType::LineStrip, { m_vertexes.data(), static_cast<size_t>(m_append_offset) });
-        GL::draw_with_temporary_vao<Vertex>(sv.renderer(), sv.basic_shader(), uniforms, llgl::PrimitiveType::LineStrip, { m_vertexes.data() + m_append_offset, static_cast<size_t>(m_length - m_append_offset) });
-    }
-}
-
 void Trail::change_current(Util::Point3d pos) {
     assert(m_length > 0);
     if (m_append_offset == 1)
-        m_vertexes[m_length - 1].value<0>() = pos.cast<float>() / Util::Constants::AU;
-    m_vertexes[m_append_offset - 1].value<0>() = pos.cast<float>() / Util::Constants::AU;
+        m_vertexes[m_length - 1] = pos.cast<float>() / Util::Constants::AU;
+    m_vertexes[m_append_offset - 1] = pos.cast<float>() / Util::Constants::AU;
 }
 
 std::ostream& operator<<(std::ostream& out, Trail const& trail) {
@@ -1,23 +1,16 @@
 #pragma once
 
-#include "SimulationView.hpp"
-#include <Essa/Engine/3D/Shaders/Basic.hpp>
+#include <EssaUtil/Color.hpp>
 #include <EssaUtil/Vector.hpp>
 #include <list>
+#include <vector>
 
-class Trail {
-    struct Vertex : public Essa::Shaders::Basic::Vertex {
-        Vertex(Util::Point3f pos, Util::Colorf color)
-            : Essa::Shaders::Basic::Vertex(pos, color, {}) { }
-
-        Vertex()
-            : Essa::Shaders::Basic::Vertex({}, {}, {}) { }
-
-        auto& position() { return value<0>(); }
-        auto& position() const { return value<0>(); }
-    };
+class SimulationView;
 
-    std::vector<Vertex> m_vertexes;
+class Trail {
+    // Positions in AU, relative to m_offset. Turned into vertices only when
+    // drawing, so that the simulation doesn't depend on the renderer.
+    std::vector<Util::Point3f> m_vertexes;
     int m_append_offset = 1;
     int m_length = 0;
     Util::Vector3d m_offset;
@@ -31,7 +24,10 @@ class Trail {
 
 public:
     Trail(size_t max_trail_size, Util::Color color);
+
+    // Defined in the rendering layer (render/Trail.cpp).
     void draw(SimulationView const&) const;
+
     void push_back(Util::Point3d pos);
     void reset();
     void set_offset(Util::Vector3d offset) { m_offset = offset; }
@@ -0,0 +1,300 @@
+#include "Trajectory.hpp"
+
+#include "World.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace Trajectory {
+
+namespace {
+
+// Must be called right after the failed call, before errno changes.
+Util::OsError os_error(char const* function) {
+    Util::OsError error {};
+    error.error = errno;
+    error.function = function;
+    return error;
+}
+
+size_t round_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Samples that the file is grown by at least, so that it isn't remapped for
+// every sample.
+constexpr size_t MinGrowthSamples = 64;
+
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+    : m_fd(std::exchange(other.m_fd, -1))
+    , m_writable(other.m_writable)
+    , m_data(std::exchange(other.m_data, nullptr))
+    , m_size(std::exchange(other.m_size, 0)) { }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+    if (this == &other)
+        return *this;
+    unmap();
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_fd = std::exchange(other.m_fd, -1);
+    m_writable = other.m_writable;
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+    return *this;
+}
+
+Util::ErrorOr<MappedFile, Util::OsError> MappedFile::open(std::string const& path, bool writable, bool create) {
+    int flags = writable ? O_RDWR : O_RDONLY;
+    if (create)
+        flags |= O_CREAT | O_TRUNC;
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return os_error("open");
+
+    MappedFile file;
+    file.m_fd = fd;
+    file.m_writable = writable;
+    return file;
+}
+
+Util::ErrorOr<void, Util::OsError> MappedFile::map(size_t size) {
+    unmap();
+    if (m_writable && ftruncate(m_fd, static_cast<off_t>(size)) < 0)
+        return os_error("ftruncate");
+    if (size == 0)
+        return {};
+
+    auto protection = m_writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    auto* data = mmap(nullptr, size, protection, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED)
+        return os_error("mmap");
+    m_data = static_cast<uint8_t*>(data);
+    m_size = size;
+    return {};
+}
+
+Util::ErrorOr<void, Util::OsError> MappedFile::close(size_t size) {
+    unmap();
+    auto fd = std::exchange(m_fd, -1);
+    if (m_writable && ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        auto error = os_error("ftruncate");
+        ::close(fd);
+        return error;
+    }
+    if (::close(fd) < 0)
+        return os_error("close");
+    return {};
+}
+
+Util::ErrorOr<size_t, Util::OsError> MappedFile::file_size() const {
+    struct stat stat;
+    if (fstat(m_fd, &stat) < 0)
+        return os_error("fstat");
+    return static_cast<size_t>(stat.st_size);
+}
+
+void MappedFile::unmap() {
+    if (m_data)
+        munmap(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+Writer::~Writer() {
+    if (m_file.is_open())
+        (void)close();
+}
+
+Util::ErrorOr<Writer, Util::OsError> Writer::create(std::string const& path, World& world, int64_t sample_interval) {
+    Writer writer;
+    std::vector<ObjectEntry> entries;
+    world.for_each_object([&](Object& object) {
+        writer.m_object_ids.push_back(object.id());
+        ObjectEntry entry {};
+        auto name = object.name().encode();
+        auto length = std::min(name.size(), sizeof(entry.name));
+        // Don't cut a UTF-8 sequence in half.
+        while (length < name.size() && length > 0 && (static_cast<uint8_t>(name[length]) & 0xc0) == 0x80)
+            length--;
+        std::memcpy(entry.name, name.data(), length);
+        entry.mass = object.mass();
+        entry.radius = object.radius();
+        auto color = object.color();
+        entry.color[0] = color.r;
+        entry.color[1] = color.g;
+        entry.color[2] = color.b;
+        entry.color[3] = color.a;
+        entry.id = object.id();
+        entries.push_back(entry);
+    });
+
+    writer.m_header_size = round_up(sizeof(FileHeader) + entries.size() * sizeof(ObjectEntry), sizeof(FileHeader));
+    writer.m_sample_size = sizeof(SampleHeader) + entries.size() * sizeof(Body);
+    writer.m_file = TRY(MappedFile::open(path, true, true));
+    TRY(writer.m_file.map(writer.file_size(MinGrowthSamples)));
+
+    auto& header = writer.header();
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.header_size = static_cast<uint32_t>(writer.m_header_size);
+    header.object_count = writer.object_count();
+    header.sample_size = writer.m_sample_size;
+    header.sample_count = 0;
+    header.sample_interval = sample_interval;
+    std::copy(entries.begin(), entries.end(), reinterpret_cast<ObjectEntry*>(writer.m_file.data() + sizeof(FileHeader)));
+    return writer;
+}
+
+Util::ErrorOr<void, Util::OsError> Writer::append(World& world) {
+    auto const tick = world.tick();
+    if (m_last_tick && tick <= *m_last_tick)
+        return {};
+
+    if (file_size(m_sample_count + 1) > m_file.size())
+        TRY(m_file.map(file_size(std::max(m_sample_count * 2, MinGrowthSamples))));
+
+    auto* sample = m_file.data() + file_size(m_sample_count);
+    *reinterpret_cast<SampleHeader*>(sample) = {
+        .tick = tick,
+        .date = std::chrono::duration_cast<std::chrono::seconds>(world.date().time_since_epoch()).count(),
+    };
+
+    auto* bodies = reinterpret_cast<Body*>(sample + sizeof(SampleHeader));
+    constexpr auto NaN = std::numeric_limits<double>::quiet_NaN();
+    std::fill(bodies, bodies + object_count(), Body { .pos = { NaN, NaN, NaN }, .vel = { NaN, NaN, NaN } });
+    // World keeps objects in order of their ids, so both lists are walked
+    // together; ids that are skipped belong to removed objects.
+    size_t index = 0;
+    world.for_each_object([&](Object& object) {
+        while (index < object_count() && m_object_ids[index] < object.id())
+            index++;
+        if (index >= object_count() || m_object_ids[index] != object.id())
+            return;
+        auto& body = bodies[index++];
+        if (object.deleted())
+            return;
+        auto pos = object.pos();
+        auto vel = object.vel();
+        body = {
+            .pos = { pos.x(), pos.y(), pos.z() },
+            .vel = { vel.x(), vel.y(), vel.z() },
+        };
+    });
+
+    // Readers that map the file while it is written see the sample only
+    // once it is complete.
+    std::atomic_ref<uint64_t>(header().sample_count).store(++m_sample_count, std::memory_order_release);
+    m_last_tick = tick;
+    return {};
+}
+
+Util::ErrorOr<void, Util::OsError> Writer::close() {
+    if (!m_file.is_open())
+        return {};
+    return m_file.close(file_size(m_sample_count));
+}
+
+Util::ErrorOr<Reader, Util::ParseError, Util::OsError> Reader::open(std::string const& path) {
+    auto invalid = [](std::string message) -> Util::ParseError { return { std::move(message), {} }; };
+
+    Reader reader;
+    reader.m_file = TRY(MappedFile::open(path, false, false));
+    auto const size = TRY(reader.m_file.file_size());
+    if (size < sizeof(FileHeader))
+        return invalid("Not a trajectory file");
+    TRY(reader.m_file.map(size));
+
+    FileHeader header;
+    std::memcpy(&header, reader.m_file.data(), sizeof(header));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0)
+        return invalid("Not a trajectory file");
+    if (header.version != 1 && header.version != Version)
+        return invalid("Unsupported trajectory file version " + std::to_string(header.version));
+    auto const max_object_count = (size - sizeof(FileHeader)) / sizeof(ObjectEntry);
+    if (header.object_count > max_object_count || header.header_size > size
+        || header.header_size < sizeof(FileHeader) + header.object_count * sizeof(ObjectEntry)
+        || header.sample_size != sizeof(SampleHeader) + header.object_count * sizeof(Body))
+        return invalid("Corrupted trajectory file header");
+
+    reader.m_sample_interval = header.sample_interval;
+    reader.m_header_size = header.header_size;
+    reader.m_sample_size = header.sample_size;
+
+    auto const* entries = reinterpret_cast<ObjectEntry const*>(reader.m_file.data() + sizeof(FileHeader));
+    for (size_t s = 0; s < header.object_count; s++) {
+        auto const& entry = entries[s];
+        reader.m_objects.push_back({
+            .id = header.version == 1 ? s : entry.id,
+            .name = std::string(entry.name, strnlen(entry.name, sizeof(entry.name))),
+            .mass = entry.mass,
+            .radius = entry.radius,
+            .color = { entry.color[0], entry.color[1], entry.color[2], entry.color[3] },
+        });
+    }
+
+    TRY(reader.refresh());
+    return reader;
+}
+
+Sample Reader::sample(size_t index) const {
+    assert(index < m_sample_count);
+    auto const& header = sample_header(index);
+    auto const* bodies = reinterpret_cast<Body const*>(m_file.data() + m_header_size + index * m_sample_size + sizeof(SampleHeader));
+    return {
+        .tick = header.tick,
+        .date = Util::SimulationClock::time_point(std::chrono::duration_cast<Util::SimulationClock::duration>(std::chrono::seconds(header.date))),
+        .bodies = { bodies, m_objects.size() },
+    };
+}
+
+std::optional<size_t> Reader::find_sample(int64_t tick) const {
+    size_t first = 0;
+    size_t last = m_sample_count;
+    while (first < last) {
+        auto const middle = first + (last - first) / 2;
+        if (sample_header(middle).tick <= tick)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    if (first == 0)
+        return {};
+    return first - 1;
+}
+
+Util::ErrorOr<void, Util::OsError> Reader::refresh() {
+    auto const size = TRY(m_file.file_size());
+    if (size != m_file.size())
+        TRY(m_file.map(size));
+
+    // The writer preallocates the file, so it may be longer than the samples
+    // written until it is closed.
+    auto const sample_count = std::atomic_ref<uint64_t>(reinterpret_cast<FileHeader*>(m_file.data())->sample_count).load(std::memory_order_acquire);
+    m_sample_count = std::min<size_t>(sample_count, (m_file.size() - m_header_size) / m_sample_size);
+    return {};
+}
+
+SampleHeader const& Reader::sample_header(size_t index) const {
+    return *reinterpret_cast<SampleHeader const*>(m_file.data() + m_header_size + index * m_sample_size);
+}
+
+}
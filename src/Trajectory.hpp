@@ -0,0 +1,203 @@
+#pragma once
+
+#include <EssaUtil/Color.hpp>
+#include <EssaUtil/Error.hpp>
+#include <EssaUtil/SimulationClock.hpp>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+class World;
+
+// Trajectory files store positions and velocities of all objects every few
+// ticks, for long batch runs (essa-sim --trajectory, played back with
+// --replay). They are written by appending to a memory-mapped file and can
+// be read without any parsing, e.g. with numpy.memmap (see
+// tests/analyze.py).
+//
+// Layout, all little-endian:
+//  - FileHeader (64 bytes),
+//  - object_count ObjectEntry records (96 bytes each), padded with zeros up
+//    to header_size,
+//  - sample_count samples of sample_size bytes: SampleHeader (16 bytes),
+//    then a Body (48 bytes) for every object, in the order of the table.
+//
+// Ticks of samples increase, so a sample is found by tick with a binary
+// search. Objects that don't exist at the date of a sample have NaN
+// positions and velocities.
+namespace Trajectory {
+
+static_assert(std::endian::native == std::endian::little);
+
+constexpr char Magic[8] = { 'E', 'S', 'S', 'A', 'T', 'R', 'A', 'J' };
+// Version 1 files have no object ids, see ObjectEntry::id.
+constexpr uint32_t Version = 2;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    // Offset of the first sample.
+    uint32_t header_size;
+    uint64_t object_count;
+    uint64_t sample_size;
+    // Updated after every sample is written completely, so that a reader
+    // never sees a partial sample.
+    uint64_t sample_count;
+    // Ticks between samples.
+    int64_t sample_interval;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(FileHeader) == 64);
+
+struct ObjectEntry {
+    // UTF-8, padded with zeros. Longer names are truncated.
+    char name[64];
+    double mass;
+    double radius;
+    uint8_t color[4];
+    uint8_t reserved[4];
+    // Object::id() at the time of recording, so that objects can be found in
+    // a world where others were added or removed. Version 1 files have zeros
+    // here; their entries get their index instead.
+    uint64_t id;
+};
+static_assert(sizeof(ObjectEntry) == 96);
+
+struct SampleHeader {
+    // World ticks done since the start, minus ticks done backward.
+    int64_t tick;
+    // Seconds since the simulation clock epoch.
+    int64_t date;
+};
+static_assert(sizeof(SampleHeader) == 16);
+
+// SI units.
+struct Body {
+    double pos[3];
+    double vel[3];
+};
+static_assert(sizeof(Body) == 48);
+
+struct ObjectInfo {
+    uint64_t id;
+    std::string name;
+    double mass;
+    double radius;
+    Util::Color color;
+};
+
+struct Sample {
+    int64_t tick;
+    Util::SimulationClock::time_point date;
+    std::span<Body const> bodies;
+};
+
+// Maps a file into memory and unmaps it when destroyed.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    MappedFile(MappedFile&&);
+    MappedFile& operator=(MappedFile&&);
+
+    // Opens the file read-only unless `writable`; `create` also truncates it.
+    static Util::ErrorOr<MappedFile, Util::OsError> open(std::string const& path, bool writable, bool create);
+
+    // Remaps the file with the given size. A writable file is resized to it.
+    Util::ErrorOr<void, Util::OsError> map(size_t size);
+    // Truncates a writable file to `size` and closes it.
+    Util::ErrorOr<void, Util::OsError> close(size_t size);
+
+    Util::ErrorOr<size_t, Util::OsError> file_size() const;
+
+    bool is_open() const { return m_fd >= 0; }
+    uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    void unmap();
+
+    int m_fd = -1;
+    bool m_writable = false;
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// Appends samples of the objects that were in the world when the file was
+// created. Objects are matched by Object::id(), so removing objects doesn't
+// shift the others; removed objects get NaN like deleted ones, and objects
+// added later are not recorded.
+class Writer {
+public:
+    static Util::ErrorOr<Writer, Util::OsError> create(std::string const& path, World&, int64_t sample_interval);
+
+    ~Writer();
+    Writer(Writer&&) = default;
+    Writer& operator=(Writer&&) = default;
+
+    // Writes the current state of the world. Samples whose tick isn't after
+    // the last one are ignored, so that ticks stay sorted.
+    Util::ErrorOr<void, Util::OsError> append(World&);
+
+    // Truncates the file to the samples written and closes it. Done when
+    // the writer is destroyed, but errors are only reported from here.
+    Util::ErrorOr<void, Util::OsError> close();
+
+    size_t sample_count() const { return m_sample_count; }
+
+private:
+    Writer() = default;
+
+    FileHeader& header() const { return *reinterpret_cast<FileHeader*>(m_file.data()); }
+    size_t file_size(size_t samples) const { return m_header_size + samples * m_sample_size; }
+    size_t object_count() const { return m_object_ids.size(); }
+
+    MappedFile m_file;
+    // Ids of the objects in the table, increasing like in World's list.
+    std::vector<uint64_t> m_object_ids;
+    size_t m_header_size = 0;
+    size_t m_sample_size = 0;
+    size_t m_sample_count = 0;
+    std::optional<int64_t> m_last_tick;
+};
+
+class Reader {
+public:
+    static Util::ErrorOr<Reader, Util::ParseError, Util::OsError> open(std::string const& path);
+
+    std::vector<ObjectInfo> const& objects() const { return m_objects; }
+    int64_t sample_interval() const { return m_sample_interval; }
+
+    size_t sample_count() const { return m_sample_count; }
+    Sample sample(size_t index) const;
+
+    // Index of the last sample at or before `tick`, or nothing if all
+    // samples are after it.
+    std::optional<size_t> find_sample(int64_t tick) const;
+
+    // Picks up samples appended since the file was opened, if it is still
+    // being written.
+    Util::ErrorOr<void, Util::OsError> refresh();
+
+private:
+    Reader() = default;
+
+    SampleHeader const& sample_header(size_t index) const;
+
+    MappedFile m_file;
+    std::vector<ObjectInfo> m_objects;
+    int64_t m_sample_interval = 0;
+    size_t m_header_size = 0;
+    size_t m_sample_size = 0;
+    size_t m_sample_count = 0;
+};
+
+}
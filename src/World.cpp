@@ -1,13 +1,11 @@
 // keep first!
 #include <EssaUtil/Error.hpp>
 #include <EssaUtil/GenericParser.hpp>
-#include <GL/glew.h>
 
 #include "ConfigLoader.hpp"
 #include "Object.hpp"
-#include "SimulationView.hpp"
 #include "World.hpp"
-#include "essagui/EssaGUI.hpp"
+#include "gravity/Direct.hpp"
 #include "pyssa/Object.hpp"
 #include "pyssa/TupleParser.hpp"
 
@@ -15,7 +13,11 @@
 #include <EssaUtil/Vector.hpp>
 
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fmt/core.h>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <sstream>
 
@@ -29,57 +31,286 @@ World::World()
 void World::add_object(std::unique_ptr<Object> object) {
     object->m_world = this;
     object->m_creation_date = m_date;
+
+    // Objects created after the current date belong to a future that this
+    // one replaces. Objects are added in order of creation, so they are the
+    // last ones.
+    while (!m_object_list.empty() && m_object_list.back()->creation_date() > m_date)
+        take_object(m_object_list.size() - 1);
+
+    m_object_history.add_event(m_date, object.get());
+    push_object(std::move(object));
+}
+
+void World::push_object(std::unique_ptr<Object> object) {
+    auto index = m_physics.append(object->m_detached_state);
+    object->attach_physics(m_physics, index);
+    object->m_id = m_next_object_id++;
     m_object_list.push_back(std::move(object));
+    m_hierarchy.append();
+    m_hierarchy_valid = false;
+    m_history.append(m_physics);
+    m_keyframe_pending = true;
+    m_alive_flags_valid = false;
+    m_last_force_inputs.valid = false;
+}
+
+std::unique_ptr<Object> World::take_object(size_t index) {
+    auto object = std::move(m_object_list[index]);
+    object->detach_physics();
+    m_object_list.erase(m_object_list.begin() + index);
+    m_object_history.remove_events(object.get());
+    m_physics.erase(index);
+    for (size_t s = index; s < m_object_list.size(); s++)
+        m_object_list[s]->m_physics_index = s;
+    m_hierarchy.erase(index);
+    m_hierarchy_valid = false;
+    m_alive_flags_valid = false;
+    m_reversible_composition.erase(index);
+    m_history.erase(index);
+    m_keyframes.erase(index);
+    m_keyframe_pending = true;
+    m_last_force_inputs.valid = false;
+    return object;
+}
+
+// Objects are created and deleted at given dates, so alive flags change only
+// when the date crosses one of them, which update_timeline() catches. All of
+// them are checked only after objects were added, removed or deleted.
+void World::update_alive_flags() {
+    if (m_alive_flags_valid)
+        return;
 
-    if (m_object_history.set_time(m_date))
-        m_object_history.clear_history(m_object_history.get_pos());
+    bool changed = false;
+    for (size_t s = 0; s < m_object_list.size(); s++) {
+        auto const& object = *m_object_list[s];
+        uint8_t const alive = !object.deleted();
+        if (m_physics.alive[s] != alive)
+            changed = true;
+        m_physics.alive[s] = alive;
+    }
+    if (changed) {
+        m_physics.update_active();
+        m_hierarchy_valid = false;
+    }
+    m_alive_flags_valid = true;
+}
 
-    m_object_list.remove_if([&](std::unique_ptr<Object>& obj) {
-        return obj->creation_date() > m_date;
+void World::update_timeline() {
+    bool changed = false;
+    m_object_history.set_time(m_date, [&](Object& object) {
+        auto const s = object.m_physics_index;
+        uint8_t const alive = !object.deleted();
+        if (m_physics.alive[s] != alive)
+            changed = true;
+        m_physics.alive[s] = alive;
     });
+    if (changed) {
+        m_physics.update_active();
+        m_hierarchy_valid = false;
+    }
+}
+
+void World::update_hierarchy() {
+    auto const interval = m_adaptive_tick ? 1 : HierarchyUpdateInterval;
+    if (m_hierarchy_valid && m_ticks_since_hierarchy_update < interval)
+        return;
+    m_hierarchy.build(m_physics);
+    m_hierarchy_valid = true;
+    m_ticks_since_hierarchy_update = 0;
 }
 
 void World::set_forces() {
-    for (auto& p : m_object_list) {
-        if (!p->deleted())
-            p->clear_forces();
-    }
-
-    for (auto it = m_object_list.begin(); it != m_object_list.end(); it++) {
-        auto it2 = it;
-        auto& this_object = **it;
-        it2++;
-        for (; it2 != m_object_list.end(); it2++) {
-            if (!this_object.deleted() && !(*it2)->deleted())
-                this_object.update_forces_against(**it2);
+    ThreadPool::run_inline([this](ThreadPool::Worker& worker) { set_forces(worker); });
+}
+
+void World::set_forces(ThreadPool::Worker& worker) {
+    auto& state = m_physics;
+    auto const [first, last] = worker.range(state.active.size());
+
+    // Wait for positions to be updated by all workers.
+    worker.sync();
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        state.acc_x[s] = 0;
+        state.acc_y[s] = 0;
+        state.acc_z[s] = 0;
+    }
+
+    switch (m_gravity_solver) {
+    case Gravity::Solver::Direct:
+        if (worker.count() == 1) {
+            m_direct.compute(state);
+            break;
         }
+        if (worker.index() == 0)
+            m_direct.prepare(state);
+        worker.sync();
+        m_direct.accumulate(state, first, last);
+        break;
+    case Gravity::Solver::DirectSymmetric:
+        if (worker.index() == 0)
+            m_tiled_direct.prepare(state);
+        worker.sync();
+        m_tiled_direct.process_tiles(worker);
+        worker.sync();
+        m_tiled_direct.reduce(state, first, last);
+        break;
+    case Gravity::Solver::BarnesHut:
+        if (worker.index() == 0)
+            m_barnes_hut.build(state);
+        worker.sync();
+        m_barnes_hut.accumulate(state, first, last);
+        break;
+    case Gravity::Solver::FastMultipole:
+        m_fast_multipole.compute(state, worker);
+        break;
     }
+
+    // Wait for forces of all objects.
+    worker.sync();
 }
 
-void World::update_history_and_date(bool reverse) {
-    if (!m_is_forward_simulated) {
-        m_object_history.set_time(m_date);
-        std::unique_ptr<Object>& last_created = m_object_list.back();
+bool World::forces_are_current() const {
+    auto const& inputs = m_last_force_inputs;
+    auto const& state = m_physics;
+    if (!inputs.valid
+        || inputs.solver != m_gravity_solver
+        || inputs.opening_angle != m_barnes_hut.opening_angle()
+        || inputs.expansion_order != m_fast_multipole.expansion_order()
+        || inputs.active != state.active)
+        return false;
+    for (size_t a = 0; a < state.active.size(); a++) {
+        auto const s = state.active[a];
+        if (inputs.pos_x[a] != state.pos_x[s] || inputs.pos_y[a] != state.pos_y[s] || inputs.pos_z[a] != state.pos_z[s]
+            || inputs.gravity_factor[a] != state.gravity_factor[s])
+            return false;
+    }
+    return true;
+}
 
-        if (!reverse) {
-            m_date += Util::SimulationClock::duration(m_simulation_seconds_per_tick);
+void World::record_force_inputs(ThreadPool::Worker& worker) {
+    auto const& state = m_physics;
+    auto const [first, last] = worker.range(state.active.size());
+    auto& inputs = m_last_force_inputs;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        inputs.pos_x[a] = state.pos_x[s];
+        inputs.pos_y[a] = state.pos_y[s];
+        inputs.pos_z[a] = state.pos_z[s];
+        inputs.gravity_factor[a] = state.gravity_factor[s];
+    }
+}
 
-            if (m_object_history.size() > 0) {
-                if (last_created->creation_date() <= m_date) {
-                    m_object_list.push_back(std::move(m_object_history.pop_from_entries()));
-                }
-            }
-        }
-        else {
-            m_date -= Util::SimulationClock::duration(m_simulation_seconds_per_tick);
-
-            if (m_object_history.size() > 0) {
-                if (last_created->creation_date() > m_date) {
-                    m_object_history.push_to_entry(std::move(m_object_list.back()));
-                    m_object_list.pop_back();
-                }
-            }
-        }
+std::vector<Gravity::AccuracyReportEntry> World::gravity_accuracy_report() const {
+    static constexpr unsigned ExpansionOrders[] { 2, 3, 4, 5, 6, 8 };
+    return Gravity::make_accuracy_report(m_physics, m_barnes_hut.opening_angle(), ExpansionOrders);
+}
+
+void World::set_adaptive_tick(bool adaptive_tick) {
+    m_adaptive_tick = adaptive_tick;
+    // Start from the timescale, not from the fixed tick.
+    m_tick_length = 0;
+}
+
+void World::set_keyframe_interval(unsigned interval) {
+    m_keyframe_interval = interval;
+    m_keyframes.clear();
+    m_keyframe_pending = true;
+}
+
+int World::next_tick_length(bool reverse) {
+    if (m_is_forward_simulated)
+        return m_adaptive_tick ? choose_tick_length() : m_simulation_seconds_per_tick;
+
+    auto& replayed = reverse ? m_past_ticks : m_future_ticks;
+    auto& recorded = reverse ? m_future_ticks : m_past_ticks;
+    int length = !replayed.empty() ? replayed.pop() : m_adaptive_tick ? choose_tick_length() : m_simulation_seconds_per_tick;
+    recorded.push(length);
+    // Reversible ticks and keyframes can go back any number of ticks.
+    if (!uses_reversible_composition() && !uses_keyframes())
+        recorded.trim(std::max(m_history.size() + 1, MinRecordedTicks));
+    return length;
+}
+
+void World::TickRuns::push(int length) {
+    if (!runs.empty() && runs.back().length == length)
+        runs.back().count++;
+    else
+        runs.push_back({ length, 1 });
+    count++;
+}
+
+int World::TickRuns::pop() {
+    auto const length = runs.back().length;
+    if (--runs.back().count == 0)
+        runs.pop_back();
+    count--;
+    return length;
+}
+
+void World::TickRuns::trim(size_t max_count) {
+    while (count > max_count) {
+        auto const dropped = std::min(runs.front().count, count - max_count);
+        runs.front().count -= dropped;
+        count -= dropped;
+        if (runs.front().count == 0)
+            runs.pop_front();
+    }
+}
+
+void World::TickRuns::clear() {
+    runs.clear();
+    count = 0;
+}
+
+// Every object is paired with its parent in the hierarchy. The timescale of
+// a pair is the shorter of the orbital (or free-fall) timescale
+// sqrt(r^3 / G(m1 + m2)) and the time to cover their distance with their
+// relative velocity, which catches fast flybys. The tick is a fraction of the
+// shortest one.
+int World::choose_tick_length() {
+    auto const& state = m_physics;
+    update_hierarchy();
+
+    double min_timescale_squared = std::numeric_limits<double>::infinity();
+    for (auto const s : state.active) {
+        auto other = m_hierarchy.parent(s);
+        if (other == Hierarchy::NoParent || !state.alive[other])
+            continue;
+        double const dx = state.pos_x[other] - state.pos_x[s];
+        double const dy = state.pos_y[other] - state.pos_y[s];
+        double const dz = state.pos_z[other] - state.pos_z[s];
+        double const distance_squared = dx * dx + dy * dy + dz * dz;
+        if (distance_squared == 0)
+            continue;
+
+        double const gravity_factor = state.gravity_factor[s] + state.gravity_factor[other];
+        if (gravity_factor > 0)
+            min_timescale_squared = std::min(min_timescale_squared, distance_squared * std::sqrt(distance_squared) / gravity_factor);
+
+        double const dvx = state.vel_x[other] - state.vel_x[s];
+        double const dvy = state.vel_y[other] - state.vel_y[s];
+        double const dvz = state.vel_z[other] - state.vel_z[s];
+        double const speed_squared = dvx * dvx + dvy * dvy + dvz * dvz;
+        if (speed_squared > 0)
+            min_timescale_squared = std::min(min_timescale_squared, distance_squared / speed_squared);
+    }
+
+    double const max_length = std::max(m_simulation_seconds_per_tick, 1);
+    double length = m_adaptive_tick_accuracy * std::sqrt(min_timescale_squared);
+    if (m_tick_length > 0)
+        length = std::clamp(length, m_tick_length * MaxTickShrink, std::max(m_tick_length * MaxTickGrowth, m_tick_length + 1.0));
+    return static_cast<int>(std::clamp(length, 1.0, max_length));
+}
+
+void World::update_history_and_date(bool reverse) {
+    if (!m_is_forward_simulated) {
+        if (!reverse)
+            m_date += Util::SimulationClock::duration(m_tick_length);
+        else
+            m_date -= Util::SimulationClock::duration(m_tick_length);
+        update_timeline();
     }
 }
 
@@ -88,53 +319,309 @@ void World::update(int steps) {
     bool reverse = steps < 0;
 
     for (unsigned i = 0; i < std::abs(steps); i++) {
-        update_history_and_date(reverse);
+        if (reverse && m_history.size() == 0 && uses_keyframes())
+            rewind_to_keyframe();
+        tick(reverse);
 
-        for (auto& obj : m_object_list)
-            obj->before_update();
+        // if ((m_date - m_start_date).count() > 24 * 60 * 60 * 50) {
+        //     std::cout << "FINISHED" << std::endl;
+        //     _exit(0);
+        // }
+    }
+}
+
+void World::tick(bool reverse) {
+    auto const date = m_date;
+    auto const tick_length = m_tick_length;
+    m_tick_length = next_tick_length(reverse);
+    update_history_and_date(reverse);
+    // After update_history_and_date(), so that objects it adds are
+    // saved with their initial state.
+    if (uses_keyframes() && !m_replaying_keyframe && (m_keyframe_pending || (!reverse && m_tick % m_keyframe_interval == 0))) {
+        m_keyframes.save(m_tick, date, tick_length, m_physics, m_test_particles);
+        m_keyframe_pending = false;
+    }
+    m_tick += reverse ? -1 : 1;
+    update_alive_flags();
+    update_hierarchy();
+
+    bool const reuse_forces = forces_are_current();
+    bool const reuse_test_particle_forces = m_test_particle_forces_valid && m_test_particle_gravity.is_prepared_for(m_physics);
+    auto& inputs = m_last_force_inputs;
+    auto const active_count = m_physics.active.size();
+    inputs.active = m_physics.active;
+    inputs.pos_x.resize(active_count);
+    inputs.pos_y.resize(active_count);
+    inputs.pos_z.resize(active_count);
+    inputs.gravity_factor.resize(active_count);
+    inputs.solver = m_gravity_solver;
+    inputs.opening_angle = m_barnes_hut.opening_angle();
+    inputs.expansion_order = m_fast_multipole.expansion_order();
+
+    // Ticks forward record the state before them, and ticks back in time
+    // replay it. Without history left, they are integrated backward.
+    // Reversible ticks retrace themselves, so there is nothing to record.
+    std::optional<History::Move> history_move;
+    if (!m_is_forward_simulated && !uses_reversible_composition()) {
+        if (!reverse)
+            history_move = m_history.move_forward();
+        else if (m_history.size() > 0)
+            history_move = m_history.move_backward();
+    }
+
+    // Splitting into threads doesn't change results, so don't bother
+    // for small worlds where synchronization would dominate.
+    auto job = [this, reverse, reuse_forces, reuse_test_particle_forces, history_move](ThreadPool::Worker& worker) {
+        update_objects(worker, reverse, reuse_forces, reuse_test_particle_forces, history_move);
+    };
+    if (m_thread_count > 1 && m_physics.size() + m_test_particles.size() >= MinObjectsForThreads) {
+        if (!m_thread_pool || m_thread_pool->thread_count() != m_thread_count)
+            m_thread_pool = std::make_unique<ThreadPool>(m_thread_count);
+        m_thread_pool->run(job);
+    }
+    else {
+        ThreadPool::run_inline(job);
+    }
+    if (uses_reversible_composition() && m_reversible_composition.left_range()) {
+        fmt::print("Objects left the range of reversible ticks, continuing with irreversible ones\n");
+        m_reversible = false;
+    }
+    inputs.valid = !(history_move && history_move->replay) && integrator_ends_with_forces();
+    m_test_particle_forces_valid = true;
+    m_ticks_since_hierarchy_update++;
+}
 
-        // The algorithm used is Leapfrog KDK
-        // http://courses.physics.ucsd.edu/2019/Winter/physics141/Lectures/Lecture2/volker.pdf
-        double step = m_simulation_seconds_per_tick;
-        double halfStep = (step / 2.0);
+bool World::uses_keyframes() const {
+    return m_keyframe_interval > 0 && !m_is_forward_simulated && !uses_reversible_composition();
+}
+
+// Restores the last keyframe and integrates forward back to the current tick,
+// recording history on the way, so that the following ticks back in time
+// replay it. Forces of every gravity solver depend only on positions (not on
+// thread count or scheduling), so the replayed ticks are the original ones.
+void World::rewind_to_keyframe() {
+    auto const* keyframe = m_keyframes.last_before(m_tick);
+    if (!keyframe)
+        return;
+    auto const ticks = m_tick - keyframe->tick;
 
-        double mul = (steps >= 0) ? 1 : -1;
+    // Ticks since the keyframe are done again with the same lengths.
+    if (static_cast<int64_t>(m_past_ticks.count) < ticks)
+        return;
+    for (int64_t t = 0; t < ticks; t++)
+        m_future_ticks.push(m_past_ticks.pop());
 
-        // calculate forces/accelerations based on current postions
-        this->set_forces();
+    m_keyframes.restore(*keyframe, m_physics, m_test_particles);
+    m_date = keyframe->date;
+    update_timeline();
+    m_tick = keyframe->tick;
+    m_tick_length = keyframe->tick_length;
+    m_alive_flags_valid = false;
+    m_hierarchy_valid = false;
+    m_last_force_inputs.valid = false;
+    m_test_particle_forces_valid = false;
+    m_history.reset();
+
+    m_replaying_keyframe = true;
+    for (int64_t t = 0; t < ticks; t++)
+        tick(false);
+    m_replaying_keyframe = false;
+}
 
-        for (auto& obj : m_object_list) // for each celestial body
-        {
-            if (obj->deleted())
-                continue;
+void World::update_objects(ThreadPool::Worker& worker, bool reverse, bool reuse_forces, bool reuse_test_particle_forces, std::optional<History::Move> history_move) {
+    auto& state = m_physics;
+    auto const [first, last] = worker.range(state.active.size());
 
-            // Leapfrog algorithm, step 1
-            obj->set_vel(obj->vel() + obj->acc() * halfStep * mul);
+    for (size_t a = first; a < last; a++)
+        m_object_list[state.active[a]]->before_update();
 
-            // Leapfrog algorithm, step 2
-            obj->set_pos(obj->pos() + obj->vel() * step * mul);
+    double const tick = reverse ? -m_tick_length : m_tick_length;
+    if (history_move && !history_move->replay) {
+        auto const [object_first, object_last] = worker.range(state.size());
+        m_history.record(*history_move, state, object_first, object_last);
+        worker.sync();
+    }
+    begin_test_particle_step(worker, tick, reuse_test_particle_forces);
+    if (history_move && history_move->replay) {
+        // Test particles read positions of objects in
+        // begin_test_particle_step().
+        worker.sync();
+        auto const [object_first, object_last] = worker.range(state.size());
+        m_history.replay(*history_move, state, object_first, object_last);
+    }
+    else {
+        integrate(worker, tick, reverse, reuse_forces);
+    }
+
+    // Nonphysical updates look at positions of other objects (e.g trails
+    // relative to the parent object), so wait for all of them.
+    worker.sync();
+    end_test_particle_step(worker, tick);
+    if (m_replaying_keyframe)
+        return;
+    for (size_t a = first; a < last; a++)
+        m_object_list[state.active[a]]->nonphysical_update();
+}
+
+void World::integrate(ThreadPool::Worker& worker, double tick, bool reverse, bool reuse_forces) {
+    auto& state = m_physics;
+    switch (m_integrator) {
+    case Integrator::Method::Hermite:
+        m_hermite.step(state, tick, worker);
+        break;
+    case Integrator::Method::WisdomHolman:
+        m_wisdom_holman.step(state, tick, worker, reuse_forces, [this, &worker]() { set_forces(worker); });
+        // Positions didn't change since the last evaluation.
+        record_force_inputs(worker);
+        break;
+    case Integrator::Method::IAS15:
+        m_ias15.step(state, tick, worker, reuse_forces, [this, &worker]() { set_forces(worker); });
+        record_force_inputs(worker);
+        break;
+    default:
+        if (m_reversible) {
+            m_reversible_composition.step(state, Integrator::composition(m_integrator), tick, worker, reuse_forces,
+                [this, &worker]() { set_forces(worker); });
+            record_force_inputs(worker);
+            break;
         }
+        composition_step(worker, Integrator::composition(m_integrator), reverse, reuse_forces);
+        break;
+    }
 
-        // calculate the forces using the new positions
-        this->set_forces();
+    // Not done for replayed ticks, so Hermite detects them as modified and
+    // starts over.
+    if (m_integrator == Integrator::Method::Hermite)
+        m_hermite.record_state(state, worker);
+}
 
-        for (auto& obj : m_object_list) // for each celestial body
-        {
-            if (obj->deleted())
-                continue;
+// Test particles are advanced with Leapfrog (kick-drift-kick) regardless of
+// the integrator, because it needs forces only at the beginning and at the
+// end of the tick, when positions of all objects are known.
+void World::begin_test_particle_step(ThreadPool::Worker& worker, double tick, bool reuse_forces) {
+    auto& particles = m_test_particles;
+    if (particles.size() == 0)
+        return;
+    if (!reuse_forces)
+        set_test_particle_forces(worker);
 
-            // Leapfrog algorithm, step 3
-            obj->set_vel(obj->vel() + obj->acc() * halfStep * mul);
+    auto const [first, last] = worker.range(particles.size());
+    double const half_tick = tick / 2;
+    for (size_t p = first; p < last; p++) {
+        particles.vel_x[p] += particles.acc_x[p] * half_tick;
+        particles.vel_y[p] += particles.acc_y[p] * half_tick;
+        particles.vel_z[p] += particles.acc_z[p] * half_tick;
+        particles.pos_x[p] += particles.vel_x[p] * tick;
+        particles.pos_y[p] += particles.vel_y[p] * tick;
+        particles.pos_z[p] += particles.vel_z[p] * tick;
+    }
+}
 
-            obj->update(m_simulation_seconds_per_tick);
+void World::end_test_particle_step(ThreadPool::Worker& worker, double tick) {
+    auto& particles = m_test_particles;
+    if (particles.size() == 0)
+        return;
+    set_test_particle_forces(worker);
 
-            // std::cerr << m_date.time_since_epoch().count() << ";" << obj->name() << ";" << obj->pos() << ";" << obj->vel() << ";" << std::endl;
+    auto const [first, last] = worker.range(particles.size());
+    double const half_tick = tick / 2;
+    for (size_t p = first; p < last; p++) {
+        particles.vel_x[p] += particles.acc_x[p] * half_tick;
+        particles.vel_y[p] += particles.acc_y[p] * half_tick;
+        particles.vel_z[p] += particles.acc_z[p] * half_tick;
+    }
+
+    // Positions of all particles were final since the sync in
+    // set_test_particle_forces(). Trails already went through the ticks
+    // replayed from a keyframe.
+    if (worker.index() == 0 && !m_replaying_keyframe) {
+        for (auto& [index, trail] : particles.trails)
+            trail.push_back(Util::Point3d::from_deprecated_vector(particles.pos(index)));
+    }
+}
+
+void World::set_test_particle_forces(ThreadPool::Worker& worker) {
+    if (worker.index() == 0)
+        m_test_particle_gravity.prepare(m_physics);
+    worker.sync();
+    auto const [first, last] = worker.range(m_test_particles.size());
+    m_test_particle_gravity.compute(m_test_particles, first, last);
+}
+
+// Kicks and drifts of a composition (see Integrator::Composition). With
+// Leapfrog KDK, it is:
+// http://courses.physics.ucsd.edu/2019/Winter/physics141/Lectures/Lecture2/volker.pdf
+void World::composition_step(ThreadPool::Worker& worker, Integrator::Composition const& composition, bool reverse, bool reuse_forces) {
+    auto& state = m_physics;
+    auto const [first, last] = worker.range(state.active.size());
+
+    double step = m_tick_length;
+    double mul = reverse ? -1 : 1;
+
+    auto kick = [&](double coefficient) {
+        double const kick_step = coefficient * step;
+        for (size_t a = first; a < last; a++) {
+            auto const s = state.active[a];
+            state.vel_x[s] += state.acc_x[s] * kick_step * mul;
+            state.vel_y[s] += state.acc_y[s] * kick_step * mul;
+            state.vel_z[s] += state.acc_z[s] * kick_step * mul;
         }
+    };
 
-        // if ((m_date - m_start_date).count() > 24 * 60 * 60 * 50) {
-        //     std::cout << "FINISHED" << std::endl;
-        //     _exit(0);
-        // }
+    auto drift = [&](double coefficient) {
+        double const drift_step = coefficient * step;
+        for (size_t a = first; a < last; a++) {
+            auto const s = state.active[a];
+            state.pos_x[s] += state.vel_x[s] * drift_step * mul;
+            state.pos_y[s] += state.vel_y[s] * drift_step * mul;
+            state.pos_z[s] += state.vel_z[s] * drift_step * mul;
+        }
+    };
+
+    // calculate forces/accelerations based on current postions, unless
+    // they are still there from the end of the last tick
+    if (composition.kicks[0] != 0) {
+        if (reuse_forces)
+            worker.sync();
+        else
+            this->set_forces(worker);
+        kick(composition.kicks[0]);
+    }
+
+    for (size_t i = 0; i < composition.drifts.size(); i++) {
+        drift(composition.drifts[i]);
+
+        // calculate the forces using the new positions
+        auto const coefficient = composition.kicks[i + 1];
+        if (coefficient == 0)
+            continue;
+        this->set_forces(worker);
+        if (i + 1 == composition.drifts.size())
+            record_force_inputs(worker);
+        kick(coefficient);
+    }
+}
+
+bool World::integrator_ends_with_forces() const {
+    switch (m_integrator) {
+    case Integrator::Method::WisdomHolman:
+    case Integrator::Method::IAS15:
+        return true;
+    case Integrator::Method::Hermite:
+        return false;
+    default:
+        return Integrator::composition(m_integrator).ends_with_kick();
+    }
+}
+
+bool World::uses_reversible_composition() const {
+    switch (m_integrator) {
+    case Integrator::Method::WisdomHolman:
+    case Integrator::Method::IAS15:
+    case Integrator::Method::Hermite:
+        return false;
+    default:
+        return m_reversible;
     }
 }
 
@@ -147,19 +634,6 @@ bool World::exist_object_with_name(Util::UString const& name) const {
     return false;
 }
 
-void World::draw(Gfx::Painter& painter, SimulationView const& view) const {
-    {
-        GUI::WorldDrawScope scope { painter, GUI::WorldDrawScope::ClearDepth::Yes };
-        for (auto& p : m_object_list) {
-            if (!p->deleted())
-                p->draw(painter, view);
-        }
-    }
-    for (auto& p : m_object_list)
-        if (!p->deleted())
-            p->draw_gui(painter, view);
-}
-
 Object* World::get_object_by_name(Util::UString const& name) {
     for (auto& obj : m_object_list) {
         if (obj->name() == name)
@@ -168,15 +642,46 @@ Object* World::get_object_by_name(Util::UString const& name) {
     return nullptr;
 }
 
-void World::reset(std::optional<std::string> const& filename) {
+Object* World::get_object_by_id(uint64_t id) const {
+    // Objects are added with increasing ids and removing them keeps the
+    // order.
+    auto it = std::lower_bound(m_object_list.begin(), m_object_list.end(), id, [](auto const& object, uint64_t id) { return object->id() < id; });
+    if (it == m_object_list.end() || (*it)->id() != id)
+        return nullptr;
+    return it->get();
+}
+
+bool World::reset(std::optional<std::string> const& filename) {
     if (on_reset)
         on_reset();
 
     m_object_list.clear();
-    m_simulation_view->set_focused_object(nullptr);
+    m_next_object_id = 0;
+    m_physics.clear();
+    m_hierarchy.clear();
+    m_hierarchy_valid = false;
+    m_history.clear();
+    m_keyframes.clear();
+    m_keyframe_interval = 0;
+    m_keyframe_pending = false;
+    m_tick = 0;
+    m_alive_flags_valid = false;
+    m_last_force_inputs.valid = false;
+    m_test_particles.clear();
+    m_test_particle_forces_valid = false;
     m_date = Util::SimulationTime::create(1990, 4, 20);
-    m_object_history.clear_history(0);
+    m_object_history.clear();
+    m_tick_length = 0;
+    m_past_ticks.clear();
+    m_future_ticks.clear();
     m_light_source = nullptr;
+    m_gravity_solver = Gravity::Solver::Direct;
+    m_barnes_hut.set_opening_angle(Gravity::BarnesHut::DefaultOpeningAngle);
+    m_fast_multipole.set_expansion_order(Gravity::FastMultipole::DefaultExpansionOrder);
+    m_integrator = Integrator::Method::Leapfrog;
+    m_hermite.set_accuracy(Integrator::Hermite::DefaultAccuracy);
+    m_reversible = false;
+    m_history.set_precision(History::LosslessPrecision);
 
     auto load = [this, &filename]() -> Config::ErrorOr<void> {
         auto config = TRY(ConfigLoader::load(*filename, *this));
@@ -197,23 +702,53 @@ void World::reset(std::optional<std::string> const& filename) {
                     },
                 },
                 maybe_error.release_error_variant());
+            return false;
         }
     }
+    return true;
 }
 
 void World::reset_all_trails() {
     for_each_object([](Object& o) { o.trail().reset(); });
+    for (auto& [index, trail] : m_test_particles.trails)
+        trail.reset();
+}
+
+void World::show_trajectory_sample(std::span<Trajectory::ObjectInfo const> objects, Trajectory::Sample const& sample) {
+    auto const count = std::min(sample.bodies.size(), objects.size());
+    for (size_t s = 0; s < count; s++) {
+        auto const& body = sample.bodies[s];
+        if (std::isnan(body.pos[0]))
+            continue;
+        auto* object = get_object_by_id(objects[s].id);
+        if (!object)
+            continue;
+        object->set_pos({ body.pos[0], body.pos[1], body.pos[2] });
+        object->set_vel({ body.vel[0], body.vel[1], body.vel[2] });
+    }
+}
+
+void World::add_test_particle(TestParticles::Particle const& particle, size_t trail_length) {
+    m_test_particles.append(particle, trail_length);
+    m_test_particle_forces_valid = false;
 }
 
 void World::delete_object_by_ptr(Object* ptr) {
-    m_object_list.remove_if([ptr](std::unique_ptr<Object>& obj) { return obj.get() == ptr; });
-    m_simulation_view->set_focused_object(nullptr);
+    if (on_delete_object)
+        on_delete_object(ptr);
 
     for (auto& o : m_object_list) {
         if (o->most_attracting_object() == ptr)
             o->delete_most_attracting_object();
     }
 
+    for (size_t s = 0; s < m_object_list.size(); s++) {
+        if (m_object_list[s].get() == ptr) {
+            take_object(s);
+            break;
+        }
+    }
+
     if (m_light_source == ptr)
         m_light_source = nullptr;
 }
@@ -227,14 +762,18 @@ std::unique_ptr<Object>& World::find_object_by_ptr(Object* ptr) {
     return m_object_list.back();
 }
 
-void World::clone_for_forward_simulation(World& new_world) const {
-    new_world = World();
-    new_world.m_is_forward_simulated = true;
-    new_world.m_simulation_view = m_simulation_view;
+std::unique_ptr<World> World::clone_for_forward_simulation() const {
+    auto new_world = std::make_unique<World>();
+    new_world->m_is_forward_simulated = true;
+    new_world->m_offset_trails = m_offset_trails;
+    // Previews run with long ticks and often pass close to other objects,
+    // which only an adaptive integrator gets right.
+    new_world->m_integrator = Integrator::Method::IAS15;
     for (auto& object : m_object_list) {
         if (!object->deleted())
-            new_world.add_object(object->clone_for_forward_simulation());
+            new_world->add_object(object->clone_for_forward_simulation());
     }
+    return new_world;
 }
 
 std::ostream& operator<<(std::ostream& out, World const& world) {
@@ -246,8 +785,34 @@ std::ostream& operator<<(std::ostream& out, World const& world) {
 void World::setup_python_bindings(TypeSetup adder) {
     adder.add_method<&World::python_get_object_by_name>("get_object_by_name", "Returns an object that has the name given in argument.");
     adder.add_method<&World::python_add_object>("add_object", "Adds an object to the World.");
+    adder.add_method<&World::python_add_test_particle>("add_test_particle", "Adds a massless particle that is attracted by objects, but doesn't attract anything.");
+    adder.add_attribute<&World::python_get_test_particle_count, nullptr>("test_particle_count", "Number of test particles");
     adder.add_attribute<&World::python_get_simulation_seconds_per_tick, &World::python_set_simulation_seconds_per_tick>("simulation_seconds_per_tick",
         "Sets how much simulation seconds passes per tick");
+    adder.add_attribute<&World::python_get_gravity_solver, &World::python_set_gravity_solver>("gravity_solver",
+        "Method used to calculate gravity forces ('direct', 'direct_symmetric', 'barnes_hut' or 'fmm')");
+    adder.add_attribute<&World::python_get_opening_angle, &World::python_set_opening_angle>("opening_angle",
+        "Barnes-Hut opening angle (accuracy vs speed, lower is more accurate)");
+    adder.add_attribute<&World::python_get_expansion_order, &World::python_set_expansion_order>("expansion_order",
+        "FMM expansion order (accuracy vs speed, higher is more accurate)");
+    adder.add_attribute<&World::python_get_integrator, &World::python_set_integrator>("integrator",
+        "Method used to advance objects ('leapfrog', 'yoshida4', 'yoshida6', 'forest_ruth', 'wisdom_holman', 'ias15' or 'hermite')");
+    adder.add_attribute<&World::python_get_hermite_accuracy, &World::python_set_hermite_accuracy>("hermite_accuracy",
+        "Timestep accuracy of the Hermite integrator (accuracy vs speed, lower is more accurate)");
+    adder.add_attribute<&World::python_get_adaptive_tick, &World::python_set_adaptive_tick>("adaptive_tick",
+        "Whether tick length is chosen every tick from the shortest orbital timescale, up to simulation_seconds_per_tick");
+    adder.add_attribute<&World::python_get_adaptive_tick_accuracy, &World::python_set_adaptive_tick_accuracy>("adaptive_tick_accuracy",
+        "Fraction of the shortest orbital timescale used as adaptive tick length (accuracy vs speed, lower is more accurate)");
+    adder.add_attribute<&World::python_get_reversible, &World::python_set_reversible>("reversible",
+        "Whether kick-drift integrators run in fixed point, so that going back in time retraces ticks exactly");
+    adder.add_attribute<&World::python_get_keyframe_interval, &World::python_set_keyframe_interval>("keyframe_interval",
+        "Number of ticks between full states saved for going back in time past the recorded history (0 to disable)");
+    adder.add_attribute<&World::python_get_history_precision, &World::python_set_history_precision>("history_precision",
+        "Mantissa bits of positions and velocities kept in history (memory vs accuracy, 52 is lossless)");
+    adder.add_attribute<&World::python_get_thread_count, &World::python_set_thread_count>("thread_count",
+        "Number of threads used to update objects");
+    adder.add_method<&World::python_print_gravity_accuracy_report>("print_gravity_accuracy_report",
+        "Prints accuracy of gravity solvers relative to direct summation for the current state.");
 }
 
 PySSA::Object World::python_add_object(PySSA::Object const& args, PySSA::Object const& kwargs) {
@@ -259,6 +824,32 @@ PySSA::Object World::python_add_object(PySSA::Object const& args, PySSA::Object
     return PySSA::Object::none();
 }
 
+PySSA::Object World::python_add_test_particle(PySSA::Object const& args, PySSA::Object const& kwargs) {
+    TestParticles::Particle particle { .pos = {}, .vel = {}, .color = Util::Colors::White };
+    unsigned trail_length = 0;
+
+    static char const* keywords[] = {
+        "pos",
+        "vel",
+        "color",
+        "trail_length",
+        nullptr
+    };
+
+    if (!PyArg_ParseTupleAndKeywords(args.python_object(), kwargs.python_object(), "|$(ddd)(ddd)(bbb)I", (char**)keywords,
+            &particle.pos.x(), &particle.pos.y(), &particle.pos.z(),
+            &particle.vel.x(), &particle.vel.y(), &particle.vel.z(),
+            &particle.color.r, &particle.color.g, &particle.color.b,
+            &trail_length))
+        return {};
+    add_test_particle(particle, trail_length);
+    return PySSA::Object::none();
+}
+
+PySSA::Object World::python_get_test_particle_count() const {
+    return PySSA::Object::create(static_cast<int>(m_test_particles.size()));
+}
+
 PySSA::Object World::python_get_object_by_name(PySSA::Object const& args, PySSA::Object const& kwargs) {
     Util::UString name = "test";
     if (!PySSA::parse_arguments(args, kwargs, "s", PySSA::Arg::Arg { &name, "name" }))
@@ -282,4 +873,179 @@ bool World::python_set_simulation_seconds_per_tick(PySSA::Object const& object)
     return true;
 }
 
+PySSA::Object World::python_get_gravity_solver() const {
+    return PySSA::Object::create(Util::UString { Gravity::solver_to_string(m_gravity_solver) });
+}
+
+bool World::python_set_gravity_solver(PySSA::Object const& object) {
+    auto maybe_value = object.as_string();
+    if (!maybe_value.has_value())
+        return false;
+    auto solver = Gravity::solver_from_string(maybe_value.value().encode());
+    if (!solver.has_value()) {
+        PyErr_SetString(PyExc_ValueError, "Invalid gravity solver, expected 'direct', 'direct_symmetric', 'barnes_hut' or 'fmm'");
+        return false;
+    }
+    m_gravity_solver = solver.value();
+    return true;
+}
+
+PySSA::Object World::python_get_opening_angle() const {
+    return PySSA::Object::create(m_barnes_hut.opening_angle());
+}
+
+bool World::python_set_opening_angle(PySSA::Object const& object) {
+    auto maybe_value = object.as_double();
+    if (!maybe_value.has_value())
+        return false;
+    if (maybe_value.value() < 0) {
+        PyErr_SetString(PyExc_ValueError, "Opening angle must be non-negative");
+        return false;
+    }
+    m_barnes_hut.set_opening_angle(maybe_value.value());
+    return true;
+}
+
+PySSA::Object World::python_get_expansion_order() const {
+    return PySSA::Object::create(static_cast<int>(m_fast_multipole.expansion_order()));
+}
+
+bool World::python_set_expansion_order(PySSA::Object const& object) {
+    auto maybe_value = object.as_int();
+    if (!maybe_value.has_value())
+        return false;
+    if (maybe_value.value() < 1 || maybe_value.value() > static_cast<int>(Gravity::FastMultipole::MaxExpansionOrder)) {
+        PyErr_SetString(PyExc_ValueError, "Expansion order out of range");
+        return false;
+    }
+    m_fast_multipole.set_expansion_order(maybe_value.value());
+    return true;
+}
+
+PySSA::Object World::python_get_integrator() const {
+    return PySSA::Object::create(Util::UString { Integrator::method_to_string(m_integrator) });
+}
+
+bool World::python_set_integrator(PySSA::Object const& object) {
+    auto maybe_value = object.as_string();
+    if (!maybe_value.has_value())
+        return false;
+    auto integrator = Integrator::method_from_string(maybe_value.value().encode());
+    if (!integrator.has_value()) {
+        PyErr_SetString(PyExc_ValueError, "Invalid integrator, expected 'leapfrog', 'yoshida4', 'yoshida6', 'forest_ruth', 'wisdom_holman', 'ias15' or 'hermite'");
+        return false;
+    }
+    m_integrator = integrator.value();
+    return true;
+}
+
+PySSA::Object World::python_get_hermite_accuracy() const {
+    return PySSA::Object::create(m_hermite.accuracy());
+}
+
+bool World::python_set_hermite_accuracy(PySSA::Object const& object) {
+    auto maybe_value = object.as_double();
+    if (!maybe_value.has_value())
+        return false;
+    if (maybe_value.value() <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Hermite accuracy must be positive");
+        return false;
+    }
+    m_hermite.set_accuracy(maybe_value.value());
+    return true;
+}
+
+PySSA::Object World::python_get_adaptive_tick() const {
+    return PySSA::Object::create(static_cast<int>(m_adaptive_tick));
+}
+
+bool World::python_set_adaptive_tick(PySSA::Object const& object) {
+    auto maybe_value = object.as_int();
+    if (!maybe_value.has_value())
+        return false;
+    set_adaptive_tick(maybe_value.value() != 0);
+    return true;
+}
+
+PySSA::Object World::python_get_reversible() const {
+    return PySSA::Object::create(static_cast<int>(m_reversible));
+}
+
+bool World::python_set_reversible(PySSA::Object const& object) {
+    auto maybe_value = object.as_int();
+    if (!maybe_value.has_value())
+        return false;
+    set_reversible(maybe_value.value() != 0);
+    return true;
+}
+
+PySSA::Object World::python_get_keyframe_interval() const {
+    return PySSA::Object::create(static_cast<int>(m_keyframe_interval));
+}
+
+bool World::python_set_keyframe_interval(PySSA::Object const& object) {
+    auto maybe_value = object.as_int();
+    if (!maybe_value.has_value())
+        return false;
+    if (maybe_value.value() < 0) {
+        PyErr_SetString(PyExc_ValueError, "Keyframe interval must not be negative");
+        return false;
+    }
+    set_keyframe_interval(maybe_value.value());
+    return true;
+}
+
+PySSA::Object World::python_get_history_precision() const {
+    return PySSA::Object::create(static_cast<int>(history_precision()));
+}
+
+bool World::python_set_history_precision(PySSA::Object const& object) {
+    auto maybe_value = object.as_int();
+    if (!maybe_value.has_value())
+        return false;
+    if (maybe_value.value() < 1 || maybe_value.value() > static_cast<int>(History::LosslessPrecision)) {
+        PyErr_SetString(PyExc_ValueError, "History precision must be in range [1, 52]");
+        return false;
+    }
+    set_history_precision(maybe_value.value());
+    return true;
+}
+
+PySSA::Object World::python_get_adaptive_tick_accuracy() const {
+    return PySSA::Object::create(m_adaptive_tick_accuracy);
+}
+
+bool World::python_set_adaptive_tick_accuracy(PySSA::Object const& object) {
+    auto maybe_value = object.as_double();
+    if (!maybe_value.has_value())
+        return false;
+    if (maybe_value.value() <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Adaptive tick accuracy must be positive");
+        return false;
+    }
+    m_adaptive_tick_accuracy = maybe_value.value();
+    return true;
+}
+
+PySSA::Object World::python_get_thread_count() const {
+    return PySSA::Object::create(static_cast<int>(m_thread_count));
+}
+
+bool World::python_set_thread_count(PySSA::Object const& object) {
+    auto maybe_value = object.as_int();
+    if (!maybe_value.has_value())
+        return false;
+    if (maybe_value.value() < 1) {
+        PyErr_SetString(PyExc_ValueError, "Thread count must be positive");
+        return false;
+    }
+    set_thread_count(maybe_value.value());
+    return true;
+}
+
+PySSA::Object World::python_print_gravity_accuracy_report(PySSA::Object const&, PySSA::Object const&) {
+    Gravity::print_accuracy_report(gravity_accuracy_report());
+    return PySSA::Object::none();
+}
+
 #endif
@@ -1,18 +1,44 @@
 #pragma once
 
 #include "ConfigLoader.hpp"
+#include "Hierarchy.hpp"
+#include "History.hpp"
+#include "Keyframes.hpp"
 #include "Object.hpp"
 #include "ObjectHistory.hpp"
+#include "PhysicsState.hpp"
+#include "TestParticles.hpp"
+#include "ThreadPool.hpp"
+#include "Trajectory.hpp"
+#include "gravity/AccuracyReport.hpp"
+#include "gravity/BarnesHut.hpp"
+#include "gravity/Direct.hpp"
+#include "gravity/FastMultipole.hpp"
+#include "gravity/Solver.hpp"
+#include "gravity/TestParticleSummation.hpp"
+#include "gravity/TiledDirect.hpp"
+#include "integrator/Composition.hpp"
+#include "integrator/Hermite.hpp"
+#include "integrator/IAS15.hpp"
+#include "integrator/Method.hpp"
+#include "integrator/Reversible.hpp"
+#include "integrator/WisdomHolman.hpp"
 #include "pyssa/WrappedObject.hpp"
 #include <EssaUtil/Constants.hpp>
 #include <EssaUtil/SimulationClock.hpp>
 #include <EssaUtil/Vector.hpp>
 
+#include <algorithm>
 #include <cstdint>
+#include <deque>
 #include <functional>
-#include <list>
+#include <iostream>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <thread>
+#include <vector>
 
 class SimulationView;
 
@@ -22,17 +48,25 @@ public:
 
     World(World const& other) = delete;
     World& operator=(World const& other) = delete;
-    World(World&& other) = default;
-    World& operator=(World&& other) = default;
-    SimulationView* m_simulation_view {};
+    // Objects point to the world and into its physics state.
+    World(World&& other) = delete;
+    World& operator=(World&& other) = delete;
 
     void update(int steps);
+
+    // Defined in the rendering layer (render/World.cpp).
     void draw(Gfx::Painter& window, SimulationView const& view) const;
+
     void add_object(std::unique_ptr<Object>);
-    void reset(std::optional<std::string> const& filename);
+    // Returns false if the world file failed to load.
+    bool reset(std::optional<std::string> const& filename);
     Object* get_object_by_name(Util::UString const& name);
+    // Returns nullptr if the object was removed or never existed.
+    Object* get_object_by_id(uint64_t id) const;
 
     Util::SimulationClock::time_point date() const { return m_date; }
+    // Ticks done since the start, minus ticks done backward.
+    int64_t tick() const { return m_tick; }
 
     template<class C>
     void for_each_object(C callback) {
@@ -40,13 +74,94 @@ public:
             callback(*it);
     }
 
-    void clone_for_forward_simulation(World& new_world) const;
+    std::unique_ptr<World> clone_for_forward_simulation() const;
 
     int simulation_seconds_per_tick() const { return m_simulation_seconds_per_tick; }
     void set_simulation_seconds_per_tick(int s) { m_simulation_seconds_per_tick = s; }
 
+    // Simulation seconds of the last tick. Differs from
+    // simulation_seconds_per_tick() when the adaptive tick is enabled.
+    int tick_length() const { return m_tick_length > 0 ? m_tick_length : m_simulation_seconds_per_tick; }
+
+    // Whether the tick length is chosen every tick from the shortest orbital
+    // or free-fall timescale of pairs of objects, up to
+    // simulation_seconds_per_tick().
+    bool adaptive_tick() const { return m_adaptive_tick; }
+    void set_adaptive_tick(bool adaptive_tick);
+
+    // Fraction of the shortest timescale that the adaptive tick is set to.
+    static constexpr double DefaultAdaptiveTickAccuracy = 0.01;
+    double adaptive_tick_accuracy() const { return m_adaptive_tick_accuracy; }
+    void set_adaptive_tick_accuracy(double accuracy) { m_adaptive_tick_accuracy = accuracy; }
+
     void reset_all_trails();
 
+    // Moves objects to a sample of a trajectory file recorded from the same
+    // world file, for playback. `objects` is the table of the file; objects
+    // are matched by id, and ones that aren't in the world or didn't exist
+    // in the sample are left alone. The date doesn't change.
+    void show_trajectory_sample(std::span<Trajectory::ObjectInfo const> objects, Trajectory::Sample const&);
+
+    // Massless particles attracted by objects, see TestParticles.
+    TestParticles const& test_particles() const { return m_test_particles; }
+    void add_test_particle(TestParticles::Particle const&, size_t trail_length = 0);
+
+    // Which object every object orbits. Rebuilt every
+    // HierarchyUpdateInterval ticks and after objects were added, removed or
+    // deleted; every tick with the adaptive tick, which looks for close
+    // encounters in it.
+    Hierarchy const& hierarchy() const { return m_hierarchy; }
+
+    // Whether trails are drawn relative to the object that an object orbits.
+    bool offset_trails() const { return m_offset_trails; }
+    void set_offset_trails(bool offset_trails) { m_offset_trails = offset_trails; }
+
+    Gravity::Solver gravity_solver() const { return m_gravity_solver; }
+    void set_gravity_solver(Gravity::Solver solver) { m_gravity_solver = solver; }
+
+    double barnes_hut_opening_angle() const { return m_barnes_hut.opening_angle(); }
+    void set_barnes_hut_opening_angle(double theta) { m_barnes_hut.set_opening_angle(theta); }
+
+    unsigned fmm_expansion_order() const { return m_fast_multipole.expansion_order(); }
+    void set_fmm_expansion_order(unsigned order) { m_fast_multipole.set_expansion_order(order); }
+
+    Integrator::Method integrator() const { return m_integrator; }
+    void set_integrator(Integrator::Method integrator) { m_integrator = integrator; }
+
+    double hermite_accuracy() const { return m_hermite.accuracy(); }
+    void set_hermite_accuracy(double accuracy) { m_hermite.set_accuracy(accuracy); }
+
+    // Whether kick-drift integrators (Leapfrog, Yoshida, Forest-Ruth) run in
+    // fixed point, so that going back in time retraces ticks exactly, without
+    // storing any object history (see Integrator::Reversible). Other
+    // integrators ignore it. Test particles are not reversed exactly. Turned
+    // off when an object leaves the fixed point range.
+    bool reversible() const { return m_reversible; }
+    void set_reversible(bool reversible) { m_reversible = reversible; }
+
+    // Number of ticks between keyframes, full states saved so that going
+    // back in time past the recorded history restores the closest keyframe
+    // and integrates forward again, instead of integrating backward. Longer
+    // intervals take less memory, but seeking back is slower. 0 disables
+    // keyframes. Not used when ticks are reversible.
+    unsigned keyframe_interval() const { return m_keyframe_interval; }
+    void set_keyframe_interval(unsigned interval);
+
+    // Mantissa bits of positions and velocities kept in the compressed
+    // history (see History). Lower precision fits more ticks into the same
+    // memory, but going back in time doesn't lead exactly to the same states.
+    unsigned history_precision() const { return m_history.precision(); }
+    void set_history_precision(unsigned precision) { m_history.set_precision(precision); }
+    // Ticks back in time that replay the history instead of integrating.
+    size_t history_size() const { return m_history.size(); }
+
+    // Number of threads used to update objects. Results don't depend on it.
+    unsigned thread_count() const { return m_thread_count; }
+    void set_thread_count(unsigned count) { m_thread_count = std::max(count, 1u); }
+
+    // Compares gravity solvers against direct summation on the current state.
+    std::vector<Gravity::AccuracyReportEntry> gravity_accuracy_report() const;
+
 #ifdef ENABLE_PYSSA
     static void setup_python_bindings(TypeSetup);
     static constexpr char const* PythonClassName = "World";
@@ -55,6 +170,7 @@ public:
     void delete_object_by_ptr(Object* ptr);
     std::unique_ptr<Object>& find_object_by_ptr(Object* ptr);
     std::unique_ptr<Object>& last_object() { return m_object_list.back(); }
+    Object* object_at(size_t index) const { return m_object_list[index].get(); }
 
     void set_forces();
     bool exist_object_with_name(Util::UString const& name) const;
@@ -69,25 +185,182 @@ public:
     Object* light_source() const { return m_light_source; }
 
     std::function<void()> on_reset;
+    std::function<void(Object*)> on_delete_object;
 
 private:
     Util::SimulationClock::time_point m_start_date;
     Util::SimulationClock::time_point m_date;
     ObjectHistory m_object_history;
-    std::list<std::unique_ptr<Object>> m_object_list;
+
+    // m_object_list[i] is a handle to m_physics entry i.
+    std::vector<std::unique_ptr<Object>> m_object_list;
+    uint64_t m_next_object_id = 0;
+    PhysicsState m_physics;
+
+    Gravity::Solver m_gravity_solver = Gravity::Solver::Direct;
+    Gravity::DirectSummation m_direct;
+    Gravity::TiledDirectSummation m_tiled_direct;
+    Gravity::BarnesHut m_barnes_hut;
+    Gravity::FastMultipole m_fast_multipole;
+    Integrator::Method m_integrator = Integrator::Method::Leapfrog;
+    Integrator::Hermite m_hermite;
+    Integrator::WisdomHolman m_wisdom_holman;
+    Integrator::IAS15 m_ias15;
+    Integrator::Reversible m_reversible_composition;
+    bool m_reversible = false;
     int m_simulation_seconds_per_tick = 60 * 60 * 12; // 12 Hours / half a day
+
+    // Adaptive tick length may change at most this much between ticks, so
+    // that symplectic integrators stay close to symplectic.
+    static constexpr double MaxTickGrowth = 1.1;
+    static constexpr double MaxTickShrink = 0.5;
+    bool m_adaptive_tick = false;
+    double m_adaptive_tick_accuracy = DefaultAdaptiveTickAccuracy;
+    int m_tick_length = 0;
+
+    // Positions and velocities of objects in the last ticks, replayed when
+    // going back in time. Not recorded when ticks are reversible.
+    static constexpr size_t HistoryMemoryBudget = 64 << 20;
+    History m_history { HistoryMemoryBudget };
+
+    Keyframes m_keyframes;
+    unsigned m_keyframe_interval = 0;
+    // Objects were added or edited since the last keyframe.
+    bool m_keyframe_pending = false;
+    // Set while integrating forward from a keyframe, see
+    // rewind_to_keyframe().
+    bool m_replaying_keyframe = false;
+    int64_t m_tick = 0;
+
+    // Lengths of ticks done forward (past) and backward (future), so that
+    // going back in time replays the same ticks that history entries were
+    // recorded for. Consecutive ticks of the same length are stored as one
+    // run. As many ticks are kept as history entries (and at least
+    // MinRecordedTicks), or all of them when ticks are reversible or
+    // keyframes are used.
+    static constexpr size_t MinRecordedTicks = 1000;
+    struct TickRun {
+        int length;
+        size_t count;
+    };
+    struct TickRuns {
+        std::deque<TickRun> runs;
+        size_t count = 0;
+
+        bool empty() const { return runs.empty(); }
+        void push(int length);
+        int pop();
+        // Drops the oldest ticks.
+        void trim(size_t max_count);
+        void clear();
+    };
+    TickRuns m_past_ticks;
+    TickRuns m_future_ticks;
+
+    static constexpr size_t MinObjectsForThreads = 256;
+    unsigned m_thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    // Created on first use, so that temporary worlds don't spawn threads.
+    std::unique_ptr<ThreadPool> m_thread_pool;
+
+    // Inputs of the last force evaluation, done at the end of the last tick.
+    // If they didn't change until the beginning of the next tick, its forces
+    // are the same, so they are reused instead of evaluated again (first same
+    // as last). Edits of positions and masses (GUI, Python, history replay)
+    // are caught by comparing; adding and removing objects invalidates it.
+    struct ForceInputs {
+        std::vector<size_t> active;
+        // Of active objects, in the order of `active`.
+        std::vector<double> pos_x, pos_y, pos_z, gravity_factor;
+        Gravity::Solver solver {};
+        double opening_angle {};
+        unsigned expansion_order {};
+        bool valid = false;
+    };
+    ForceInputs m_last_force_inputs;
+
+    // Orbits change slowly, so the hierarchy is rebuilt only every few ticks.
+    static constexpr unsigned HierarchyUpdateInterval = 16;
+    Hierarchy m_hierarchy;
+    unsigned m_ticks_since_hierarchy_update = 0;
+    bool m_hierarchy_valid = false;
+
+    // Alive flags (and PhysicsState::active) are up to date with objects,
+    // see update_alive_flags().
+    bool m_alive_flags_valid = false;
+
+    TestParticles m_test_particles;
+    Gravity::TestParticleSummation m_test_particle_gravity;
+    // Whether acc_* of test particles are evaluated for the current
+    // positions, at the end of the last tick. Objects are compared with the
+    // ones that forces were evaluated for at the beginning of a tick.
+    bool m_test_particle_forces_valid = false;
+
     bool m_is_forward_simulated = false;
+    bool m_offset_trails = true;
     Object* m_light_source = nullptr;
 
+    void tick(bool reverse);
+    int next_tick_length(bool reverse);
+    int choose_tick_length();
     void update_history_and_date(bool reverse);
+    // All per-object work of a tick, split between workers.
+    void update_objects(ThreadPool::Worker&, bool reverse, bool reuse_forces, bool reuse_test_particle_forces, std::optional<History::Move>);
+    void integrate(ThreadPool::Worker&, double tick, bool reverse, bool reuse_forces);
+    void begin_test_particle_step(ThreadPool::Worker&, double tick, bool reuse_forces);
+    void end_test_particle_step(ThreadPool::Worker&, double tick);
+    void set_test_particle_forces(ThreadPool::Worker&);
+    void composition_step(ThreadPool::Worker&, Integrator::Composition const&, bool reverse, bool reuse_forces);
+    // Whether the integrator leaves forces evaluated for the final positions.
+    bool integrator_ends_with_forces() const;
+    bool uses_reversible_composition() const;
+    bool uses_keyframes() const;
+    void rewind_to_keyframe();
+    void set_forces(ThreadPool::Worker&);
+    bool forces_are_current() const;
+    void record_force_inputs(ThreadPool::Worker&);
+    void update_alive_flags();
+    void update_timeline();
+    void update_hierarchy();
+
+    void push_object(std::unique_ptr<Object>);
+    std::unique_ptr<Object> take_object(size_t index);
+
+    // Defined in the rendering layer (render/World.cpp).
+    void draw_test_particles(SimulationView const& view) const;
 
 #ifdef ENABLE_PYSSA
     // FIXME: (on WrappedObject side) Allow const-qualified members
     PySSA::Object python_add_object(PySSA::Object const& args, PySSA::Object const& kwargs);
     PySSA::Object python_get_object_by_name(PySSA::Object const& args, PySSA::Object const& kwargs);
+    PySSA::Object python_add_test_particle(PySSA::Object const& args, PySSA::Object const& kwargs);
+    PySSA::Object python_get_test_particle_count() const;
     PySSA::Object python_get_simulation_seconds_per_tick() const;
     bool python_set_simulation_seconds_per_tick(PySSA::Object const&);
+    PySSA::Object python_get_gravity_solver() const;
+    bool python_set_gravity_solver(PySSA::Object const&);
+    PySSA::Object python_get_opening_angle() const;
+    bool python_set_opening_angle(PySSA::Object const&);
+    PySSA::Object python_get_expansion_order() const;
+    bool python_set_expansion_order(PySSA::Object const&);
+    PySSA::Object python_get_integrator() const;
+    bool python_set_integrator(PySSA::Object const&);
+    PySSA::Object python_get_hermite_accuracy() const;
+    bool python_set_hermite_accuracy(PySSA::Object const&);
+    PySSA::Object python_get_adaptive_tick() const;
+    bool python_set_adaptive_tick(PySSA::Object const&);
+    PySSA::Object python_get_reversible() const;
+    bool python_set_reversible(PySSA::Object const&);
+    PySSA::Object python_get_keyframe_interval() const;
+    bool python_set_keyframe_interval(PySSA::Object const&);
+    PySSA::Object python_get_history_precision() const;
+    bool python_set_history_precision(PySSA::Object const&);
+    PySSA::Object python_get_adaptive_tick_accuracy() const;
+    bool python_set_adaptive_tick_accuracy(PySSA::Object const&);
+    PySSA::Object python_get_thread_count() const;
+    bool python_set_thread_count(PySSA::Object const&);
+    PySSA::Object python_print_gravity_accuracy_report(PySSA::Object const& args, PySSA::Object const& kwargs);
 #endif
 
+    friend class Object;
     friend std::ostream& operator<<(std::ostream& out, World const&);
 };
@@ -0,0 +1,54 @@
+#include "Benchmark.hpp"
+
+#include <fmt/format.h>
+#include <fstream>
+#include <sys/resource.h>
+
+namespace Bench {
+
+uint64_t peak_rss_kib() {
+    // VmHWM follows reset_peak_rss(), ru_maxrss doesn't.
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with("VmHWM:"))
+            return std::stoull(line.substr(6));
+    }
+
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+bool reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (!clear_refs)
+        return false;
+    clear_refs << "5";
+    return static_cast<bool>(clear_refs.flush());
+}
+
+std::string json_escape(std::string_view string) {
+    std::string result;
+    for (char c : string) {
+        switch (c) {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                result += fmt::format("\\u{:04x}", c);
+            else
+                result += c;
+        }
+    }
+    return result;
+}
+
+}
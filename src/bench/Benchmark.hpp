@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+// Helpers shared by the benchmark executables (essa-bench, essa-microbench).
+namespace Bench {
+
+class Stopwatch {
+public:
+    Stopwatch()
+        : m_start(std::chrono::steady_clock::now()) { }
+
+    double elapsed_seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count(); }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Deterministic random numbers. std::mt19937 output is fixed by the standard,
+// but the <random> distributions aren't, so they are implemented here to get
+// the same inputs with every standard library.
+class Random {
+public:
+    explicit Random(uint32_t seed)
+        : m_engine(seed) { }
+
+    // Uniform in [0, 1).
+    double next() { return m_engine() / 4294967296.0; }
+    double next(double min, double max) { return min + (max - min) * next(); }
+
+private:
+    std::mt19937 m_engine;
+};
+
+// Keeps the compiler from optimizing away a value that is never read.
+template<class T>
+inline void do_not_optimize(T const& value) {
+    asm volatile(""
+                 :
+                 : "r,m"(value)
+                 : "memory");
+}
+
+// Peak resident set size of the process, in KiB.
+uint64_t peak_rss_kib();
+
+// Resets the peak reported by peak_rss_kib() to the current RSS, if the OS
+// supports it (Linux 4.0+). Returns false if it doesn't.
+bool reset_peak_rss();
+
+std::string json_escape(std::string_view);
+
+}
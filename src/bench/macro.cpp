@@ -0,0 +1,273 @@
+// Macro benchmark: times World::update on the shipped worlds and on generated
+// scenes of 1k, 10k and 100k objects, and prints the results as JSON so that
+// they can be compared between releases.
+
+#include "../World.hpp"
+#include "../gravity/Solver.hpp"
+#include "../integrator/Method.hpp"
+#include "Benchmark.hpp"
+
+#include <EssaUtil/Color.hpp>
+#include <EssaUtil/Constants.hpp>
+#include <charconv>
+#include <cmath>
+#include <fmt/format.h>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr char const* DefaultWorlds[] = { "2body", "8body", "solar", "jupiter_system", "solar_belt" };
+constexpr size_t GeneratedSceneSizes[] = { 1000, 10000, 100000 };
+
+struct Options {
+    std::vector<std::string> world_files;
+    std::optional<Gravity::Solver> gravity_solver;
+    std::optional<Integrator::Method> integrator;
+    std::optional<unsigned> thread_count;
+    double min_time = 2;
+    int max_ticks = 10000;
+    size_t max_objects = 100000;
+    std::optional<std::string> output_file;
+};
+
+struct Result {
+    std::string scene;
+    size_t objects = 0;
+    size_t test_particles = 0;
+    Gravity::Solver gravity_solver {};
+    Integrator::Method integrator {};
+    unsigned threads = 0;
+    int ticks = 0;
+    double seconds = 0;
+    uint64_t peak_rss_kib = 0;
+};
+
+void print_usage() {
+    std::cerr << "Usage: essa-bench [world.essa...] [options]\n"
+                 "  --gravity-solver NAME    direct, direct_symmetric, barnes_hut or fmm (default: from the world)\n"
+                 "  --integrator NAME        leapfrog, yoshida4, yoshida6, forest_ruth,\n"
+                 "                           wisdom_holman, ias15 or hermite (default: from the world)\n"
+                 "  --threads N              Number of threads (default: number of CPU cores)\n"
+                 "  --min-time S             Minimum measured time per scene in seconds (default: 2)\n"
+                 "  --max-ticks N            Maximum measured ticks per scene (default: 10000)\n"
+                 "  --max-objects N          Skip generated scenes bigger than N objects (default: 100000)\n"
+                 "  --output FILE            Write JSON to FILE instead of stdout\n"
+                 "Without world files, the shipped worlds and generated scenes are run.\n";
+}
+
+template<class T>
+std::optional<T> parse_number(std::string_view string) {
+    T value {};
+    auto result = std::from_chars(string.data(), string.data() + string.size(), value);
+    if (result.ec != std::errc {} || result.ptr != string.data() + string.size())
+        return {};
+    return value;
+}
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if (!argument.starts_with("--")) {
+            options.world_files.emplace_back(argument);
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "essa-bench: Missing value for " << argument << "\n";
+            return {};
+        }
+        std::string_view value = argv[++i];
+
+        auto invalid_value = [&]() -> std::optional<Options> {
+            std::cerr << "essa-bench: Invalid value for " << argument << ": '" << value << "'\n";
+            return {};
+        };
+
+        if (argument == "--gravity-solver") {
+            options.gravity_solver = Gravity::solver_from_string(value);
+            if (!options.gravity_solver)
+                return invalid_value();
+        }
+        else if (argument == "--integrator") {
+            options.integrator = Integrator::method_from_string(value);
+            if (!options.integrator)
+                return invalid_value();
+        }
+        else if (argument == "--threads") {
+            options.thread_count = parse_number<unsigned>(value);
+            if (!options.thread_count || *options.thread_count == 0)
+                return invalid_value();
+        }
+        else if (argument == "--min-time") {
+            auto min_time = parse_number<double>(value);
+            if (!min_time || *min_time < 0)
+                return invalid_value();
+            options.min_time = *min_time;
+        }
+        else if (argument == "--max-ticks") {
+            auto max_ticks = parse_number<int>(value);
+            if (!max_ticks || *max_ticks <= 0)
+                return invalid_value();
+            options.max_ticks = *max_ticks;
+        }
+        else if (argument == "--max-objects") {
+            auto max_objects = parse_number<size_t>(value);
+            if (!max_objects)
+                return invalid_value();
+            options.max_objects = *max_objects;
+        }
+        else if (argument == "--output") {
+            options.output_file = value;
+        }
+        else {
+            std::cerr << "essa-bench: Unknown option " << argument << "\n";
+            return {};
+        }
+    }
+    return options;
+}
+
+// A Sun-like star with `object_count - 1` bodies on circular orbits in a thin
+// disk between 0.5 and 30 AU. Always the same for a given size.
+void generate_disk(World& world, size_t object_count) {
+    constexpr double StarMass = 1.989e30;
+    world.add_object(std::make_unique<Object>(StarMass, 696340e3, Util::DeprecatedVector3d {}, Util::DeprecatedVector3d {},
+        Util::Colors::Yellow, "Star", 0));
+
+    Bench::Random random(static_cast<uint32_t>(object_count));
+    for (size_t s = 1; s < object_count; s++) {
+        double distance = random.next(0.5, 30) * Util::Constants::AU;
+        double angle = random.next(0, 2 * M_PI);
+        double height = random.next(-0.01, 0.01) * distance;
+        double mass = std::pow(10, random.next(20, 24));
+        double velocity = std::sqrt(Util::Constants::Gravity * StarMass / distance);
+
+        Util::DeprecatedVector3d pos { distance * std::cos(angle), distance * std::sin(angle), height };
+        Util::DeprecatedVector3d vel { -velocity * std::sin(angle), velocity * std::cos(angle), 0 };
+        world.add_object(std::make_unique<Object>(mass, 1e6, pos, vel, Util::Colors::White, Util::UString { fmt::format("Body {}", s) }, 0));
+    }
+}
+
+size_t count_objects(World& world) {
+    size_t count = 0;
+    world.for_each_object([&count](Object& object) {
+        if (!object.deleted())
+            count++;
+    });
+    return count;
+}
+
+// Runs batches of doubling size until `min_time` has been measured. The first
+// tick isn't measured, because it starts the thread pool and evaluates forces
+// that later ticks reuse from the end of the previous tick.
+Result run(std::string scene, World& world, Options const& options) {
+    if (options.gravity_solver)
+        world.set_gravity_solver(*options.gravity_solver);
+    if (options.integrator)
+        world.set_integrator(*options.integrator);
+    if (options.thread_count)
+        world.set_thread_count(*options.thread_count);
+
+    Result result;
+    result.scene = std::move(scene);
+    result.objects = count_objects(world);
+    result.test_particles = world.test_particles().size();
+    result.gravity_solver = world.gravity_solver();
+    result.integrator = world.integrator();
+    result.threads = world.thread_count();
+
+    world.update(1);
+
+    int batch = 1;
+    while (result.ticks < options.max_ticks && (result.ticks == 0 || result.seconds < options.min_time)) {
+        batch = std::min(batch, options.max_ticks - result.ticks);
+        Bench::Stopwatch stopwatch;
+        world.update(batch);
+        result.seconds += stopwatch.elapsed_seconds();
+        result.ticks += batch;
+        batch *= 2;
+    }
+    result.peak_rss_kib = Bench::peak_rss_kib();
+
+    std::cerr << fmt::format("essa-bench: {}: {} objects, {} test particles, {} ticks, {:.3f} ms/tick\n",
+        result.scene, result.objects, result.test_particles, result.ticks, result.seconds * 1000 / result.ticks);
+    return result;
+}
+
+// pair_interactions_per_second counts N * (N - 1) interactions per tick for
+// every solver, so that approximate solvers are comparable to direct
+// summation by how many interactions they replace. Every test particle adds
+// N interactions.
+void print_json(std::ostream& out, std::vector<Result> const& results) {
+    out << "{\n  \"benchmark\": \"world_update\",\n  \"results\": [";
+    for (size_t s = 0; s < results.size(); s++) {
+        auto const& result = results[s];
+        double seconds_per_tick = result.seconds / result.ticks;
+        double pairs = static_cast<double>(result.objects) * (result.objects > 0 ? result.objects - 1 : 0)
+            + static_cast<double>(result.objects) * result.test_particles;
+        out << (s == 0 ? "\n" : ",\n");
+        out << fmt::format("    {{ \"scene\": \"{}\", \"objects\": {}, \"test_particles\": {}, \"gravity_solver\": \"{}\", \"integrator\": \"{}\", \"threads\": {}, \"ticks\": {}, "
+                           "\"ns_per_tick\": {:.0f}, \"pair_interactions_per_second\": {:.6e}, \"peak_rss_kib\": {} }}",
+            Bench::json_escape(result.scene), result.objects, result.test_particles, Gravity::solver_to_string(result.gravity_solver),
+            Integrator::method_to_string(result.integrator), result.threads, result.ticks,
+            seconds_per_tick * 1e9, pairs / seconds_per_tick, result.peak_rss_kib);
+    }
+    out << "\n  ]\n}\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+    auto options = parse_options(argc, argv);
+    if (!options) {
+        print_usage();
+        return 1;
+    }
+
+    bool run_defaults = options->world_files.empty();
+    if (run_defaults) {
+        for (auto name : DefaultWorlds)
+            options->world_files.push_back(fmt::format("{}/{}.essa", ESSA_WORLDS_DIR, name));
+    }
+
+    // Scenes run from the smallest, and each one gets a fresh peak RSS where
+    // the OS allows it, so that peak_rss_kib belongs to that scene.
+    std::vector<Result> results;
+    for (auto const& world_file : options->world_files) {
+        Bench::reset_peak_rss();
+        World world;
+        if (!world.reset(world_file))
+            return 1;
+        auto scene = std::string_view { world_file };
+        scene = scene.substr(scene.find_last_of('/') + 1);
+        results.push_back(run(std::string { scene.substr(0, scene.find_last_of('.')) }, world, *options));
+    }
+
+    if (run_defaults) {
+        for (auto size : GeneratedSceneSizes) {
+            if (size > options->max_objects)
+                continue;
+            Bench::reset_peak_rss();
+            World world;
+            generate_disk(world, size);
+            results.push_back(run(fmt::format("disk_{}", size), world, *options));
+        }
+    }
+
+    std::ofstream output_file;
+    if (options->output_file) {
+        output_file.open(*options->output_file);
+        if (!output_file) {
+            std::cerr << "essa-bench: Failed to open " << *options->output_file << " for writing\n";
+            return 1;
+        }
+    }
+    print_json(options->output_file ? output_file : std::cout, results);
+    return 0;
+}
@@ -0,0 +1,353 @@
+// Micro benchmarks for per-tick work outside of the force evaluation: trails,
+// history, object history and world file parsing. Inputs use fixed seeds, so
+// that results of different builds are comparable. Prints JSON like essa-bench.
+
+#include "../ConfigLoader.hpp"
+#include "../History.hpp"
+#include "../Object.hpp"
+#include "../ObjectHistory.hpp"
+#include "../Trail.hpp"
+#include "../World.hpp"
+#include "Benchmark.hpp"
+
+#include <EssaUtil/Color.hpp>
+#include <EssaUtil/Constants.hpp>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct Options {
+    double min_time = 0.5;
+    std::optional<std::string> filter;
+    std::optional<std::string> output_file;
+};
+
+struct Result {
+    std::string name;
+    size_t size = 0;
+    size_t operations = 0;
+    double seconds = 0;
+};
+
+void print_usage() {
+    std::cerr << "Usage: essa-microbench [options]\n"
+                 "  --min-time S             Minimum measured time per benchmark in seconds (default: 0.5)\n"
+                 "  --filter TEXT            Run only benchmarks whose name contains TEXT\n"
+                 "  --output FILE            Write JSON to FILE instead of stdout\n";
+}
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "essa-microbench: Missing value for " << argument << "\n";
+            return {};
+        }
+        std::string_view value = argv[++i];
+
+        if (argument == "--min-time") {
+            double min_time {};
+            auto result = std::from_chars(value.data(), value.data() + value.size(), min_time);
+            if (result.ec != std::errc {} || result.ptr != value.data() + value.size() || min_time < 0) {
+                std::cerr << "essa-microbench: Invalid value for " << argument << ": '" << value << "'\n";
+                return {};
+            }
+            options.min_time = min_time;
+        }
+        else if (argument == "--filter") {
+            options.filter = value;
+        }
+        else if (argument == "--output") {
+            options.output_file = value;
+        }
+        else {
+            std::cerr << "essa-microbench: Unknown option " << argument << "\n";
+            return {};
+        }
+    }
+    return options;
+}
+
+class Runner {
+public:
+    explicit Runner(Options const& options)
+        : m_options(options) { }
+
+    // `batch(n)` must do n operations. It is called with doubling n until
+    // `min_time` has been measured. `size` is the input size, for the report.
+    void run(std::string name, size_t size, std::function<void(size_t)> const& batch) {
+        if (m_options.filter && name.find(*m_options.filter) == std::string::npos)
+            return;
+
+        Result result { std::move(name), size, 0, 0 };
+        batch(1);
+        for (size_t count = 1; result.operations == 0 || result.seconds < m_options.min_time; count *= 2) {
+            Bench::Stopwatch stopwatch;
+            batch(count);
+            result.seconds += stopwatch.elapsed_seconds();
+            result.operations += count;
+        }
+        std::cerr << fmt::format("essa-microbench: {}: {:.1f} ns/op\n", result.name, result.seconds * 1e9 / result.operations);
+        m_results.push_back(std::move(result));
+    }
+
+    void print_json(std::ostream& out) const {
+        out << "{\n  \"benchmark\": \"micro\",\n  \"results\": [";
+        for (size_t s = 0; s < m_results.size(); s++) {
+            auto const& result = m_results[s];
+            out << (s == 0 ? "\n" : ",\n");
+            out << fmt::format("    {{ \"name\": \"{}\", \"size\": {}, \"operations\": {}, \"ns_per_operation\": {:.3f} }}",
+                Bench::json_escape(result.name), result.size, result.operations, result.seconds * 1e9 / result.operations);
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    Options const& m_options;
+    std::vector<Result> m_results;
+};
+
+constexpr size_t TrailSize = 1000;
+constexpr size_t HistoryMemoryBudget = 16 << 20;
+constexpr size_t HistoryObjects = 1000;
+constexpr size_t HistoryStates = 256;
+constexpr size_t HistoryTicks = 4096;
+constexpr size_t ObjectHistorySize = 1000;
+constexpr size_t ObjectHistoryEventInterval = 10;
+constexpr size_t ConfigPlanets = 1000;
+
+std::vector<Util::Point3d> random_positions(size_t count, uint32_t seed) {
+    Bench::Random random(seed);
+    std::vector<Util::Point3d> positions;
+    positions.reserve(count);
+    for (size_t s = 0; s < count; s++) {
+        positions.push_back({ random.next(-30, 30) * Util::Constants::AU, random.next(-30, 30) * Util::Constants::AU,
+            random.next(-1, 1) * Util::Constants::AU });
+    }
+    return positions;
+}
+
+void benchmark_trail(Runner& runner) {
+    // A circular orbit sampled finer than the trail resolution, so that most
+    // points only move the last vertex (the atan2 heuristic) and some append.
+    runner.run("trail_push_back_orbit", TrailSize, [](size_t count) {
+        static Trail trail(TrailSize, Util::Colors::White);
+        static size_t step = 0;
+        for (size_t s = 0; s < count; s++, step++) {
+            double angle = 2 * M_PI * static_cast<double>(step % 5000) / 5000;
+            trail.push_back({ std::cos(angle) * Util::Constants::AU, std::sin(angle) * Util::Constants::AU, 0 });
+        }
+        Bench::do_not_optimize(trail);
+    });
+
+    // Scattered points, so that every point is appended.
+    runner.run("trail_push_back_random", TrailSize, [](size_t count) {
+        static Trail trail(TrailSize, Util::Colors::White);
+        static auto const positions = random_positions(4096, 1);
+        static size_t step = 0;
+        for (size_t s = 0; s < count; s++, step++)
+            trail.push_back(positions[step % positions.size()]);
+        Bench::do_not_optimize(trail);
+    });
+
+    runner.run("trail_recalculate_with_offset", TrailSize, [](size_t count) {
+        static Trail trail = [] {
+            Trail trail(TrailSize, Util::Colors::White);
+            for (auto const& position : random_positions(TrailSize * 2, 2))
+                trail.push_back(position);
+            return trail;
+        }();
+        static size_t step = 0;
+        for (size_t s = 0; s < count; s++, step++)
+            trail.recalculate_with_offset(step % 2 == 0 ? Util::Vector3d { Util::Constants::AU, 0, 0 } : Util::Vector3d { 0, Util::Constants::AU, 0 });
+        Bench::do_not_optimize(trail);
+    });
+}
+
+// Objects on circular orbits, sampled every 12 hours, as history entries
+// usually are. Entries are taken from them in a cycle.
+std::vector<PhysicsState> const& history_states() {
+    static std::vector<PhysicsState> const states = [] {
+        Bench::Random random(3);
+        std::vector<double> radii, phases, angular_velocities;
+        for (size_t s = 0; s < HistoryObjects; s++) {
+            radii.push_back(random.next(0.3, 30) * Util::Constants::AU);
+            phases.push_back(random.next(0, 2 * M_PI));
+            angular_velocities.push_back(std::sqrt(Util::Constants::Gravity * 2e30 / (radii.back() * radii.back() * radii.back())));
+        }
+        std::vector<PhysicsState> states(HistoryStates);
+        for (size_t t = 0; t < HistoryStates; t++) {
+            for (size_t s = 0; s < HistoryObjects; s++) {
+                double const angle = phases[s] + angular_velocities[s] * 43200 * static_cast<double>(t);
+                double const speed = radii[s] * angular_velocities[s];
+                states[t].append({ .pos = { radii[s] * std::cos(angle), radii[s] * std::sin(angle), 0 },
+                    .vel = { -speed * std::sin(angle), speed * std::cos(angle), 0 },
+                    .acc = {},
+                    .gravity_factor = 0 });
+            }
+        }
+        return states;
+    }();
+    return states;
+}
+
+bool fill_history(History& history, unsigned precision) {
+    auto const& states = history_states();
+    history.set_precision(precision);
+    PhysicsState appended;
+    for (size_t s = 0; s < HistoryObjects; s++) {
+        appended.append(states[0].body(s));
+        history.append(appended);
+    }
+    for (size_t t = 0; t < HistoryTicks; t++)
+        history.record(history.move_forward(), states[t % HistoryStates], 0, HistoryObjects);
+    return true;
+}
+
+// Forward simulation with a full history: every move records a new entry,
+// and the oldest chunk is dropped every ChunkLength moves.
+template<unsigned Precision>
+void history_move_forward(size_t count) {
+    static History history(HistoryMemoryBudget);
+    [[maybe_unused]] static bool const filled = fill_history(history, Precision);
+    static size_t step = 0;
+    for (size_t s = 0; s < count; s++, step++) {
+        auto const move = history.move_forward();
+        history.record(move, history_states()[step % HistoryStates], 0, HistoryObjects);
+        Bench::do_not_optimize(move);
+    }
+}
+
+// Every operation moves all HistoryObjects objects by one tick.
+void benchmark_history(Runner& runner) {
+    runner.run("history_move_forward", HistoryObjects, history_move_forward<History::LosslessPrecision>);
+    runner.run("history_move_forward_precision_24", HistoryObjects, history_move_forward<24>);
+
+    // Alternating rewinds and replays of 100 ticks, as when scrubbing the
+    // time back and forth.
+    runner.run("history_rewind_replay", HistoryObjects, [](size_t count) {
+        static History history(HistoryMemoryBudget);
+        [[maybe_unused]] static bool const filled = fill_history(history, History::LosslessPrecision);
+        static PhysicsState state = history_states()[0];
+        static size_t step = 0;
+        for (size_t s = 0; s < count; s++, step++) {
+            auto const move = step / 100 % 2 == 0 ? history.move_backward() : history.move_forward();
+            if (move.replay)
+                history.replay(move, state, 0, state.size());
+            else
+                history.record(move, state, 0, state.size());
+            Bench::do_not_optimize(state);
+        }
+    });
+}
+
+void benchmark_object_history(Runner& runner) {
+    static std::vector<std::unique_ptr<Object>> objects;
+    static ObjectHistory object_history = [] {
+        ObjectHistory object_history;
+        for (size_t s = 0; s < ObjectHistorySize; s++) {
+            objects.push_back(std::make_unique<Object>(1e20, 1e6, Util::DeprecatedVector3d {}, Util::DeprecatedVector3d {},
+                Util::Colors::White, Util::UString { fmt::format("Object {}", s) }, 0));
+            object_history.add_event(Util::SimulationClock::time_point { Util::SimulationClock::duration(s * ObjectHistoryEventInterval) },
+                objects.back().get());
+        }
+        return object_history;
+    }();
+
+    // Ticks of one second through the events, then back to the first one,
+    // which passes all of them.
+    runner.run("object_history_set_time", ObjectHistorySize, [](size_t count) {
+        static size_t second = 0;
+        size_t passed = 0;
+        for (size_t s = 0; s < count; s++) {
+            second = (second + 1) % (ObjectHistorySize * ObjectHistoryEventInterval);
+            object_history.set_time(Util::SimulationClock::time_point { Util::SimulationClock::duration(second) }, [&](Object&) { passed++; });
+        }
+        Bench::do_not_optimize(passed);
+    });
+}
+
+std::string generate_world_file(size_t planets) {
+    Bench::Random random(3);
+    std::string content = "planet name=Sun mass=1.98892e30 radius=695700000 colorb=0;\n"
+                          "simulation gravity_solver=direct;\n";
+    for (size_t s = 1; s < planets; s++) {
+        double periapsis = random.next(0.3, 30);
+        content += fmt::format(
+            "\norbiting_planet\n"
+            "    around=Sun\n"
+            "    mass={:.6g}\n"
+            "    radius={:.1f}\n"
+            "    apoapsis={:.6f}_AU\n"
+            "    periapsis={:.6f}_AU\n"
+            "    direction=left\n"
+            "    orbit_position={:.4f}\n"
+            "    orbit_tilt={:.4f}\n"
+            "    colorr={} colorg={} colorb={}\n"
+            "    name=Planet{};\n",
+            std::pow(10, random.next(20, 27)), random.next(1e6, 7e7), periapsis * random.next(1, 1.5), periapsis, random.next(0, 360),
+            random.next(-5, 5), static_cast<int>(random.next(0, 256)), static_cast<int>(random.next(0, 256)), static_cast<int>(random.next(0, 256)), s);
+    }
+    return content;
+}
+
+void benchmark_config_loader(Runner& runner) {
+    static auto const path = std::filesystem::temp_directory_path() / fmt::format("essa-microbench-{}.essa", ConfigPlanets);
+    {
+        std::ofstream file(path);
+        file << generate_world_file(ConfigPlanets);
+    }
+
+    runner.run("config_loader_parse", ConfigPlanets, [](size_t count) {
+        World world;
+        for (size_t s = 0; s < count; s++) {
+            auto config = ConfigLoader::load(path.string(), world);
+            if (config.is_error()) {
+                std::cerr << "essa-microbench: Failed to parse generated world file " << path << "\n";
+                std::exit(1);
+            }
+            Bench::do_not_optimize(config.release_value());
+        }
+    });
+
+    std::filesystem::remove(path);
+}
+
+}
+
+int main(int argc, char** argv) {
+    auto options = parse_options(argc, argv);
+    if (!options) {
+        print_usage();
+        return 1;
+    }
+
+    Runner runner(*options);
+    benchmark_trail(runner);
+    benchmark_history(runner);
+    benchmark_object_history(runner);
+    benchmark_config_loader(runner);
+
+    std::ofstream output_file;
+    if (options->output_file) {
+        output_file.open(*options->output_file);
+        if (!output_file) {
+            std::cerr << "essa-microbench: Failed to open " << *options->output_file << " for writing\n";
+            return 1;
+        }
+    }
+    runner.print_json(options->output_file ? output_file : std::cout);
+    return 0;
+}
@@ -20,7 +20,7 @@ public:
 
     Object* new_object() { return m_new_object.get(); }
     Object* forward_simulated_new_object() { return m_forward_simulated_new_object; }
-    World& forward_simulated_world() { return m_forward_simulated_world; }
+    World& forward_simulated_world() { return *m_forward_simulated_world; }
 
     bool is_forward_simulation_valid() const { return m_forward_simulation_is_valid; }
     bool new_object_exist() const { return m_new_object != nullptr; }
@@ -57,7 +57,7 @@ private:
     GUI::ImageButton* m_toggle_orbit_direction_button = nullptr;
     GUI::ImageButton* m_require_orbit_point_button = nullptr;
 
-    World m_forward_simulated_world;
+    std::unique_ptr<World> m_forward_simulated_world = std::make_unique<World>();
     Util::DeprecatedVector3d m_new_object_pos;
 
     std::unique_ptr<Object> m_new_object;
@@ -34,7 +34,6 @@ void EssaGUI::on_init() {
         m_simulation_view = root_container.add_widget<SimulationView>(m_world);
         m_simulation_view->set_size({ { 100, Util::Length::Percent }, { 100, Util::Length::Percent } });
         // m_simulation_view->set_visible(false);
-        m_world.m_simulation_view = m_simulation_view;
 
         m_simulation_view->on_change_focus = [&](Object* obj) {
             if (obj == nullptr)
@@ -44,7 +43,7 @@ void EssaGUI::on_init() {
             if (focused_object_window.opened) {
                 focused_object_window.window->set_position({ raw_size().x() - 550, 50 });
                 focused_object_window.window->set_size({ 500, 600 });
-                auto& focused_object_gui = focused_object_window.window->set_main_widget<FocusedObjectGUI>(obj, focused_object_window.window, m_world);
+                auto& focused_object_gui = focused_object_window.window->set_main_widget<FocusedObjectGUI>(obj, focused_object_window.window, *m_simulation_view);
                 focused_object_gui.update_params();
                 focused_object_window.window->on_close = [&]() {
                     if (m_settings_gui->unfocus_on_wnd_close()) {
@@ -63,6 +62,11 @@ void EssaGUI::on_init() {
                 if (wnd.id() == "FocusedGUI")
                     wnd.close();
             });
+            m_simulation_view->set_focused_object(nullptr);
+        };
+
+        m_world.on_delete_object = [&](Object*) {
+            m_simulation_view->set_focused_object(nullptr);
         };
 
         auto home_button = root_container.add_widget<GUI::ImageButton>();
@@ -25,6 +25,28 @@ void EssaSettings::on_init() {
     title_label->set_alignment(GUI::Align::Center);
 
     auto tab_widget = add_widget<GUI::TabWidget>();
+
+    auto add_toggle = [&](GUI::Container& container, Util::UString title, auto on_change, bool default_value = true) {
+        auto toggle_container = container.add_widget<GUI::Container>();
+        auto& toggle_layout = toggle_container->set_layout<GUI::HorizontalBoxLayout>();
+        toggle_layout.set_spacing(10);
+        toggle_container->set_size({ Util::Length::Auto, 30.0_px });
+        auto button_label = toggle_container->add_widget<GUI::Textfield>();
+        button_label->set_content(title + ": ");
+        button_label->set_size({ { 70, Util::Length::Percent }, 30.0_px });
+        auto toggle = toggle_container->add_widget<GUI::TextButton>();
+        toggle->set_content("Off");
+        toggle->set_active_content("On");
+        toggle->set_toggleable(true);
+        toggle->set_active(true);
+        toggle->set_alignment(GUI::Align::Center);
+        toggle->on_change = std::move(on_change);
+        m_on_restore_defaults.push_back([toggle, default_value]() {
+            toggle->set_active(default_value);
+        });
+        return toggle;
+    };
+
     auto& simulation_settings = tab_widget->add_tab("Simulation");
     {
         auto& layout = simulation_settings.set_layout<GUI::VerticalBoxLayout>();
@@ -55,12 +77,19 @@ void EssaSettings::on_init() {
         m_on_restore_defaults.push_back([tick_length_control]() {
             tick_length_control->set_value(600); // 10 minutes
         });
-        tick_length_control->set_tooltip_text("Amount of simulation seconds per simulation tick (Affects accuracy)");
+        tick_length_control->set_tooltip_text("Amount of simulation seconds per simulation tick (Affects accuracy). Maximum tick length if adaptive tick is on");
         tick_length_control->on_change = [this](double value) {
             if (value > 0)
                 m_simulation_view.world().set_simulation_seconds_per_tick(value);
         };
 
+        auto adaptive_tick_toggle = add_toggle(
+            simulation_settings, "Adaptive tick", [this](bool state) {
+                m_simulation_view.world().set_adaptive_tick(state);
+            },
+            false);
+        adaptive_tick_toggle->set_tooltip_text("Choose tick length from the shortest orbital period, up to Tick Length");
+
         auto reset_trails_button = simulation_settings.add_widget<GUI::TextButton>();
         reset_trails_button->set_size({ Util::Length::Auto, 30.0_px });
         reset_trails_button->set_content("Clear Trails");
@@ -69,27 +98,6 @@ void EssaSettings::on_init() {
         };
     }
 
-    auto add_toggle = [&](GUI::Container& container, Util::UString title, auto on_change, bool default_value = true) {
-        auto toggle_container = container.add_widget<GUI::Container>();
-        auto& toggle_layout = toggle_container->set_layout<GUI::HorizontalBoxLayout>();
-        toggle_layout.set_spacing(10);
-        toggle_container->set_size({ Util::Length::Auto, 30.0_px });
-        auto button_label = toggle_container->add_widget<GUI::Textfield>();
-        button_label->set_content(title + ": ");
-        button_label->set_size({ { 70, Util::Length::Percent }, 30.0_px });
-        auto toggle = toggle_container->add_widget<GUI::TextButton>();
-        toggle->set_content("Off");
-        toggle->set_active_content("On");
-        toggle->set_toggleable(true);
-        toggle->set_active(true);
-        toggle->set_alignment(GUI::Align::Center);
-        toggle->on_change = std::move(on_change);
-        m_on_restore_defaults.push_back([toggle, default_value]() {
-            toggle->set_active(default_value);
-        });
-        return toggle;
-    };
-
     auto& display_settings = tab_widget->add_tab("Display");
     {
         auto& layout = display_settings.set_layout<GUI::VerticalBoxLayout>();
@@ -170,7 +178,7 @@ void EssaSettings::on_init() {
             this->m_simulation_view.set_show_trails(state);
         });
         add_toggle(display_settings, "Offset trails", [this](bool state) {
-            this->m_simulation_view.set_offset_trails(state);
+            this->m_simulation_view.world().set_offset_trails(state);
             this->m_simulation_view.world().reset_all_trails();
         });
         add_toggle(
@@ -8,10 +8,11 @@
 #include <iomanip>
 #include <memory>
 
-FocusedObjectGUI::FocusedObjectGUI(Object* o, GUI::MDI::Window* wnd, World& w)
+FocusedObjectGUI::FocusedObjectGUI(Object* o, GUI::MDI::Window* wnd, SimulationView& sv)
     : m_focused(o)
     , m_window(wnd)
-    , m_world(w) {
+    , m_simulation_view(sv)
+    , m_world(sv.world()) {
 }
 
 void FocusedObjectGUI::on_init() {
@@ -23,9 +24,9 @@ void FocusedObjectGUI::on_init() {
 
     tab_widget->on_tab_switch = [&](unsigned index) {
         if (m_tab == 1 && index != 1)
-            m_world.m_simulation_view->pop_pause();
+            m_simulation_view.pop_pause();
         else if (index == 1)
-            m_world.m_simulation_view->push_pause();
+            m_simulation_view.push_pause();
         m_tab = index;
     };
 
@@ -250,7 +251,7 @@ void FocusedObjectGUI::m_create_view_gui(GUI::Container& parent) {
 
     default_view_button->on_click = [&]() {
         m_window->close();
-        m_world.m_simulation_view->set_focused_object(m_focused);
+        m_simulation_view.set_focused_object(m_focused);
     };
 
     auto light_source_button_container = parent.add_widget<GUI::Container>();
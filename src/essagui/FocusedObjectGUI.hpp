@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Object.hpp"
+#include "../SimulationView.hpp"
 #include "../World.hpp"
 #include <Essa/GUI/Application.hpp>
 #include <Essa/GUI/Widgets/Button.hpp>
@@ -16,7 +17,7 @@
 
 class FocusedObjectGUI : public GUI::Container {
 public:
-    FocusedObjectGUI(Object* o, GUI::MDI::Window* wnd, World& w);
+    FocusedObjectGUI(Object* o, GUI::MDI::Window* wnd, SimulationView& sv);
 
     virtual void on_init() override;
     virtual void update() override;
@@ -29,6 +30,7 @@ private:
 
     Object* m_focused = nullptr;
     GUI::MDI::Window* m_window = nullptr;
+    SimulationView& m_simulation_view;
     World& m_world;
 
     unsigned m_tab = 0;
@@ -31,11 +31,22 @@ void SimulationInfo::on_init() {
     m_time_field = speed_container->add_widget<GUI::Textfield>();
     m_time_field->set_size({ Util::Length::Auto, Util::Length::Auto });
     m_update_time();
+
+    auto tick_container = add_widget<GUI::Container>();
+    tick_container->set_layout<GUI::HorizontalBoxLayout>().set_spacing(10);
+    auto tick_label = tick_container->add_widget<GUI::Textfield>();
+    tick_label->set_size({ 50.0_px, Util::Length::Auto });
+    tick_label->set_content("Tick: ");
+
+    m_tick_field = tick_container->add_widget<GUI::Textfield>();
+    m_tick_field->set_size({ Util::Length::Auto, Util::Length::Auto });
+    m_update_tick();
 }
 
 void SimulationInfo::do_update() {
     m_update_fps();
     m_update_time();
+    m_update_tick();
 }
 
 void SimulationInfo::m_update_fps() {
@@ -56,3 +67,15 @@ void SimulationInfo::m_update_time() {
     oss << ")";
     m_time_field->set_content(Util::UString { oss.str() });
 }
+
+void SimulationInfo::m_update_tick() {
+    auto const& world = m_simulation_view->world();
+    std::ostringstream oss;
+    oss << world.tick_length() << " s";
+    if (world.adaptive_tick())
+        oss << " (adaptive)";
+
+    // Ticks done per second of real time.
+    oss << ", " << std::abs(m_simulation_view->speed()) * m_simulation_view->iterations() * m_fps << " ticks/s";
+    m_tick_field->set_content(Util::UString { oss.str() });
+}
@@ -21,8 +21,10 @@ private:
 
     void m_update_time();
     void m_update_fps();
+    void m_update_tick();
 
     GUI::Textfield* m_fps_field = nullptr;
     GUI::Textfield* m_time_field = nullptr;
+    GUI::Textfield* m_tick_field = nullptr;
     SimulationView* m_simulation_view = nullptr;
 };
@@ -0,0 +1,90 @@
+#include "AccuracyReport.hpp"
+
+#include "BarnesHut.hpp"
+#include "Direct.hpp"
+#include "FastMultipole.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fmt/core.h>
+
+namespace Gravity {
+
+namespace {
+
+PhysicsState copy_with_cleared_forces(PhysicsState const& state) {
+    auto copy = state;
+    std::fill(copy.acc_x.begin(), copy.acc_x.end(), 0);
+    std::fill(copy.acc_y.begin(), copy.acc_y.end(), 0);
+    std::fill(copy.acc_z.begin(), copy.acc_z.end(), 0);
+    return copy;
+}
+
+template<class Callback>
+AccuracyReportEntry measure(std::string name, PhysicsState const& initial, PhysicsState const& reference, Callback&& compute) {
+    auto state = copy_with_cleared_forces(initial);
+    auto start = std::chrono::steady_clock::now();
+    compute(state);
+    auto end = std::chrono::steady_clock::now();
+
+    std::vector<double> errors;
+    for (auto const s : state.active) {
+        double const reference_magnitude = std::sqrt(reference.acc_x[s] * reference.acc_x[s]
+            + reference.acc_y[s] * reference.acc_y[s]
+            + reference.acc_z[s] * reference.acc_z[s]);
+        if (reference_magnitude == 0)
+            continue;
+        double const error_x = state.acc_x[s] - reference.acc_x[s];
+        double const error_y = state.acc_y[s] - reference.acc_y[s];
+        double const error_z = state.acc_z[s] - reference.acc_z[s];
+        errors.push_back(std::sqrt(error_x * error_x + error_y * error_y + error_z * error_z) / reference_magnitude);
+    }
+
+    AccuracyReportEntry entry;
+    entry.solver = std::move(name);
+    entry.seconds = std::chrono::duration<double>(end - start).count();
+    if (!errors.empty()) {
+        std::sort(errors.begin(), errors.end());
+        double sum = 0;
+        for (auto error : errors)
+            sum += error;
+        entry.mean_error = sum / errors.size();
+        entry.percentile_99_error = errors[(errors.size() - 1) * 99 / 100];
+        entry.max_error = errors.back();
+    }
+    return entry;
+}
+
+}
+
+std::vector<AccuracyReportEntry> make_accuracy_report(PhysicsState const& state, double opening_angle, std::span<unsigned const> expansion_orders) {
+    std::vector<AccuracyReportEntry> report;
+
+    auto reference = copy_with_cleared_forces(state);
+    auto start = std::chrono::steady_clock::now();
+    compute_direct(reference);
+    auto end = std::chrono::steady_clock::now();
+    report.push_back({ .solver = "direct", .seconds = std::chrono::duration<double>(end - start).count() });
+
+    BarnesHut barnes_hut;
+    barnes_hut.set_opening_angle(opening_angle);
+    report.push_back(measure(fmt::format("barnes_hut opening_angle={}", opening_angle), state, reference,
+        [&](PhysicsState& copy) { barnes_hut.compute(copy); }));
+
+    FastMultipole fast_multipole;
+    for (auto order : expansion_orders) {
+        fast_multipole.set_expansion_order(order);
+        report.push_back(measure(fmt::format("fmm expansion_order={}", fast_multipole.expansion_order()), state, reference,
+            [&](PhysicsState& copy) { fast_multipole.compute(copy); }));
+    }
+    return report;
+}
+
+void print_accuracy_report(std::vector<AccuracyReportEntry> const& report) {
+    fmt::print("{:<32} {:>12} {:>12} {:>12} {:>10}\n", "solver", "mean error", "99% error", "max error", "time [s]");
+    for (auto const& entry : report)
+        fmt::print("{:<32} {:>12.3e} {:>12.3e} {:>12.3e} {:>10.4f}\n", entry.solver, entry.mean_error, entry.percentile_99_error, entry.max_error, entry.seconds);
+}
+
+}
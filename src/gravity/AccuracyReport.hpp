@@ -0,0 +1,29 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Gravity {
+
+// Accuracy of an approximate solver. Errors are relative to direct summation
+// (|a - a_direct| / |a_direct|) over all alive objects.
+struct AccuracyReportEntry {
+    std::string solver;
+    double mean_error {};
+    double percentile_99_error {};
+    double max_error {};
+    double seconds {};
+};
+
+// Calculates accelerations for the state with direct summation, Barnes-Hut
+// with the given opening angle and FMM with every given expansion order, and
+// compares them. Used to choose a solver for a given scenario. The state
+// itself is not modified. The first entry is the direct summation itself.
+std::vector<AccuracyReportEntry> make_accuracy_report(PhysicsState const&, double opening_angle, std::span<unsigned const> expansion_orders);
+
+void print_accuracy_report(std::vector<AccuracyReportEntry> const&);
+
+}
@@ -0,0 +1,91 @@
+#include "BarnesHut.hpp"
+
+#include <array>
+#include <cassert>
+#include <cmath>
+
+namespace Gravity {
+
+void BarnesHut::build(PhysicsState const& state) {
+    m_tree.build(state, LeafCapacity);
+}
+
+void BarnesHut::accumulate(PhysicsState& state, size_t first, size_t last) const {
+    if (m_tree.is_empty())
+        return;
+    for (size_t a = first; a < last; a++)
+        accumulate_for_object(state, state.active[a]);
+}
+
+void BarnesHut::accumulate_for_object(PhysicsState& state, size_t index) const {
+    double const this_x = state.pos_x[index];
+    double const this_y = state.pos_y[index];
+    double const this_z = state.pos_z[index];
+    double const theta_squared = m_opening_angle * m_opening_angle;
+
+    double acc_x = 0, acc_y = 0, acc_z = 0;
+
+    auto attract = [&](double x, double y, double z, double gravity_factor) {
+        double const dist_x = x - this_x;
+        double const dist_y = y - this_y;
+        double const dist_z = z - this_z;
+        double const distance_squared = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+        if (distance_squared == 0)
+            return;
+        double const factor = gravity_factor / (distance_squared * std::sqrt(distance_squared));
+        acc_x += dist_x * factor;
+        acc_y += dist_y * factor;
+        acc_z += dist_z * factor;
+    };
+
+    // Every level adds at most 7 nodes to the stack (the 8th is taken immediately).
+    std::array<uint32_t, Octree::MaxDepth * 7 + 8> stack;
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    auto const nodes = m_tree.nodes();
+    auto const order = m_tree.order();
+    while (stack_size > 0) {
+        auto const& node = nodes[stack[--stack_size]];
+        if (node.gravity_factor == 0)
+            continue;
+
+        if (node.is_leaf()) {
+            for (uint32_t s = node.first_object; s < node.first_object + node.object_count; s++) {
+                auto other = order[s];
+                if (other == index)
+                    continue;
+                double const other_gravity_factor = state.gravity_factor[other];
+                if (other_gravity_factor == 0)
+                    continue;
+                attract(state.pos_x[other], state.pos_y[other], state.pos_z[other], other_gravity_factor);
+            }
+            continue;
+        }
+
+        double const dist_x = node.mass_x - this_x;
+        double const dist_y = node.mass_y - this_y;
+        double const dist_z = node.mass_z - this_z;
+        double const distance_squared = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+        double const size = node.half_size * 2;
+        if (!node.contains(this_x, this_y, this_z) && size * size < theta_squared * distance_squared) {
+            attract(node.mass_x, node.mass_y, node.mass_z, node.gravity_factor);
+            continue;
+        }
+
+        assert(stack_size + node.child_count <= stack.size());
+        for (uint32_t c = node.first_child; c < node.first_child + node.child_count; c++)
+            stack[stack_size++] = c;
+    }
+
+    state.acc_x[index] += acc_x;
+    state.acc_y[index] += acc_y;
+    state.acc_z[index] += acc_z;
+}
+
+void BarnesHut::compute(PhysicsState& state) {
+    build(state);
+    accumulate(state, 0, state.active.size());
+}
+
+}
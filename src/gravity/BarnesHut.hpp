@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+#include "Octree.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Gravity {
+
+// Barnes-Hut octree approximation of the gravity forces. Distant groups of
+// objects are replaced by a single point mass placed in their center of
+// mass, so that a force pass costs O(N log N) instead of O(N^2).
+//
+// https://en.wikipedia.org/wiki/Barnes%E2%80%93Hut_simulation
+class BarnesHut {
+public:
+    // A cell of size s seen from distance d is approximated as a point mass
+    // when s / d < opening_angle. 0 gives exact (but slower than direct)
+    // results, 0.5 - 1 is a typical range.
+    static constexpr double DefaultOpeningAngle = 0.5;
+
+    void set_opening_angle(double theta) { m_opening_angle = theta; }
+    double opening_angle() const { return m_opening_angle; }
+
+    // Builds the tree from alive objects of the state.
+    void build(PhysicsState const&);
+
+    // Adds the attraction to acc_* of objects active[first, last).
+    // Must be called after build() on the same (unmodified) state.
+    void accumulate(PhysicsState&, size_t first, size_t last) const;
+
+    // build() + accumulate() for all objects.
+    void compute(PhysicsState&);
+
+    size_t node_count() const { return m_tree.nodes().size(); }
+
+private:
+    static constexpr uint32_t LeafCapacity = 8;
+
+    void accumulate_for_object(PhysicsState&, size_t index) const;
+
+    double m_opening_angle = DefaultOpeningAngle;
+    Octree m_tree;
+};
+
+}
@@ -0,0 +1,296 @@
+#include "Direct.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#    define ESSA_DIRECT_X86 1
+#    include <immintrin.h>
+#endif
+
+namespace Gravity {
+
+namespace {
+
+void compute_symmetric_scalar(PhysicsState& state) {
+    auto const& active = state.active;
+
+    // Every pair is visited once; the attraction is applied to both
+    // objects (with opposite sign).
+    for (size_t a = 0; a < active.size(); a++) {
+        auto const i = active[a];
+        double const this_x = state.pos_x[i];
+        double const this_y = state.pos_y[i];
+        double const this_z = state.pos_z[i];
+        double const this_gravity_factor = state.gravity_factor[i];
+        double acc_x = state.acc_x[i];
+        double acc_y = state.acc_y[i];
+        double acc_z = state.acc_z[i];
+
+        for (size_t b = a + 1; b < active.size(); b++) {
+            auto const j = active[b];
+
+            // TODO: Collisions
+            double const dist_x = this_x - state.pos_x[j];
+            double const dist_y = this_y - state.pos_y[j];
+            double const dist_z = this_z - state.pos_z[j];
+
+            // denominator: R^2*normalized(dist)
+            double denominator = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+            if (denominator == 0)
+                continue;
+            denominator *= std::sqrt(denominator);
+            double const base_x = dist_x / denominator;
+            double const base_y = dist_y / denominator;
+            double const base_z = dist_z / denominator;
+
+            double const other_gravity_factor = state.gravity_factor[j];
+
+            acc_x -= base_x * other_gravity_factor;
+            acc_y -= base_y * other_gravity_factor;
+            acc_z -= base_z * other_gravity_factor;
+
+            state.acc_x[j] += base_x * this_gravity_factor;
+            state.acc_y[j] += base_y * this_gravity_factor;
+            state.acc_z[j] += base_z * this_gravity_factor;
+        }
+
+        state.acc_x[i] = acc_x;
+        state.acc_y[i] = acc_y;
+        state.acc_z[i] = acc_z;
+    }
+}
+
+// Same as compute_symmetric_scalar(), but every object sums attraction of all
+// others on its own. Operations and their order are the same for every
+// object (dist is negated for j > i, which is exact), so that the results are
+// bit-identical.
+void accumulate_rows_scalar(PhysicsState& state, size_t first, size_t last) {
+    auto const& active = state.active;
+    for (size_t a = first; a < last; a++) {
+        auto const i = active[a];
+        double const this_x = state.pos_x[i];
+        double const this_y = state.pos_y[i];
+        double const this_z = state.pos_z[i];
+        double acc_x = state.acc_x[i];
+        double acc_y = state.acc_y[i];
+        double acc_z = state.acc_z[i];
+
+        for (auto const j : active) {
+            if (j == i)
+                continue;
+
+            double const dist_x = state.pos_x[j] - this_x;
+            double const dist_y = state.pos_y[j] - this_y;
+            double const dist_z = state.pos_z[j] - this_z;
+
+            double denominator = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+            if (denominator == 0)
+                continue;
+            denominator *= std::sqrt(denominator);
+            double const base_x = dist_x / denominator;
+            double const base_y = dist_y / denominator;
+            double const base_z = dist_z / denominator;
+
+            double const other_gravity_factor = state.gravity_factor[j];
+            acc_x += base_x * other_gravity_factor;
+            acc_y += base_y * other_gravity_factor;
+            acc_z += base_z * other_gravity_factor;
+        }
+
+        state.acc_x[i] = acc_x;
+        state.acc_y[i] = acc_y;
+        state.acc_z[i] = acc_z;
+    }
+}
+
+void store_result(PhysicsState& state, DirectSummation::PackedObjects const& objects, size_t i, double acc_x, double acc_y, double acc_z) {
+    auto const index = objects.index[i];
+    state.acc_x[index] += acc_x;
+    state.acc_y[index] += acc_y;
+    state.acc_z[index] += acc_z;
+}
+
+#ifdef ESSA_DIRECT_X86
+
+__attribute__((target("avx2,fma"))) void accumulate_rows_avx2(DirectSummation::PackedObjects const& objects, PhysicsState& state, size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        __m256d const this_x = _mm256_set1_pd(objects.x[i]);
+        __m256d const this_y = _mm256_set1_pd(objects.y[i]);
+        __m256d const this_z = _mm256_set1_pd(objects.z[i]);
+        __m256d const zero = _mm256_setzero_pd();
+
+        __m256d acc_x = zero, acc_y = zero, acc_z = zero;
+
+        for (size_t j = 0; j < objects.padded_count; j += 4) {
+            __m256d const dist_x = _mm256_sub_pd(_mm256_loadu_pd(&objects.x[j]), this_x);
+            __m256d const dist_y = _mm256_sub_pd(_mm256_loadu_pd(&objects.y[j]), this_y);
+            __m256d const dist_z = _mm256_sub_pd(_mm256_loadu_pd(&objects.z[j]), this_z);
+            __m256d const other_gravity_factor = _mm256_loadu_pd(&objects.gravity_factor[j]);
+
+            __m256d const distance_squared = _mm256_fmadd_pd(dist_x, dist_x, _mm256_fmadd_pd(dist_y, dist_y, _mm256_mul_pd(dist_z, dist_z)));
+            // Masks out the object itself (and coincident objects).
+            __m256d const interacts = _mm256_cmp_pd(distance_squared, zero, _CMP_GT_OQ);
+            __m256d const inverse_distance_cubed = _mm256_div_pd(_mm256_set1_pd(1), _mm256_mul_pd(distance_squared, _mm256_sqrt_pd(distance_squared)));
+            __m256d const factor = _mm256_and_pd(interacts, _mm256_mul_pd(other_gravity_factor, inverse_distance_cubed));
+            acc_x = _mm256_fmadd_pd(dist_x, factor, acc_x);
+            acc_y = _mm256_fmadd_pd(dist_y, factor, acc_y);
+            acc_z = _mm256_fmadd_pd(dist_z, factor, acc_z);
+        }
+
+        alignas(32) double lane_acc_x[4], lane_acc_y[4], lane_acc_z[4];
+        _mm256_store_pd(lane_acc_x, acc_x);
+        _mm256_store_pd(lane_acc_y, acc_y);
+        _mm256_store_pd(lane_acc_z, acc_z);
+        store_result(state, objects, i,
+            (lane_acc_x[0] + lane_acc_x[1]) + (lane_acc_x[2] + lane_acc_x[3]),
+            (lane_acc_y[0] + lane_acc_y[1]) + (lane_acc_y[2] + lane_acc_y[3]),
+            (lane_acc_z[0] + lane_acc_z[1]) + (lane_acc_z[2] + lane_acc_z[3]));
+    }
+}
+
+__attribute__((target("avx512f"))) void accumulate_rows_avx512(DirectSummation::PackedObjects const& objects, PhysicsState& state, size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        __m512d const this_x = _mm512_set1_pd(objects.x[i]);
+        __m512d const this_y = _mm512_set1_pd(objects.y[i]);
+        __m512d const this_z = _mm512_set1_pd(objects.z[i]);
+        __m512d const zero = _mm512_setzero_pd();
+
+        __m512d acc_x = zero, acc_y = zero, acc_z = zero;
+
+        for (size_t j = 0; j < objects.padded_count; j += 8) {
+            __m512d const dist_x = _mm512_sub_pd(_mm512_loadu_pd(&objects.x[j]), this_x);
+            __m512d const dist_y = _mm512_sub_pd(_mm512_loadu_pd(&objects.y[j]), this_y);
+            __m512d const dist_z = _mm512_sub_pd(_mm512_loadu_pd(&objects.z[j]), this_z);
+            __m512d const other_gravity_factor = _mm512_loadu_pd(&objects.gravity_factor[j]);
+
+            __m512d const distance_squared = _mm512_fmadd_pd(dist_x, dist_x, _mm512_fmadd_pd(dist_y, dist_y, _mm512_mul_pd(dist_z, dist_z)));
+            // Masks out the object itself (and coincident objects).
+            __mmask8 const interacts = _mm512_cmp_pd_mask(distance_squared, zero, _CMP_GT_OQ);
+            // 1/r from 14-bit approximation refined with two Newton-Raphson
+            // steps (14 -> 28 -> 52 bits), much cheaper than sqrt + div.
+            __m512d inverse_distance = _mm512_maskz_rsqrt14_pd(interacts, distance_squared);
+            __m512d const half_distance_squared = _mm512_mul_pd(distance_squared, _mm512_set1_pd(0.5));
+            inverse_distance = _mm512_mul_pd(inverse_distance, _mm512_fnmadd_pd(half_distance_squared, _mm512_mul_pd(inverse_distance, inverse_distance), _mm512_set1_pd(1.5)));
+            inverse_distance = _mm512_mul_pd(inverse_distance, _mm512_fnmadd_pd(half_distance_squared, _mm512_mul_pd(inverse_distance, inverse_distance), _mm512_set1_pd(1.5)));
+            __m512d const inverse_distance_cubed = _mm512_mul_pd(inverse_distance, _mm512_mul_pd(inverse_distance, inverse_distance));
+            __m512d const factor = _mm512_mul_pd(other_gravity_factor, inverse_distance_cubed);
+            acc_x = _mm512_fmadd_pd(dist_x, factor, acc_x);
+            acc_y = _mm512_fmadd_pd(dist_y, factor, acc_y);
+            acc_z = _mm512_fmadd_pd(dist_z, factor, acc_z);
+        }
+
+        alignas(64) double lane_acc_x[8], lane_acc_y[8], lane_acc_z[8];
+        _mm512_store_pd(lane_acc_x, acc_x);
+        _mm512_store_pd(lane_acc_y, acc_y);
+        _mm512_store_pd(lane_acc_z, acc_z);
+        auto sum_lanes = [](double const* lanes) {
+            return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+        };
+        store_result(state, objects, i, sum_lanes(lane_acc_x), sum_lanes(lane_acc_y), sum_lanes(lane_acc_z));
+    }
+}
+
+#endif
+
+}
+
+bool is_supported(DirectKernel kernel) {
+    switch (kernel) {
+    case DirectKernel::Scalar:
+        return true;
+#ifdef ESSA_DIRECT_X86
+    case DirectKernel::AVX2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case DirectKernel::AVX512:
+        return __builtin_cpu_supports("avx512f");
+#else
+    case DirectKernel::AVX2:
+    case DirectKernel::AVX512:
+        return false;
+#endif
+    }
+    return false;
+}
+
+char const* direct_kernel_name(DirectKernel kernel) {
+    switch (kernel) {
+    case DirectKernel::Scalar:
+        return "scalar";
+    case DirectKernel::AVX2:
+        return "avx2";
+    case DirectKernel::AVX512:
+        return "avx512";
+    }
+    return "";
+}
+
+DirectKernel best_direct_kernel() {
+    static DirectKernel const kernel = [] {
+        if (is_supported(DirectKernel::AVX512))
+            return DirectKernel::AVX512;
+        if (is_supported(DirectKernel::AVX2))
+            return DirectKernel::AVX2;
+        return DirectKernel::Scalar;
+    }();
+    return kernel;
+}
+
+void DirectSummation::PackedObjects::pack(PhysicsState const& state) {
+    x.clear();
+    y.clear();
+    z.clear();
+    gravity_factor.clear();
+    index.clear();
+    for (auto const s : state.active) {
+        x.push_back(state.pos_x[s]);
+        y.push_back(state.pos_y[s]);
+        z.push_back(state.pos_z[s]);
+        gravity_factor.push_back(state.gravity_factor[s]);
+        index.push_back(s);
+    }
+    padded_count = (index.size() + 7) / 8 * 8;
+    x.resize(padded_count);
+    y.resize(padded_count);
+    z.resize(padded_count);
+    gravity_factor.resize(padded_count);
+}
+
+void DirectSummation::prepare(PhysicsState const& state) {
+    if (m_kernel != DirectKernel::Scalar)
+        m_objects.pack(state);
+}
+
+void DirectSummation::accumulate(PhysicsState& state, size_t first, size_t last) const {
+    if (m_kernel == DirectKernel::Scalar) {
+        accumulate_rows_scalar(state, first, last);
+        return;
+    }
+
+#ifdef ESSA_DIRECT_X86
+    // Objects are packed in the order of active.
+    if (m_kernel == DirectKernel::AVX512)
+        accumulate_rows_avx512(m_objects, state, first, last);
+    else
+        accumulate_rows_avx2(m_objects, state, first, last);
+#endif
+}
+
+void DirectSummation::compute(PhysicsState& state) {
+    if (m_kernel == DirectKernel::Scalar) {
+        compute_symmetric_scalar(state);
+        return;
+    }
+    prepare(state);
+    accumulate(state, 0, state.active.size());
+}
+
+void compute_direct(PhysicsState& state) {
+    DirectSummation { best_direct_kernel() }.compute(state);
+}
+
+void compute_direct(PhysicsState& state, DirectKernel kernel) {
+    DirectSummation { kernel }.compute(state);
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace Gravity {
+
+// Implementation of the direct summation.
+enum class DirectKernel {
+    // Visits every pair once and applies the attraction to both objects.
+    Scalar,
+
+    // Sum over all other objects for every object, 4 (AVX2) or 8 (AVX-512)
+    // objects at a time. Does twice as much arithmetic as Scalar, but is
+    // still a few times faster. Results are equal to Scalar within rounding
+    // errors.
+    AVX2,
+    AVX512,
+};
+
+bool is_supported(DirectKernel);
+char const* direct_kernel_name(DirectKernel);
+
+// Fastest kernel supported by the CPU.
+DirectKernel best_direct_kernel();
+
+// Exact O(N^2) summation over all pairs of alive objects. Adds the attraction
+// to acc_*. Coincident objects don't attract each other.
+class DirectSummation {
+public:
+    // Unsupported kernels fall back to Scalar.
+    explicit DirectSummation(DirectKernel kernel = best_direct_kernel())
+        : m_kernel(is_supported(kernel) ? kernel : DirectKernel::Scalar) { }
+
+    DirectKernel kernel() const { return m_kernel; }
+
+    // Calculates the attraction for all objects.
+    void compute(PhysicsState&);
+
+    // compute() split into independent parts, so that it can be spread across
+    // threads: prepare() once, then accumulate() for every part of
+    // [0, active count). accumulate() adds the attraction to acc_* of objects
+    // active[first, last). Results are bit-identical to compute() regardless
+    // of how the objects are split.
+    void prepare(PhysicsState const&);
+    void accumulate(PhysicsState&, size_t first, size_t last) const;
+
+    // Alive objects packed together and padded to a multiple of 8 with
+    // massless objects, so that the vector kernels need neither alive masks
+    // nor a scalar tail loop.
+    struct PackedObjects {
+        std::vector<double> x, y, z, gravity_factor;
+        std::vector<size_t> index;
+        size_t padded_count {};
+
+        void pack(PhysicsState const&);
+        size_t count() const { return index.size(); }
+    };
+
+private:
+    DirectKernel m_kernel;
+    PackedObjects m_objects;
+};
+
+void compute_direct(PhysicsState&);
+void compute_direct(PhysicsState&, DirectKernel);
+
+}
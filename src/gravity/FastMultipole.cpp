@@ -0,0 +1,511 @@
+#include "FastMultipole.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Gravity {
+
+namespace {
+
+double binomial(unsigned n, unsigned k) {
+    double result = 1;
+    for (unsigned i = 1; i <= k; i++)
+        result = result * (n - k + i) / i;
+    return result;
+}
+
+}
+
+FastMultipole::FastMultipole() {
+    set_expansion_order(DefaultExpansionOrder);
+}
+
+void FastMultipole::set_expansion_order(unsigned order) {
+    order = std::clamp(order, 1u, MaxExpansionOrder);
+    if (order == m_order)
+        return;
+    m_order = order;
+    build_tables();
+}
+
+uint32_t FastMultipole::coefficient_index(unsigned x, unsigned y, unsigned z) const {
+    return m_index_lookup[(x * (m_order + 1) + y) * (m_order + 1) + z];
+}
+
+void FastMultipole::build_tables() {
+    auto const p = m_order;
+
+    m_multi_indices.clear();
+    for (unsigned degree = 0; degree <= p; degree++) {
+        for (unsigned x = degree + 1; x-- > 0;) {
+            for (unsigned y = degree - x + 1; y-- > 0;) {
+                m_multi_indices.push_back({ static_cast<uint8_t>(x), static_cast<uint8_t>(y), static_cast<uint8_t>(degree - x - y) });
+            }
+        }
+    }
+    m_coefficient_count = m_multi_indices.size();
+
+    m_index_lookup.assign((p + 1) * (p + 1) * (p + 1), 0);
+    for (uint32_t i = 0; i < m_coefficient_count; i++) {
+        auto const& n = m_multi_indices[i];
+        m_index_lookup[(n.x * (p + 1) + n.y) * (p + 1) + n.z] = i;
+    }
+
+    m_power_parents.assign(m_coefficient_count, { 0, 0 });
+    for (uint32_t i = 1; i < m_coefficient_count; i++) {
+        auto const& n = m_multi_indices[i];
+        if (n.x > 0)
+            m_power_parents[i] = { coefficient_index(n.x - 1, n.y, n.z), 0 };
+        else if (n.y > 0)
+            m_power_parents[i] = { coefficient_index(n.x, n.y - 1, n.z), 1 };
+        else
+            m_power_parents[i] = { coefficient_index(n.x, n.y, n.z - 1), 2 };
+    }
+
+    // target = n, source = m <= n, other = n - m. Used as is by M2M, and
+    // with target and source swapped by L2L.
+    m_shift_terms.clear();
+    for (uint32_t n_index = 0; n_index < m_coefficient_count; n_index++) {
+        auto const& n = m_multi_indices[n_index];
+        for (unsigned x = 0; x <= n.x; x++) {
+            for (unsigned y = 0; y <= n.y; y++) {
+                for (unsigned z = 0; z <= n.z; z++) {
+                    m_shift_terms.push_back({
+                        .target = n_index,
+                        .source = coefficient_index(x, y, z),
+                        .other = coefficient_index(n.x - x, n.y - y, n.z - z),
+                        .coefficient = binomial(n.x, x) * binomial(n.y, y) * binomial(n.z, z),
+                    });
+                }
+            }
+        }
+    }
+
+    // target = n, source = k, other = n + k, |n + k| <= p.
+    m_translate_terms.clear();
+    m_translate_offsets.clear();
+    for (uint32_t n_index = 0; n_index < m_coefficient_count; n_index++) {
+        m_translate_offsets.push_back(static_cast<uint32_t>(m_translate_terms.size()));
+        auto const& n = m_multi_indices[n_index];
+        for (uint32_t k_index = 0; k_index < m_coefficient_count; k_index++) {
+            auto const& k = m_multi_indices[k_index];
+            if (n.degree() + k.degree() > p)
+                break;
+            double const sign = k.degree() % 2 == 0 ? 1 : -1;
+            m_translate_terms.push_back({
+                .target = n_index,
+                .source = k_index,
+                .other = coefficient_index(n.x + k.x, n.y + k.y, n.z + k.z),
+                .coefficient = sign * binomial(n.x + k.x, k.x) * binomial(n.y + k.y, k.y) * binomial(n.z + k.z, k.z),
+            });
+        }
+    }
+    m_translate_offsets.push_back(static_cast<uint32_t>(m_translate_terms.size()));
+
+    auto const zero_slot = static_cast<uint32_t>(m_coefficient_count);
+    m_taylor_parents.assign(m_coefficient_count, {});
+    for (uint32_t i = 1; i < m_coefficient_count; i++) {
+        auto const& n = m_multi_indices[i];
+        unsigned const axes[3] { n.x, n.y, n.z };
+        for (unsigned axis = 0; axis < 3; axis++) {
+            unsigned lower[3] { n.x, n.y, n.z };
+            if (axes[axis] >= 1) {
+                lower[axis]--;
+                m_taylor_parents[i][axis] = coefficient_index(lower[0], lower[1], lower[2]);
+            }
+            else {
+                m_taylor_parents[i][axis] = zero_slot;
+            }
+            if (axes[axis] >= 2) {
+                lower[axis]--;
+                m_taylor_parents[i][axis + 3] = coefficient_index(lower[0], lower[1], lower[2]);
+            }
+            else {
+                m_taylor_parents[i][axis + 3] = zero_slot;
+            }
+        }
+    }
+}
+
+void FastMultipole::compute_powers(double x, double y, double z, double* out) const {
+    double const d[3] { x, y, z };
+    out[0] = 1;
+    for (uint32_t i = 1; i < m_coefficient_count; i++) {
+        auto const [parent, axis] = m_power_parents[i];
+        out[i] = out[parent] * d[axis];
+    }
+}
+
+void FastMultipole::compute_taylor_coefficients(double x, double y, double z, double* out) const {
+    double const r_squared = x * x + y * y + z * z;
+    out[0] = 1 / std::sqrt(r_squared);
+    out[m_coefficient_count] = 0;
+
+    // |n| R^2 a_n = -(2|n| - 1) sum_i r_i a_(n - e_i) - (|n| - 1) sum_i a_(n - 2e_i)
+    double const inverse_r_squared = 1 / r_squared;
+    for (uint32_t i = 1; i < m_coefficient_count; i++) {
+        auto const& parents = m_taylor_parents[i];
+        double const degree = m_multi_indices[i].degree();
+        double const first = x * out[parents[0]] + y * out[parents[1]] + z * out[parents[2]];
+        double const second = out[parents[3]] + out[parents[4]] + out[parents[5]];
+        out[i] = -((2 * degree - 1) * first + (degree - 1) * second) * inverse_r_squared / degree;
+    }
+}
+
+void FastMultipole::compute(PhysicsState& state) {
+    run(state, 0, 1, [] { });
+}
+
+void FastMultipole::compute(PhysicsState& state, ThreadPool::Worker& worker) {
+    run(state, worker.index(), worker.count(), [&worker] { worker.sync(); });
+}
+
+// Every pass writes only to the cells (and objects) that a worker got, and
+// sums contributions to them in the same order for any number of workers.
+template<class Sync>
+void FastMultipole::run(PhysicsState& state, size_t worker_index, size_t worker_count, Sync const& sync) {
+    if (worker_index == 0)
+        prepare(state, worker_count);
+    sync();
+    if (m_tree.is_empty())
+        return;
+
+    auto& worker = m_workers[worker_index];
+    double* scratch = worker.scratch.data();
+    auto for_each_in_range = [&](size_t first, size_t last, auto callback) {
+        auto const size = last - first;
+        for (size_t i = first + size * worker_index / worker_count; i < first + size * (worker_index + 1) / worker_count; i++)
+            callback(i);
+    };
+
+    // Multipoles, from the deepest level up.
+    for (size_t l = level_count(); l-- > 0;) {
+        auto const [first, last] = level(l);
+        for_each_in_range(first, last, [&](size_t n) { upward(state, m_level_nodes[n], scratch); });
+        sync();
+    }
+
+    // Interaction lists, traversed from pairs of cells split between workers.
+    if (worker_index == 0)
+        expand_frontier();
+    sync();
+    worker.interactions.clear();
+    for_each_in_range(0, m_frontier.size(), [&](size_t p) { traverse(m_frontier[p], worker); });
+    sync();
+    if (worker_index == 0)
+        sort_interactions();
+    sync();
+
+    // Locals and near field, by target cell.
+    for_each_in_range(0, m_tree.nodes().size(), [&](size_t n) { apply_interactions(state, static_cast<uint32_t>(n), scratch); });
+    sync();
+
+    // Locals shifted from the root down, and evaluated at objects in leaves.
+    for (size_t l = 0; l < level_count(); l++) {
+        auto const [first, last] = level(l);
+        for_each_in_range(first, last, [&](size_t n) { downward(state, m_level_nodes[n], scratch); });
+        sync();
+    }
+}
+
+void FastMultipole::prepare(PhysicsState const& state, size_t worker_count) {
+    m_tree.build(state, LeafCapacity);
+    m_workers.resize(worker_count);
+    for (auto& worker : m_workers)
+        worker.scratch.resize((m_coefficient_count + 1) * 2);
+
+    auto const nodes = m_tree.nodes();
+    m_parents.assign(nodes.size(), 0);
+    m_depths.assign(nodes.size(), 0);
+    size_t depth_count = nodes.empty() ? 0 : 1;
+    // Parents always have smaller indices than their children.
+    for (uint32_t node_index = 0; node_index < nodes.size(); node_index++) {
+        auto const& node = nodes[node_index];
+        for (uint32_t c = node.first_child; c < node.first_child + node.child_count; c++) {
+            m_parents[c] = node_index;
+            m_depths[c] = m_depths[node_index] + 1;
+            depth_count = std::max<size_t>(depth_count, m_depths[c] + 1);
+        }
+    }
+
+    m_level_offsets.assign(depth_count + 1, 0);
+    for (auto const depth : m_depths)
+        m_level_offsets[depth + 1]++;
+    for (size_t d = 0; d < depth_count; d++)
+        m_level_offsets[d + 1] += m_level_offsets[d];
+    m_level_nodes.resize(nodes.size());
+    m_next.assign(m_level_offsets.begin(), m_level_offsets.end() - 1);
+    for (uint32_t node_index = 0; node_index < nodes.size(); node_index++)
+        m_level_nodes[m_next[m_depths[node_index]]++] = node_index;
+
+    m_radii.resize(nodes.size());
+    m_multipoles.resize(nodes.size() * m_coefficient_count);
+    m_locals.resize(nodes.size() * m_coefficient_count);
+}
+
+void FastMultipole::upward(PhysicsState const& state, uint32_t node_index, double* powers) {
+    auto const nodes = m_tree.nodes();
+    auto const order = m_tree.order();
+    auto const count = m_coefficient_count;
+    auto const& node = nodes[node_index];
+    double* multipole = &m_multipoles[node_index * count];
+    std::fill(multipole, multipole + count, 0);
+
+    if (node.is_leaf()) {
+        double radius_squared = 0;
+        for (uint32_t s = node.first_object; s < node.first_object + node.object_count; s++) {
+            auto const index = order[s];
+            double const dist_x = state.pos_x[index] - node.mass_x;
+            double const dist_y = state.pos_y[index] - node.mass_y;
+            double const dist_z = state.pos_z[index] - node.mass_z;
+            radius_squared = std::max(radius_squared, dist_x * dist_x + dist_y * dist_y + dist_z * dist_z);
+
+            double const gravity_factor = state.gravity_factor[index];
+            if (gravity_factor == 0)
+                continue;
+            compute_powers(dist_x, dist_y, dist_z, powers);
+            for (size_t i = 0; i < count; i++)
+                multipole[i] += gravity_factor * powers[i];
+        }
+        m_radii[node_index] = std::sqrt(radius_squared);
+        return;
+    }
+
+    double radius = 0;
+    for (uint32_t c = node.first_child; c < node.first_child + node.child_count; c++) {
+        auto const& child = nodes[c];
+        double const dist_x = child.mass_x - node.mass_x;
+        double const dist_y = child.mass_y - node.mass_y;
+        double const dist_z = child.mass_z - node.mass_z;
+        radius = std::max(radius, std::sqrt(dist_x * dist_x + dist_y * dist_y + dist_z * dist_z) + m_radii[c]);
+
+        if (child.gravity_factor == 0)
+            continue;
+        compute_powers(dist_x, dist_y, dist_z, powers);
+        double const* child_multipole = &m_multipoles[c * count];
+        for (auto const& term : m_shift_terms)
+            multipole[term.target] += term.coefficient * child_multipole[term.source] * powers[term.other];
+    }
+
+    // The cell itself is a (sometimes tighter) bound.
+    double const corner_x = std::abs(node.mass_x - node.center_x) + node.half_size;
+    double const corner_y = std::abs(node.mass_y - node.center_y) + node.half_size;
+    double const corner_z = std::abs(node.mass_z - node.center_z) + node.half_size;
+    m_radii[node_index] = std::min(radius, std::sqrt(corner_x * corner_x + corner_y * corner_y + corner_z * corner_z));
+}
+
+void FastMultipole::visit(std::pair<uint32_t, uint32_t> pair, std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+    std::vector<Interaction>& interactions) const {
+    auto const nodes = m_tree.nodes();
+    auto const [a_index, b_index] = pair;
+    auto const& a = nodes[a_index];
+    auto const& b = nodes[b_index];
+    if (a.gravity_factor == 0 && b.gravity_factor == 0)
+        return;
+
+    // Both directions, if the source has any mass.
+    auto interact = [&](bool direct) {
+        if (b.gravity_factor != 0)
+            interactions.push_back({ a_index, b_index, direct });
+        if (a.gravity_factor != 0)
+            interactions.push_back({ b_index, a_index, direct });
+    };
+
+    if (a_index == b_index) {
+        if (a.is_leaf()) {
+            interactions.push_back({ a_index, a_index, true });
+            return;
+        }
+        for (uint32_t c = a.first_child; c < a.first_child + a.child_count; c++) {
+            for (uint32_t d = c; d < a.first_child + a.child_count; d++)
+                pairs.emplace_back(c, d);
+        }
+        return;
+    }
+
+    double const dist_x = a.mass_x - b.mass_x;
+    double const dist_y = a.mass_y - b.mass_y;
+    double const dist_z = a.mass_z - b.mass_z;
+    double const radii = m_radii[a_index] + m_radii[b_index];
+    if (radii * radii < SeparationRatio * SeparationRatio * (dist_x * dist_x + dist_y * dist_y + dist_z * dist_z)) {
+        interact(false);
+        return;
+    }
+
+    if (a.is_leaf() && b.is_leaf()) {
+        interact(true);
+        return;
+    }
+
+    bool const split_a = b.is_leaf() || (!a.is_leaf() && m_radii[a_index] >= m_radii[b_index]);
+    if (split_a) {
+        for (uint32_t c = a.first_child; c < a.first_child + a.child_count; c++)
+            pairs.emplace_back(c, b_index);
+    }
+    else {
+        for (uint32_t c = b.first_child; c < b.first_child + b.child_count; c++)
+            pairs.emplace_back(a_index, c);
+    }
+}
+
+// Splits pairs level by level until there are enough of them to share
+// between workers. It doesn't depend on the number of workers, so neither
+// does the order of interactions.
+void FastMultipole::expand_frontier() {
+    m_frontier.clear();
+    m_frontier_interactions.clear();
+    m_frontier.emplace_back(0, 0);
+    while (!m_frontier.empty() && m_frontier.size() < FrontierPairs) {
+        m_next_frontier.clear();
+        for (auto const& pair : m_frontier)
+            visit(pair, m_next_frontier, m_frontier_interactions);
+        m_frontier.swap(m_next_frontier);
+    }
+}
+
+void FastMultipole::traverse(std::pair<uint32_t, uint32_t> pair, WorkerData& worker) const {
+    auto& stack = worker.pair_stack;
+    stack.clear();
+    stack.push_back(pair);
+    while (!stack.empty()) {
+        auto const next = stack.back();
+        stack.pop_back();
+        visit(next, stack, worker.interactions);
+    }
+}
+
+// Workers traversed contiguous ranges of the frontier in order, so taking
+// their lists in order gives the same interactions in the same order for any
+// number of workers. They are grouped by target with a stable counting sort.
+void FastMultipole::sort_interactions() {
+    auto const node_count = m_tree.nodes().size();
+    m_interaction_offsets.assign(node_count + 1, 0);
+    auto for_each_interaction = [&](auto callback) {
+        for (auto const& interaction : m_frontier_interactions)
+            callback(interaction);
+        for (auto const& worker : m_workers) {
+            for (auto const& interaction : worker.interactions)
+                callback(interaction);
+        }
+    };
+
+    for_each_interaction([&](Interaction const& interaction) { m_interaction_offsets[interaction.target + 1]++; });
+    for (size_t n = 0; n < node_count; n++)
+        m_interaction_offsets[n + 1] += m_interaction_offsets[n];
+    m_interactions.resize(m_interaction_offsets.back());
+    m_next.assign(m_interaction_offsets.begin(), m_interaction_offsets.end() - 1);
+    for_each_interaction([&](Interaction const& interaction) { m_interactions[m_next[interaction.target]++] = interaction; });
+}
+
+void FastMultipole::apply_interactions(PhysicsState& state, uint32_t target_index, double* taylor) {
+    auto const nodes = m_tree.nodes();
+    auto const& target = nodes[target_index];
+    double* local = &m_locals[target_index * m_coefficient_count];
+    std::fill(local, local + m_coefficient_count, 0);
+
+    for (size_t i = m_interaction_offsets[target_index]; i < m_interaction_offsets[target_index + 1]; i++) {
+        auto const& interaction = m_interactions[i];
+        auto const& source = nodes[interaction.source];
+        if (interaction.direct) {
+            particle_to_particle(state, target, source);
+            continue;
+        }
+        compute_taylor_coefficients(target.mass_x - source.mass_x, target.mass_y - source.mass_y, target.mass_z - source.mass_z, taylor);
+        translate(taylor, target_index, interaction.source);
+    }
+}
+
+void FastMultipole::translate(double const* taylor, uint32_t target_index, uint32_t source_index) {
+    double const* multipole = &m_multipoles[source_index * m_coefficient_count];
+    double* local = &m_locals[target_index * m_coefficient_count];
+    for (size_t n = 0; n < m_coefficient_count; n++) {
+        double sum = 0;
+        for (uint32_t t = m_translate_offsets[n]; t < m_translate_offsets[n + 1]; t++) {
+            auto const& term = m_translate_terms[t];
+            sum += term.coefficient * multipole[term.source] * taylor[term.other];
+        }
+        local[n] += sum;
+    }
+}
+
+void FastMultipole::particle_to_particle(PhysicsState& state, Octree::Node const& target, Octree::Node const& source) const {
+    auto const order = m_tree.order();
+    for (uint32_t t = target.first_object; t < target.first_object + target.object_count; t++) {
+        auto const index = order[t];
+        double const this_x = state.pos_x[index];
+        double const this_y = state.pos_y[index];
+        double const this_z = state.pos_z[index];
+        double acc_x = 0, acc_y = 0, acc_z = 0;
+
+        for (uint32_t s = source.first_object; s < source.first_object + source.object_count; s++) {
+            auto const other = order[s];
+            if (other == index)
+                continue;
+            double const other_gravity_factor = state.gravity_factor[other];
+            if (other_gravity_factor == 0)
+                continue;
+
+            double const dist_x = state.pos_x[other] - this_x;
+            double const dist_y = state.pos_y[other] - this_y;
+            double const dist_z = state.pos_z[other] - this_z;
+            double const distance_squared = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+            if (distance_squared == 0)
+                continue;
+            double const factor = other_gravity_factor / (distance_squared * std::sqrt(distance_squared));
+            acc_x += dist_x * factor;
+            acc_y += dist_y * factor;
+            acc_z += dist_z * factor;
+        }
+
+        state.acc_x[index] += acc_x;
+        state.acc_y[index] += acc_y;
+        state.acc_z[index] += acc_z;
+    }
+}
+
+void FastMultipole::downward(PhysicsState& state, uint32_t node_index, double* powers) {
+    auto const nodes = m_tree.nodes();
+    auto const count = m_coefficient_count;
+    auto const& node = nodes[node_index];
+
+    if (node_index != 0) {
+        auto const parent_index = m_parents[node_index];
+        auto const& parent = nodes[parent_index];
+        compute_powers(node.mass_x - parent.mass_x, node.mass_y - parent.mass_y, node.mass_z - parent.mass_z, powers);
+        double const* parent_local = &m_locals[parent_index * count];
+        double* local = &m_locals[node_index * count];
+        for (auto const& term : m_shift_terms)
+            local[term.source] += term.coefficient * parent_local[term.target] * powers[term.other];
+    }
+
+    if (node.is_leaf())
+        local_to_particle(state, node_index, powers);
+}
+
+void FastMultipole::local_to_particle(PhysicsState& state, uint32_t node_index, double* powers) const {
+    auto const& node = m_tree.nodes()[node_index];
+    auto const order = m_tree.order();
+    double const* local = &m_locals[node_index * m_coefficient_count];
+
+    for (uint32_t s = node.first_object; s < node.first_object + node.object_count; s++) {
+        auto const index = order[s];
+        compute_powers(state.pos_x[index] - node.mass_x, state.pos_y[index] - node.mass_y, state.pos_z[index] - node.mass_z, powers);
+
+        // Gradient of sum_n L_n h^n.
+        double acc_x = 0, acc_y = 0, acc_z = 0;
+        for (uint32_t i = 1; i < m_coefficient_count; i++) {
+            auto const& n = m_multi_indices[i];
+            if (n.x > 0)
+                acc_x += local[i] * n.x * powers[coefficient_index(n.x - 1, n.y, n.z)];
+            if (n.y > 0)
+                acc_y += local[i] * n.y * powers[coefficient_index(n.x, n.y - 1, n.z)];
+            if (n.z > 0)
+                acc_z += local[i] * n.z * powers[coefficient_index(n.x, n.y, n.z - 1)];
+        }
+        state.acc_x[index] += acc_x;
+        state.acc_y[index] += acc_y;
+        state.acc_z[index] += acc_z;
+    }
+}
+
+}
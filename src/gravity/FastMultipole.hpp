@@ -0,0 +1,162 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+#include "../ThreadPool.hpp"
+#include "Octree.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Gravity {
+
+// Fast multipole method with Cartesian Taylor expansions on an adaptive
+// octree. Every cell gets a multipole expansion of its objects, well separated
+// cell pairs interact through local expansions (dual tree traversal), and near
+// objects interact directly. A force pass is O(N), and the error decreases
+// geometrically with the expansion order, so that FMM is usable where the
+// Barnes-Hut error is not acceptable.
+//
+// Dehnen, "A Hierarchical O(N) Force Calculation Algorithm", J. Comput. Phys. 179 (2002)
+// Lindsay, Krasny, "A Particle Method and Adaptive Treecode for Vortex Sheet Motion
+// in Three-Dimensional Flow", J. Comput. Phys. 172 (2001) (Taylor coefficients recurrence)
+class FastMultipole {
+public:
+    static constexpr unsigned DefaultExpansionOrder = 4;
+    static constexpr unsigned MaxExpansionOrder = 12;
+
+    // Cells A and B interact through expansions if (r_A + r_B) < SeparationRatio * distance,
+    // where r is the radius of a cell around its center of mass. Accuracy is
+    // controlled with the expansion order.
+    static constexpr double SeparationRatio = 0.5;
+
+    FastMultipole();
+
+    // Expansion order p, in [1, MaxExpansionOrder]. Relative force error is
+    // roughly proportional to SeparationRatio^p.
+    void set_expansion_order(unsigned);
+    unsigned expansion_order() const { return m_order; }
+
+    // Adds the attraction to acc_* of all alive objects.
+    void compute(PhysicsState&);
+    // Splits every pass between workers. The results don't depend on the
+    // number of workers.
+    void compute(PhysicsState&, ThreadPool::Worker&);
+
+    size_t node_count() const { return m_tree.nodes().size(); }
+
+private:
+    static constexpr uint32_t LeafCapacity = 16;
+    // Cell pairs that the traversal is split into between workers.
+    static constexpr size_t FrontierPairs = 256;
+
+    // Multi-index n = (x, y, z) of an expansion coefficient, |n| = x + y + z <= p.
+    // Coefficients are ordered by |n|, so that n - e_i always precedes n.
+    struct MultiIndex {
+        uint8_t x {}, y {}, z {};
+        unsigned degree() const { return x + y + z; }
+    };
+
+    // c[target] += coefficient * a[source] * b[other]
+    struct Term {
+        uint32_t target {};
+        uint32_t source {};
+        uint32_t other {};
+        double coefficient {};
+    };
+
+    void build_tables();
+    uint32_t coefficient_index(unsigned x, unsigned y, unsigned z) const;
+
+    // d^n for all multi-indices n.
+    void compute_powers(double x, double y, double z, double* out) const;
+    // a_n = (1/n!) * D^n (1 / |r|) for all multi-indices n. out must have
+    // space for m_coefficient_count + 1 values.
+    void compute_taylor_coefficients(double x, double y, double z, double* out) const;
+
+    // Source cell whose multipole (or objects, if `direct`) contributes to
+    // the target cell.
+    struct Interaction {
+        uint32_t target {};
+        uint32_t source {};
+        bool direct {};
+    };
+
+    // Per worker, so that workers don't write to shared buffers.
+    struct WorkerData {
+        std::vector<double> scratch;
+        std::vector<std::pair<uint32_t, uint32_t>> pair_stack;
+        std::vector<Interaction> interactions;
+    };
+
+    // Runs all passes. Every worker calls it with `sync` waiting for the
+    // others.
+    template<class Sync>
+    void run(PhysicsState&, size_t worker_index, size_t worker_count, Sync const& sync);
+
+    void prepare(PhysicsState const&, size_t worker_count);
+    size_t level_count() const { return m_level_offsets.size() - 1; }
+    std::pair<size_t, size_t> level(size_t index) const { return { m_level_offsets[index], m_level_offsets[index + 1] }; }
+
+    void upward(PhysicsState const&, uint32_t node_index, double* scratch);
+    // Decides whether the cells of a pair interact or are split into more
+    // pairs. Every unordered pair of cells is visited once.
+    void visit(std::pair<uint32_t, uint32_t>, std::vector<std::pair<uint32_t, uint32_t>>& pairs, std::vector<Interaction>&) const;
+    void expand_frontier();
+    void traverse(std::pair<uint32_t, uint32_t>, WorkerData&) const;
+    void sort_interactions();
+    void apply_interactions(PhysicsState&, uint32_t target_index, double* scratch);
+    void downward(PhysicsState&, uint32_t node_index, double* scratch);
+
+    void translate(double const* taylor, uint32_t target, uint32_t source);
+    void particle_to_particle(PhysicsState&, Octree::Node const& target, Octree::Node const& source) const;
+    void local_to_particle(PhysicsState&, uint32_t node_index, double* scratch) const;
+
+    unsigned m_order {};
+    size_t m_coefficient_count {};
+    std::vector<MultiIndex> m_multi_indices;
+    std::vector<uint32_t> m_index_lookup;
+
+    std::vector<Term> m_shift_terms; // M2M and L2L: binom(n, m) * d^(n - m)
+
+    // M2L: (-1)^|k| * binom(n + k, k) * a_(n + k), grouped by target n:
+    // terms of n are m_translate_terms[m_translate_offsets[n], m_translate_offsets[n + 1]).
+    std::vector<Term> m_translate_terms;
+    std::vector<uint32_t> m_translate_offsets;
+
+    // Parent index (n - e_i) and axis i used to compute d^n from d^(n - e_i).
+    std::vector<std::pair<uint32_t, uint8_t>> m_power_parents;
+
+    // Indices of a_(n - e_i) and a_(n - 2e_i) for i = x, y, z used by the
+    // Taylor coefficients recurrence. Missing ones point to a zero slot at
+    // index m_coefficient_count.
+    std::vector<std::array<uint32_t, 6>> m_taylor_parents;
+
+    Octree m_tree;
+    std::vector<uint32_t> m_parents;
+    std::vector<uint32_t> m_depths;
+    // Nodes of depth d are m_level_nodes[m_level_offsets[d], m_level_offsets[d + 1]).
+    std::vector<uint32_t> m_level_nodes;
+    std::vector<size_t> m_level_offsets;
+    std::vector<double> m_radii;
+    std::vector<double> m_multipoles;
+    std::vector<double> m_locals;
+
+    // Pairs that workers traverse, and the interactions that were found
+    // while collecting them.
+    std::vector<std::pair<uint32_t, uint32_t>> m_frontier;
+    std::vector<std::pair<uint32_t, uint32_t>> m_next_frontier;
+    std::vector<Interaction> m_frontier_interactions;
+    // Interactions of node n are m_interactions[m_interaction_offsets[n], m_interaction_offsets[n + 1]),
+    // in the order the traversal found them.
+    std::vector<Interaction> m_interactions;
+    std::vector<size_t> m_interaction_offsets;
+    // Insertion positions of the counting sorts.
+    std::vector<size_t> m_next;
+
+    std::vector<WorkerData> m_workers;
+};
+
+}
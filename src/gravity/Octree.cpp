@@ -0,0 +1,149 @@
+#include "Octree.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace Gravity {
+
+bool Octree::Node::contains(double x, double y, double z) const {
+    return std::abs(x - center_x) <= half_size
+        && std::abs(y - center_y) <= half_size
+        && std::abs(z - center_z) <= half_size;
+}
+
+void Octree::build(PhysicsState const& state, uint32_t leaf_capacity) {
+    m_leaf_capacity = leaf_capacity;
+    m_nodes.clear();
+    m_order.clear();
+
+    double min_x = std::numeric_limits<double>::max(), max_x = std::numeric_limits<double>::lowest();
+    double min_y = min_x, max_y = max_x;
+    double min_z = min_x, max_z = max_x;
+    for (auto const s : state.active) {
+        m_order.push_back(static_cast<uint32_t>(s));
+        min_x = std::min(min_x, state.pos_x[s]);
+        max_x = std::max(max_x, state.pos_x[s]);
+        min_y = std::min(min_y, state.pos_y[s]);
+        max_y = std::max(max_y, state.pos_y[s]);
+        min_z = std::min(min_z, state.pos_z[s]);
+        max_z = std::max(max_z, state.pos_z[s]);
+    }
+
+    if (m_order.empty())
+        return;
+
+    m_scratch.resize(m_order.size());
+    // A rough upper bound, avoids most reallocations during the build.
+    m_nodes.reserve(m_order.size() / std::max<uint32_t>(m_leaf_capacity, 1) * 3 + 1);
+
+    auto& root = m_nodes.emplace_back();
+    root.center_x = (min_x + max_x) / 2;
+    root.center_y = (min_y + max_y) / 2;
+    root.center_z = (min_z + max_z) / 2;
+    // Make sure that objects on the boundary are inside the root cell.
+    root.half_size = std::max({ max_x - min_x, max_y - min_y, max_z - min_z }) / 2 * (1 + 1e-9) + std::numeric_limits<double>::min();
+    root.first_object = 0;
+    root.object_count = static_cast<uint32_t>(m_order.size());
+    build_node(state, 0, 0);
+}
+
+void Octree::build_node(PhysicsState const& state, uint32_t node_index, unsigned depth) {
+    // NOTE: m_nodes may reallocate during recursion, so don't keep references
+    //       to nodes across build_node() calls.
+    auto const node = m_nodes[node_index];
+    auto const first = node.first_object;
+    auto const count = node.object_count;
+
+    if (count <= m_leaf_capacity || depth >= MaxDepth) {
+        double mass_x = 0, mass_y = 0, mass_z = 0, gravity_factor = 0;
+        for (uint32_t s = first; s < first + count; s++) {
+            auto index = m_order[s];
+            double gf = state.gravity_factor[index];
+            mass_x += state.pos_x[index] * gf;
+            mass_y += state.pos_y[index] * gf;
+            mass_z += state.pos_z[index] * gf;
+            gravity_factor += gf;
+        }
+        auto& leaf = m_nodes[node_index];
+        leaf.gravity_factor = gravity_factor;
+        if (gravity_factor != 0) {
+            leaf.mass_x = mass_x / gravity_factor;
+            leaf.mass_y = mass_y / gravity_factor;
+            leaf.mass_z = mass_z / gravity_factor;
+        }
+        else {
+            leaf.mass_x = node.center_x;
+            leaf.mass_y = node.center_y;
+            leaf.mass_z = node.center_z;
+        }
+        return;
+    }
+
+    // Sort objects into octants (counting sort on 3-bit octant index).
+    auto octant_of = [&](uint32_t index) {
+        return (state.pos_x[index] >= node.center_x ? 1 : 0)
+            | (state.pos_y[index] >= node.center_y ? 2 : 0)
+            | (state.pos_z[index] >= node.center_z ? 4 : 0);
+    };
+
+    std::array<uint32_t, 8> octant_counts {};
+    for (uint32_t s = first; s < first + count; s++)
+        octant_counts[octant_of(m_order[s])]++;
+
+    std::array<uint32_t, 8> octant_offsets {};
+    for (unsigned o = 1; o < 8; o++)
+        octant_offsets[o] = octant_offsets[o - 1] + octant_counts[o - 1];
+
+    auto insert_offsets = octant_offsets;
+    for (uint32_t s = first; s < first + count; s++) {
+        auto index = m_order[s];
+        m_scratch[first + insert_offsets[octant_of(index)]++] = index;
+    }
+    std::copy(m_scratch.begin() + first, m_scratch.begin() + first + count, m_order.begin() + first);
+
+    auto first_child = static_cast<uint32_t>(m_nodes.size());
+    uint32_t child_count = 0;
+    double const child_half_size = node.half_size / 2;
+    for (unsigned o = 0; o < 8; o++) {
+        if (octant_counts[o] == 0)
+            continue;
+        Node child;
+        child.center_x = node.center_x + ((o & 1) ? child_half_size : -child_half_size);
+        child.center_y = node.center_y + ((o & 2) ? child_half_size : -child_half_size);
+        child.center_z = node.center_z + ((o & 4) ? child_half_size : -child_half_size);
+        child.half_size = child_half_size;
+        child.first_object = first + octant_offsets[o];
+        child.object_count = octant_counts[o];
+        m_nodes.push_back(child);
+        child_count++;
+    }
+    m_nodes[node_index].first_child = first_child;
+    m_nodes[node_index].child_count = child_count;
+
+    double mass_x = 0, mass_y = 0, mass_z = 0, gravity_factor = 0;
+    for (uint32_t c = first_child; c < first_child + child_count; c++) {
+        build_node(state, c, depth + 1);
+        auto const& child = m_nodes[c];
+        mass_x += child.mass_x * child.gravity_factor;
+        mass_y += child.mass_y * child.gravity_factor;
+        mass_z += child.mass_z * child.gravity_factor;
+        gravity_factor += child.gravity_factor;
+    }
+
+    auto& result = m_nodes[node_index];
+    result.gravity_factor = gravity_factor;
+    if (gravity_factor != 0) {
+        result.mass_x = mass_x / gravity_factor;
+        result.mass_y = mass_y / gravity_factor;
+        result.mass_z = mass_z / gravity_factor;
+    }
+    else {
+        result.mass_x = node.center_x;
+        result.mass_y = node.center_y;
+        result.mass_z = node.center_z;
+    }
+}
+
+}
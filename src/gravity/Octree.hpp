@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Gravity {
+
+// Octree over alive objects of a PhysicsState, shared by tree-based solvers.
+// Nodes and objects are stored in flat arrays; children of a node and objects
+// inside a node are contiguous.
+class Octree {
+public:
+    struct Node {
+        // Geometric center and half of the edge of the cube.
+        double center_x {}, center_y {}, center_z {};
+        double half_size {};
+
+        // Center of mass and total gravity factor of objects inside. If the
+        // total gravity factor is 0, center of mass is the geometric center.
+        double mass_x {}, mass_y {}, mass_z {};
+        double gravity_factor {};
+
+        // Objects inside are order()[first_object, first_object + object_count).
+        uint32_t first_object {};
+        uint32_t object_count {};
+
+        // Children are nodes()[first_child, first_child + child_count). Leaves have no children.
+        uint32_t first_child {};
+        uint32_t child_count {};
+
+        bool is_leaf() const { return child_count == 0; }
+        bool contains(double x, double y, double z) const;
+    };
+
+    static constexpr unsigned MaxDepth = 48;
+
+    // Nodes with at most leaf_capacity objects are not subdivided.
+    void build(PhysicsState const&, uint32_t leaf_capacity);
+
+    bool is_empty() const { return m_nodes.empty(); }
+    std::span<Node const> nodes() const { return m_nodes; }
+    Node const& root() const { return m_nodes[0]; }
+
+    // Indices of objects in PhysicsState, ordered so that objects in a node are contiguous.
+    std::span<uint32_t const> order() const { return m_order; }
+
+private:
+    void build_node(PhysicsState const&, uint32_t node_index, unsigned depth);
+
+    uint32_t m_leaf_capacity {};
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_scratch;
+};
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+namespace Gravity {
+
+// Method used by World::set_forces() to calculate accelerations.
+enum class Solver {
+    // Exact O(N^2) pair loop.
+    Direct,
+
+    // Exact O(N^2) pair loop that computes every pair once, in tiles of
+    // pairs spread over threads, see TiledDirect.hpp. Does half the
+    // arithmetic of Direct. Results don't depend on thread count, but may
+    // differ from Direct in the last bits.
+    DirectSymmetric,
+
+    // Octree approximation, see BarnesHut.hpp.
+    BarnesHut,
+
+    // Fast multipole method, see FastMultipole.hpp.
+    FastMultipole,
+};
+
+inline std::optional<Solver> solver_from_string(std::string_view name) {
+    if (name == "direct")
+        return Solver::Direct;
+    if (name == "direct_symmetric")
+        return Solver::DirectSymmetric;
+    if (name == "barnes_hut")
+        return Solver::BarnesHut;
+    if (name == "fmm")
+        return Solver::FastMultipole;
+    return {};
+}
+
+inline char const* solver_to_string(Solver solver) {
+    switch (solver) {
+    case Solver::Direct:
+        return "direct";
+    case Solver::DirectSymmetric:
+        return "direct_symmetric";
+    case Solver::BarnesHut:
+        return "barnes_hut";
+    case Solver::FastMultipole:
+        return "fmm";
+    }
+    return "";
+}
+
+}
@@ -0,0 +1,179 @@
+#include "TestParticleSummation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#    define ESSA_DIRECT_X86 1
+#    include <immintrin.h>
+#endif
+
+namespace Gravity {
+
+namespace {
+
+struct Sources {
+    double const* x;
+    double const* y;
+    double const* z;
+    double const* gravity_factor;
+    size_t count;
+};
+
+void compute_scalar(Sources const& sources, TestParticles& particles, size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        double const this_x = particles.pos_x[i];
+        double const this_y = particles.pos_y[i];
+        double const this_z = particles.pos_z[i];
+        double acc_x = 0;
+        double acc_y = 0;
+        double acc_z = 0;
+        for (size_t j = 0; j < sources.count; j++) {
+            double const dist_x = sources.x[j] - this_x;
+            double const dist_y = sources.y[j] - this_y;
+            double const dist_z = sources.z[j] - this_z;
+            double const distance_squared = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+            if (distance_squared == 0)
+                continue;
+            double const factor = sources.gravity_factor[j] / (distance_squared * std::sqrt(distance_squared));
+            acc_x += dist_x * factor;
+            acc_y += dist_y * factor;
+            acc_z += dist_z * factor;
+        }
+        particles.acc_x[i] = acc_x;
+        particles.acc_y[i] = acc_y;
+        particles.acc_z[i] = acc_z;
+    }
+}
+
+#ifdef ESSA_DIRECT_X86
+
+// The last group of particles is loaded and stored with a mask instead of
+// being left to a scalar loop, so that every particle goes through the same
+// arithmetic however the particles are split.
+
+__attribute__((target("avx2,fma"))) void compute_avx2(Sources const& sources, TestParticles& particles, size_t first, size_t last) {
+    __m256d const zero = _mm256_setzero_pd();
+    __m256d const one = _mm256_set1_pd(1);
+    __m256i const lane_index = _mm256_setr_epi64x(0, 1, 2, 3);
+
+    for (size_t i = first; i < last; i += 4) {
+        auto const lane_count = static_cast<long long>(std::min<size_t>(last - i, 4));
+        __m256i const mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(lane_count), lane_index);
+        __m256d const this_x = _mm256_maskload_pd(&particles.pos_x[i], mask);
+        __m256d const this_y = _mm256_maskload_pd(&particles.pos_y[i], mask);
+        __m256d const this_z = _mm256_maskload_pd(&particles.pos_z[i], mask);
+        __m256d acc_x = zero, acc_y = zero, acc_z = zero;
+
+        for (size_t j = 0; j < sources.count; j++) {
+            __m256d const dist_x = _mm256_sub_pd(_mm256_set1_pd(sources.x[j]), this_x);
+            __m256d const dist_y = _mm256_sub_pd(_mm256_set1_pd(sources.y[j]), this_y);
+            __m256d const dist_z = _mm256_sub_pd(_mm256_set1_pd(sources.z[j]), this_z);
+
+            __m256d const distance_squared = _mm256_fmadd_pd(dist_x, dist_x, _mm256_fmadd_pd(dist_y, dist_y, _mm256_mul_pd(dist_z, dist_z)));
+            __m256d const interacts = _mm256_cmp_pd(distance_squared, zero, _CMP_GT_OQ);
+            __m256d const inverse_distance_cubed = _mm256_div_pd(one, _mm256_mul_pd(distance_squared, _mm256_sqrt_pd(distance_squared)));
+            __m256d const factor = _mm256_and_pd(interacts, _mm256_mul_pd(_mm256_set1_pd(sources.gravity_factor[j]), inverse_distance_cubed));
+            acc_x = _mm256_fmadd_pd(dist_x, factor, acc_x);
+            acc_y = _mm256_fmadd_pd(dist_y, factor, acc_y);
+            acc_z = _mm256_fmadd_pd(dist_z, factor, acc_z);
+        }
+
+        _mm256_maskstore_pd(&particles.acc_x[i], mask, acc_x);
+        _mm256_maskstore_pd(&particles.acc_y[i], mask, acc_y);
+        _mm256_maskstore_pd(&particles.acc_z[i], mask, acc_z);
+    }
+}
+
+__attribute__((target("avx512f"))) void compute_avx512(Sources const& sources, TestParticles& particles, size_t first, size_t last) {
+    __m512d const zero = _mm512_setzero_pd();
+
+    for (size_t i = first; i < last; i += 8) {
+        auto const lane_count = std::min<size_t>(last - i, 8);
+        auto const mask = static_cast<__mmask8>((1u << lane_count) - 1);
+        __m512d const this_x = _mm512_maskz_loadu_pd(mask, &particles.pos_x[i]);
+        __m512d const this_y = _mm512_maskz_loadu_pd(mask, &particles.pos_y[i]);
+        __m512d const this_z = _mm512_maskz_loadu_pd(mask, &particles.pos_z[i]);
+        __m512d acc_x = zero, acc_y = zero, acc_z = zero;
+
+        for (size_t j = 0; j < sources.count; j++) {
+            __m512d const dist_x = _mm512_sub_pd(_mm512_set1_pd(sources.x[j]), this_x);
+            __m512d const dist_y = _mm512_sub_pd(_mm512_set1_pd(sources.y[j]), this_y);
+            __m512d const dist_z = _mm512_sub_pd(_mm512_set1_pd(sources.z[j]), this_z);
+
+            __m512d const distance_squared = _mm512_fmadd_pd(dist_x, dist_x, _mm512_fmadd_pd(dist_y, dist_y, _mm512_mul_pd(dist_z, dist_z)));
+            __mmask8 const interacts = _mm512_cmp_pd_mask(distance_squared, zero, _CMP_GT_OQ);
+            // 1/r refined from a 14-bit approximation, like in the direct
+            // summation kernel.
+            __m512d inverse_distance = _mm512_maskz_rsqrt14_pd(interacts, distance_squared);
+            __m512d const half_distance_squared = _mm512_mul_pd(distance_squared, _mm512_set1_pd(0.5));
+            inverse_distance = _mm512_mul_pd(inverse_distance, _mm512_fnmadd_pd(half_distance_squared, _mm512_mul_pd(inverse_distance, inverse_distance), _mm512_set1_pd(1.5)));
+            inverse_distance = _mm512_mul_pd(inverse_distance, _mm512_fnmadd_pd(half_distance_squared, _mm512_mul_pd(inverse_distance, inverse_distance), _mm512_set1_pd(1.5)));
+            __m512d const inverse_distance_cubed = _mm512_mul_pd(inverse_distance, _mm512_mul_pd(inverse_distance, inverse_distance));
+            __m512d const factor = _mm512_mul_pd(_mm512_set1_pd(sources.gravity_factor[j]), inverse_distance_cubed);
+            acc_x = _mm512_fmadd_pd(dist_x, factor, acc_x);
+            acc_y = _mm512_fmadd_pd(dist_y, factor, acc_y);
+            acc_z = _mm512_fmadd_pd(dist_z, factor, acc_z);
+        }
+
+        _mm512_mask_storeu_pd(&particles.acc_x[i], mask, acc_x);
+        _mm512_mask_storeu_pd(&particles.acc_y[i], mask, acc_y);
+        _mm512_mask_storeu_pd(&particles.acc_z[i], mask, acc_z);
+    }
+}
+
+#endif
+
+}
+
+void TestParticleSummation::prepare(PhysicsState const& state) {
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_gravity_factor.clear();
+    for (auto const s : state.active) {
+        if (state.gravity_factor[s] == 0)
+            continue;
+        m_x.push_back(state.pos_x[s]);
+        m_y.push_back(state.pos_y[s]);
+        m_z.push_back(state.pos_z[s]);
+        m_gravity_factor.push_back(state.gravity_factor[s]);
+    }
+}
+
+bool TestParticleSummation::is_prepared_for(PhysicsState const& state) const {
+    size_t packed = 0;
+    for (auto const s : state.active) {
+        if (state.gravity_factor[s] == 0)
+            continue;
+        if (packed == m_x.size() || m_x[packed] != state.pos_x[s] || m_y[packed] != state.pos_y[s] || m_z[packed] != state.pos_z[s]
+            || m_gravity_factor[packed] != state.gravity_factor[s])
+            return false;
+        packed++;
+    }
+    return packed == m_x.size();
+}
+
+void TestParticleSummation::compute(TestParticles& particles, size_t first, size_t last) const {
+    Sources const sources { m_x.data(), m_y.data(), m_z.data(), m_gravity_factor.data(), m_x.size() };
+    switch (m_kernel) {
+    case DirectKernel::Scalar:
+        compute_scalar(sources, particles, first, last);
+        return;
+#ifdef ESSA_DIRECT_X86
+    case DirectKernel::AVX2:
+        compute_avx2(sources, particles, first, last);
+        return;
+    case DirectKernel::AVX512:
+        compute_avx512(sources, particles, first, last);
+        return;
+#else
+    case DirectKernel::AVX2:
+    case DirectKernel::AVX512:
+        break;
+#endif
+    }
+    compute_scalar(sources, particles, first, last);
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+#include "../TestParticles.hpp"
+#include "Direct.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace Gravity {
+
+// Attraction of test particles by objects: every particle sums over all
+// alive objects with a non-zero gravity factor, O(objects * particles).
+// Objects are few (planets, moons) and particles many, so the vector kernels
+// process 4 (AVX2) or 8 (AVX-512) particles at a time.
+//
+// Usage: prepare() on one thread, then compute() for every part of
+// [0, particle count). Results don't depend on how particles are split.
+class TestParticleSummation {
+public:
+    // Unsupported kernels fall back to Scalar.
+    explicit TestParticleSummation(DirectKernel kernel = best_direct_kernel())
+        : m_kernel(is_supported(kernel) ? kernel : DirectKernel::Scalar) { }
+
+    DirectKernel kernel() const { return m_kernel; }
+
+    // Packs attracting objects of the state.
+    void prepare(PhysicsState const&);
+
+    // Whether prepare() would pack the same objects at the same positions,
+    // that is, whether forces computed since then are still valid.
+    bool is_prepared_for(PhysicsState const&) const;
+
+    // Sets acc_* of particles with indices in [first, last). Particles that
+    // coincide with an object are not attracted by it.
+    void compute(TestParticles&, size_t first, size_t last) const;
+
+private:
+    DirectKernel m_kernel;
+    std::vector<double> m_x, m_y, m_z, m_gravity_factor;
+};
+
+}
@@ -0,0 +1,266 @@
+#include "TiledDirect.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#    define ESSA_DIRECT_X86 1
+#    include <immintrin.h>
+#endif
+
+namespace Gravity {
+
+namespace {
+
+using Sums = TiledDirectSummation::Sums;
+using PackedObjects = DirectSummation::PackedObjects;
+
+void merge_row(Sums& sums, size_t i, double acc_x, double acc_y, double acc_z) {
+    sums.acc_x[i] += acc_x;
+    sums.acc_y[i] += acc_y;
+    sums.acc_z[i] += acc_z;
+}
+
+// Tiles are [row_begin, row_end) x [column_begin, column_end) with
+// row_begin <= column_begin; only pairs with i < j are visited. Padding
+// objects are massless, so they don't affect real objects.
+void process_tile_scalar(PackedObjects const& objects, Sums& sums, size_t row_begin, size_t row_end, size_t column_begin, size_t column_end) {
+    for (size_t i = row_begin; i < row_end; i++) {
+        double const this_x = objects.x[i];
+        double const this_y = objects.y[i];
+        double const this_z = objects.z[i];
+        double const this_gravity_factor = objects.gravity_factor[i];
+        double acc_x = 0, acc_y = 0, acc_z = 0;
+
+        for (size_t j = std::max(column_begin, i + 1); j < column_end; j++) {
+            double const dist_x = objects.x[j] - this_x;
+            double const dist_y = objects.y[j] - this_y;
+            double const dist_z = objects.z[j] - this_z;
+
+            double const distance_squared = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+            if (distance_squared == 0)
+                continue;
+            double const inverse_distance_cubed = 1 / (distance_squared * std::sqrt(distance_squared));
+            double const other_gravity_factor = objects.gravity_factor[j];
+
+            double const this_factor = other_gravity_factor * inverse_distance_cubed;
+            acc_x += dist_x * this_factor;
+            acc_y += dist_y * this_factor;
+            acc_z += dist_z * this_factor;
+
+            double const other_factor = this_gravity_factor * inverse_distance_cubed;
+            sums.acc_x[j] -= dist_x * other_factor;
+            sums.acc_y[j] -= dist_y * other_factor;
+            sums.acc_z[j] -= dist_z * other_factor;
+        }
+
+        merge_row(sums, i, acc_x, acc_y, acc_z);
+    }
+}
+
+#ifdef ESSA_DIRECT_X86
+
+__attribute__((target("avx2,fma"))) void process_tile_avx2(PackedObjects const& objects, Sums& sums, size_t row_begin, size_t row_end, size_t column_begin, size_t column_end) {
+    for (size_t i = row_begin; i < row_end; i++) {
+        __m256d const this_x = _mm256_set1_pd(objects.x[i]);
+        __m256d const this_y = _mm256_set1_pd(objects.y[i]);
+        __m256d const this_z = _mm256_set1_pd(objects.z[i]);
+        __m256d const this_gravity_factor = _mm256_set1_pd(objects.gravity_factor[i]);
+        __m256d const this_index = _mm256_set1_pd(static_cast<double>(i));
+        __m256d const zero = _mm256_setzero_pd();
+
+        __m256d acc_x = zero, acc_y = zero, acc_z = zero;
+
+        size_t const first = std::max(column_begin, (i + 1) / 4 * 4);
+        __m256d other_index = _mm256_add_pd(_mm256_set1_pd(static_cast<double>(first)), _mm256_setr_pd(0, 1, 2, 3));
+        __m256d const index_step = _mm256_set1_pd(4);
+
+        for (size_t j = first; j < column_end; j += 4) {
+            __m256d const dist_x = _mm256_sub_pd(_mm256_loadu_pd(&objects.x[j]), this_x);
+            __m256d const dist_y = _mm256_sub_pd(_mm256_loadu_pd(&objects.y[j]), this_y);
+            __m256d const dist_z = _mm256_sub_pd(_mm256_loadu_pd(&objects.z[j]), this_z);
+            __m256d const other_gravity_factor = _mm256_loadu_pd(&objects.gravity_factor[j]);
+
+            __m256d const distance_squared = _mm256_fmadd_pd(dist_x, dist_x, _mm256_fmadd_pd(dist_y, dist_y, _mm256_mul_pd(dist_z, dist_z)));
+            // Masks out pairs visited elsewhere (j <= i) and coincident objects.
+            __m256d const interacts = _mm256_and_pd(_mm256_cmp_pd(other_index, this_index, _CMP_GT_OQ), _mm256_cmp_pd(distance_squared, zero, _CMP_GT_OQ));
+            __m256d const inverse_distance_cubed = _mm256_and_pd(interacts,
+                _mm256_div_pd(_mm256_set1_pd(1), _mm256_mul_pd(distance_squared, _mm256_sqrt_pd(distance_squared))));
+
+            __m256d const this_factor = _mm256_mul_pd(other_gravity_factor, inverse_distance_cubed);
+            acc_x = _mm256_fmadd_pd(dist_x, this_factor, acc_x);
+            acc_y = _mm256_fmadd_pd(dist_y, this_factor, acc_y);
+            acc_z = _mm256_fmadd_pd(dist_z, this_factor, acc_z);
+
+            __m256d const other_factor = _mm256_mul_pd(this_gravity_factor, inverse_distance_cubed);
+            _mm256_storeu_pd(&sums.acc_x[j], _mm256_fnmadd_pd(dist_x, other_factor, _mm256_loadu_pd(&sums.acc_x[j])));
+            _mm256_storeu_pd(&sums.acc_y[j], _mm256_fnmadd_pd(dist_y, other_factor, _mm256_loadu_pd(&sums.acc_y[j])));
+            _mm256_storeu_pd(&sums.acc_z[j], _mm256_fnmadd_pd(dist_z, other_factor, _mm256_loadu_pd(&sums.acc_z[j])));
+
+            other_index = _mm256_add_pd(other_index, index_step);
+        }
+
+        alignas(32) double lane_acc_x[4], lane_acc_y[4], lane_acc_z[4];
+        _mm256_store_pd(lane_acc_x, acc_x);
+        _mm256_store_pd(lane_acc_y, acc_y);
+        _mm256_store_pd(lane_acc_z, acc_z);
+        merge_row(sums, i,
+            (lane_acc_x[0] + lane_acc_x[1]) + (lane_acc_x[2] + lane_acc_x[3]),
+            (lane_acc_y[0] + lane_acc_y[1]) + (lane_acc_y[2] + lane_acc_y[3]),
+            (lane_acc_z[0] + lane_acc_z[1]) + (lane_acc_z[2] + lane_acc_z[3]));
+    }
+}
+
+__attribute__((target("avx512f"))) void process_tile_avx512(PackedObjects const& objects, Sums& sums, size_t row_begin, size_t row_end, size_t column_begin, size_t column_end) {
+    for (size_t i = row_begin; i < row_end; i++) {
+        __m512d const this_x = _mm512_set1_pd(objects.x[i]);
+        __m512d const this_y = _mm512_set1_pd(objects.y[i]);
+        __m512d const this_z = _mm512_set1_pd(objects.z[i]);
+        __m512d const this_gravity_factor = _mm512_set1_pd(objects.gravity_factor[i]);
+        __m512d const this_index = _mm512_set1_pd(static_cast<double>(i));
+        __m512d const zero = _mm512_setzero_pd();
+
+        __m512d acc_x = zero, acc_y = zero, acc_z = zero;
+
+        size_t const first = std::max(column_begin, (i + 1) / 8 * 8);
+        __m512d other_index = _mm512_add_pd(_mm512_set1_pd(static_cast<double>(first)), _mm512_setr_pd(0, 1, 2, 3, 4, 5, 6, 7));
+        __m512d const index_step = _mm512_set1_pd(8);
+
+        for (size_t j = first; j < column_end; j += 8) {
+            __m512d const dist_x = _mm512_sub_pd(_mm512_loadu_pd(&objects.x[j]), this_x);
+            __m512d const dist_y = _mm512_sub_pd(_mm512_loadu_pd(&objects.y[j]), this_y);
+            __m512d const dist_z = _mm512_sub_pd(_mm512_loadu_pd(&objects.z[j]), this_z);
+            __m512d const other_gravity_factor = _mm512_loadu_pd(&objects.gravity_factor[j]);
+
+            __m512d const distance_squared = _mm512_fmadd_pd(dist_x, dist_x, _mm512_fmadd_pd(dist_y, dist_y, _mm512_mul_pd(dist_z, dist_z)));
+            // Masks out pairs visited elsewhere (j <= i) and coincident objects.
+            __mmask8 const interacts = _mm512_mask_cmp_pd_mask(_mm512_cmp_pd_mask(other_index, this_index, _CMP_GT_OQ), distance_squared, zero, _CMP_GT_OQ);
+            // 1/r refined with two Newton-Raphson steps, see Direct.cpp.
+            __m512d inverse_distance = _mm512_maskz_rsqrt14_pd(interacts, distance_squared);
+            __m512d const half_distance_squared = _mm512_mul_pd(distance_squared, _mm512_set1_pd(0.5));
+            inverse_distance = _mm512_mul_pd(inverse_distance, _mm512_fnmadd_pd(half_distance_squared, _mm512_mul_pd(inverse_distance, inverse_distance), _mm512_set1_pd(1.5)));
+            inverse_distance = _mm512_mul_pd(inverse_distance, _mm512_fnmadd_pd(half_distance_squared, _mm512_mul_pd(inverse_distance, inverse_distance), _mm512_set1_pd(1.5)));
+            __m512d const inverse_distance_cubed = _mm512_mul_pd(inverse_distance, _mm512_mul_pd(inverse_distance, inverse_distance));
+
+            __m512d const this_factor = _mm512_mul_pd(other_gravity_factor, inverse_distance_cubed);
+            acc_x = _mm512_fmadd_pd(dist_x, this_factor, acc_x);
+            acc_y = _mm512_fmadd_pd(dist_y, this_factor, acc_y);
+            acc_z = _mm512_fmadd_pd(dist_z, this_factor, acc_z);
+
+            __m512d const other_factor = _mm512_mul_pd(this_gravity_factor, inverse_distance_cubed);
+            _mm512_storeu_pd(&sums.acc_x[j], _mm512_fnmadd_pd(dist_x, other_factor, _mm512_loadu_pd(&sums.acc_x[j])));
+            _mm512_storeu_pd(&sums.acc_y[j], _mm512_fnmadd_pd(dist_y, other_factor, _mm512_loadu_pd(&sums.acc_y[j])));
+            _mm512_storeu_pd(&sums.acc_z[j], _mm512_fnmadd_pd(dist_z, other_factor, _mm512_loadu_pd(&sums.acc_z[j])));
+
+            other_index = _mm512_add_pd(other_index, index_step);
+        }
+
+        alignas(64) double lane_acc_x[8], lane_acc_y[8], lane_acc_z[8];
+        _mm512_store_pd(lane_acc_x, acc_x);
+        _mm512_store_pd(lane_acc_y, acc_y);
+        _mm512_store_pd(lane_acc_z, acc_z);
+        auto sum_lanes = [](double const* lanes) {
+            return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+        };
+        merge_row(sums, i, sum_lanes(lane_acc_x), sum_lanes(lane_acc_y), sum_lanes(lane_acc_z));
+    }
+}
+
+#endif
+
+}
+
+void TiledDirectSummation::Sums::reset(size_t size) {
+    acc_x.assign(size, 0);
+    acc_y.assign(size, 0);
+    acc_z.assign(size, 0);
+}
+
+void TiledDirectSummation::prepare(PhysicsState const& state) {
+    m_objects.pack(state);
+    size_t const block_count = (m_objects.count() + TileSize - 1) / TileSize;
+    if (block_count != m_block_count || m_round_offsets.empty())
+        schedule(block_count);
+    m_sums.reset(m_objects.padded_count);
+}
+
+// Circle method: blocks are paired up in block_count - 1 rounds (block_count
+// if it is odd, with one block resting in every round), so that every pair of
+// blocks meets once.
+void TiledDirectSummation::schedule(size_t block_count) {
+    m_block_count = block_count;
+    m_tiles.clear();
+    m_round_offsets.assign(1, 0);
+
+    for (size_t block = 0; block < block_count; block++)
+        m_tiles.push_back({ static_cast<uint32_t>(block), static_cast<uint32_t>(block) });
+    m_round_offsets.push_back(m_tiles.size());
+
+    size_t const even_count = block_count + block_count % 2;
+    for (size_t round = 0; round + 1 < even_count; round++) {
+        auto add_pair = [&](size_t a, size_t b) {
+            // The extra block of an odd count rests.
+            if (a >= block_count || b >= block_count)
+                return;
+            m_tiles.push_back({ static_cast<uint32_t>(std::min(a, b)), static_cast<uint32_t>(std::max(a, b)) });
+        };
+        add_pair(even_count - 1, round);
+        for (size_t k = 1; k < even_count / 2; k++)
+            add_pair((round + k) % (even_count - 1), (round + even_count - 1 - k) % (even_count - 1));
+        m_round_offsets.push_back(m_tiles.size());
+    }
+}
+
+void TiledDirectSummation::process_tile(Tile tile) {
+    size_t const row_begin = tile.row_block * TileSize;
+    size_t const row_end = std::min(row_begin + TileSize, m_objects.count());
+    size_t const column_begin = tile.column_block * TileSize;
+    size_t const column_end = std::min(column_begin + TileSize, m_objects.padded_count);
+
+    switch (m_kernel) {
+    case DirectKernel::Scalar:
+        process_tile_scalar(m_objects, m_sums, row_begin, row_end, column_begin, column_end);
+        break;
+#ifdef ESSA_DIRECT_X86
+    case DirectKernel::AVX2:
+        process_tile_avx2(m_objects, m_sums, row_begin, row_end, column_begin, column_end);
+        break;
+    case DirectKernel::AVX512:
+        process_tile_avx512(m_objects, m_sums, row_begin, row_end, column_begin, column_end);
+        break;
+#else
+    case DirectKernel::AVX2:
+    case DirectKernel::AVX512:
+        break;
+#endif
+    }
+}
+
+void TiledDirectSummation::process_tiles(ThreadPool::Worker& worker) {
+    for (size_t round = 0; round + 1 < m_round_offsets.size(); round++) {
+        if (round > 0)
+            worker.sync();
+        auto const round_begin = m_round_offsets[round];
+        auto const [first, last] = worker.range(m_round_offsets[round + 1] - round_begin);
+        for (size_t t = round_begin + first; t < round_begin + last; t++)
+            process_tile(m_tiles[t]);
+    }
+}
+
+void TiledDirectSummation::reduce(PhysicsState& state, size_t first, size_t last) const {
+    // Objects are packed in the order of active.
+    for (size_t i = first; i < last; i++) {
+        auto const index = m_objects.index[i];
+        state.acc_x[index] += m_sums.acc_x[i];
+        state.acc_y[index] += m_sums.acc_y[i];
+        state.acc_z[index] += m_sums.acc_z[i];
+    }
+}
+
+void TiledDirectSummation::compute(PhysicsState& state) {
+    prepare(state);
+    ThreadPool::run_inline([&](ThreadPool::Worker& worker) { process_tiles(worker); });
+    reduce(state, 0, state.active.size());
+}
+
+}
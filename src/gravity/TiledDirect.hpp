@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+#include "../ThreadPool.hpp"
+#include "Direct.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Gravity {
+
+// Direct summation that visits every pair once and applies the attraction to
+// both objects (like the scalar symmetric loop), but can be spread across
+// threads. The triangular pair space is split into tiles of TileSize x
+// TileSize objects, which are done in rounds: the diagonal tiles first, then
+// rounds of a round-robin tournament between blocks of objects. No two tiles
+// of a round touch the same objects, so tiles accumulate straight into the
+// sums of their objects, and workers only wait for each other between rounds.
+//
+// Every object gets the contributions of its tiles in the order of rounds,
+// whichever worker computed them, so results don't depend on the number of
+// threads and are the same in every run. They may differ from Direct in the
+// last bits.
+//
+// Usage: prepare() on one thread, then process_tiles() on every worker,
+// then reduce() for every part of [0, active count).
+class TiledDirectSummation {
+public:
+    static constexpr size_t TileSize = 256;
+
+    explicit TiledDirectSummation(DirectKernel kernel = best_direct_kernel())
+        : m_kernel(is_supported(kernel) ? kernel : DirectKernel::Scalar) { }
+
+    DirectKernel kernel() const { return m_kernel; }
+
+    void prepare(PhysicsState const&);
+    // Every worker of the job must call it.
+    void process_tiles(ThreadPool::Worker&);
+
+    // Adds the attraction to acc_* of objects active[first, last).
+    void reduce(PhysicsState&, size_t first, size_t last) const;
+
+    // prepare() + process_tiles() + reduce() on the calling thread.
+    void compute(PhysicsState&);
+
+    // Accelerations, indexed like packed objects.
+    struct Sums {
+        std::vector<double> acc_x, acc_y, acc_z;
+
+        void reset(size_t size);
+    };
+
+private:
+    struct Tile {
+        uint32_t row_block {};
+        uint32_t column_block {};
+    };
+
+    void schedule(size_t block_count);
+    void process_tile(Tile);
+
+    DirectKernel m_kernel;
+    DirectSummation::PackedObjects m_objects;
+    size_t m_block_count {};
+    // Tiles of round r are m_tiles[m_round_offsets[r], m_round_offsets[r + 1]).
+    std::vector<Tile> m_tiles;
+    std::vector<size_t> m_round_offsets;
+    Sums m_sums;
+};
+
+}
@@ -0,0 +1,58 @@
+#include "Composition.hpp"
+
+#include <cassert>
+
+namespace Integrator {
+
+namespace {
+
+// Leapfrog KDK, 2nd order.
+constexpr double LeapfrogKicks[] { 0.5, 0.5 };
+constexpr double LeapfrogDrifts[] { 1 };
+
+// Yoshida's 4th order triple jump: Leapfrog steps of w1 h, w0 h and w1 h,
+// where w1 = 1 / (2 - 2^(1/3)) and w0 = 1 - 2 w1. Adjacent kicks are merged.
+// https://doi.org/10.1016/0375-9601(90)90092-3
+constexpr double Yoshida4Kicks[] { 0.675603595979828817023843904485, -0.175603595979828817023843904485,
+    -0.175603595979828817023843904485, 0.675603595979828817023843904485 };
+constexpr double Yoshida4Drifts[] { 1.35120719195965763404768780897, -1.70241438391931526809537561794,
+    1.35120719195965763404768780897 };
+
+// Yoshida's 6th order composition of 7 Leapfrog steps (solution A).
+constexpr double Yoshida6Kicks[] { 0.392256805238778631909748816933, 0.51004341191845769875214540842,
+    -0.471053385409756436630811248991, 0.06875316825252010596891702364, 0.06875316825252010596891702364,
+    -0.471053385409756436630811248991, 0.51004341191845769875214540842, 0.392256805238778631909748816933 };
+constexpr double Yoshida6Drifts[] { 0.784513610477557263819497633866, 0.235573213359358133684793182978,
+    -1.17767998417887100694641568096, 1.31518632068391121888424972824, -1.17767998417887100694641568096,
+    0.235573213359358133684793182978, 0.784513610477557263819497633866 };
+
+// Forest-Ruth, 4th order. The same triple jump as Yoshida4, but made of
+// drift-kick-drift steps, so it starts and ends with a drift.
+// https://doi.org/10.1016/0167-2789(90)90019-L
+constexpr double ForestRuthKicks[] { 0, 1.35120719195965763404768780897, -1.70241438391931526809537561794,
+    1.35120719195965763404768780897, 0 };
+constexpr double ForestRuthDrifts[] { 0.675603595979828817023843904485, -0.175603595979828817023843904485,
+    -0.175603595979828817023843904485, 0.675603595979828817023843904485 };
+
+}
+
+Composition composition(Method method) {
+    switch (method) {
+    case Method::Leapfrog:
+        return { LeapfrogKicks, LeapfrogDrifts };
+    case Method::Yoshida4:
+        return { Yoshida4Kicks, Yoshida4Drifts };
+    case Method::Yoshida6:
+        return { Yoshida6Kicks, Yoshida6Drifts };
+    case Method::ForestRuth:
+        return { ForestRuthKicks, ForestRuthDrifts };
+    case Method::WisdomHolman:
+    case Method::IAS15:
+    case Method::Hermite:
+        break;
+    }
+    assert(false);
+    return { LeapfrogKicks, LeapfrogDrifts };
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Method.hpp"
+
+#include <span>
+
+namespace Integrator {
+
+// Symmetric splitting of a step of length h into alternating kicks
+// (vel += acc * kicks[i] * h) and drifts (pos += vel * drifts[i] * h):
+//
+//     K(kicks[0]) D(drifts[0]) K(kicks[1]) ... D(drifts[n - 1]) K(kicks[n])
+//
+// Forces are evaluated before every kick with a non-zero coefficient. Kicks
+// and drifts each sum up to 1. Higher-order methods are compositions of
+// Leapfrog steps with some negative sub-steps, so they cost more force
+// evaluations per tick, but their error drops much faster with the tick.
+struct Composition {
+    std::span<double const> kicks;
+    std::span<double const> drifts;
+
+    // Whether forces at the end of the tick are evaluated, so that the next
+    // tick can reuse them.
+    bool ends_with_kick() const { return kicks.back() != 0; }
+};
+
+// Composition of a kick-drift method. Must not be called for Method::WisdomHolman,
+// Method::IAS15 and Method::Hermite.
+Composition composition(Method);
+
+}
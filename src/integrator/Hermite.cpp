@@ -0,0 +1,288 @@
+#include "Hermite.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace Integrator {
+
+void Hermite::step(PhysicsState& state, double tick, ThreadPool::Worker& worker) {
+    auto const size = state.size();
+    auto const [first, last] = worker.range(size);
+
+    if (worker.index() == 0) {
+        m_initialize = !state_is_recorded(state, tick);
+        m_unit = tick / TickLength;
+        m_force_evaluations = 0;
+        m_block_count = 0;
+        if (m_initialize) {
+            for (auto* vector : { &m_jerk_x, &m_jerk_y, &m_jerk_z, &m_predicted_pos_x, &m_predicted_pos_y, &m_predicted_pos_z,
+                     &m_predicted_vel_x, &m_predicted_vel_y, &m_predicted_vel_z, &m_new_acc_x, &m_new_acc_y, &m_new_acc_z,
+                     &m_new_jerk_x, &m_new_jerk_y, &m_new_jerk_z }) {
+                vector->resize(size);
+            }
+            m_time.assign(size, 0);
+            m_level.assign(size, 0);
+        }
+        auto& recorded = m_recorded;
+        for (auto* vector : { &recorded.pos_x, &recorded.pos_y, &recorded.pos_z, &recorded.vel_x, &recorded.vel_y, &recorded.vel_z,
+                 &recorded.gravity_factor }) {
+            vector->resize(size);
+        }
+        recorded.alive.resize(size);
+        recorded.tick = tick;
+    }
+    worker.sync();
+    if (tick == 0)
+        return;
+
+    if (m_initialize)
+        initialize(state, worker);
+
+    auto const [alive_first, alive_last] = worker.range(state.active.size());
+    while (true) {
+        if (worker.index() == 0)
+            find_next_block(state);
+        worker.sync();
+        if (m_active.empty())
+            break;
+
+        predict(state, alive_first, alive_last);
+        worker.sync();
+
+        auto const [active_first, active_last] = worker.range(m_active.size());
+        evaluate(state, active_first, active_last);
+        correct(state, active_first, active_last);
+        worker.sync();
+    }
+
+    // Everything is at the end of the tick, which is the beginning of the next one.
+    std::fill(m_time.begin() + first, m_time.begin() + last, 0);
+}
+
+void Hermite::record_state(PhysicsState const& state, ThreadPool::Worker& worker) {
+    auto const [first, last] = worker.range(state.size());
+    auto& recorded = m_recorded;
+    auto copy = [first, last](auto const& from, auto& to) {
+        std::copy(from.begin() + first, from.begin() + last, to.begin() + first);
+    };
+    copy(state.pos_x, recorded.pos_x);
+    copy(state.pos_y, recorded.pos_y);
+    copy(state.pos_z, recorded.pos_z);
+    copy(state.vel_x, recorded.vel_x);
+    copy(state.vel_y, recorded.vel_y);
+    copy(state.vel_z, recorded.vel_z);
+    copy(state.gravity_factor, recorded.gravity_factor);
+    copy(state.alive, recorded.alive);
+}
+
+bool Hermite::state_is_recorded(PhysicsState const& state, double tick) const {
+    auto const& recorded = m_recorded;
+    return m_time.size() == state.size()
+        && recorded.tick == tick
+        && recorded.alive == state.alive
+        && recorded.pos_x == state.pos_x
+        && recorded.pos_y == state.pos_y
+        && recorded.pos_z == state.pos_z
+        && recorded.vel_x == state.vel_x
+        && recorded.vel_y == state.vel_y
+        && recorded.vel_z == state.vel_z
+        && recorded.gravity_factor == state.gravity_factor;
+}
+
+// Evaluates accelerations and jerks of all objects at the current state and
+// chooses their initial levels.
+void Hermite::initialize(PhysicsState& state, ThreadPool::Worker& worker) {
+    auto const [first, last] = worker.range(state.size());
+
+    std::copy(state.pos_x.begin() + first, state.pos_x.begin() + last, m_predicted_pos_x.begin() + first);
+    std::copy(state.pos_y.begin() + first, state.pos_y.begin() + last, m_predicted_pos_y.begin() + first);
+    std::copy(state.pos_z.begin() + first, state.pos_z.begin() + last, m_predicted_pos_z.begin() + first);
+    std::copy(state.vel_x.begin() + first, state.vel_x.begin() + last, m_predicted_vel_x.begin() + first);
+    std::copy(state.vel_y.begin() + first, state.vel_y.begin() + last, m_predicted_vel_y.begin() + first);
+    std::copy(state.vel_z.begin() + first, state.vel_z.begin() + last, m_predicted_vel_z.begin() + first);
+
+    if (worker.index() == 0) {
+        m_active = state.active;
+        m_force_evaluations += m_active.size();
+    }
+    worker.sync();
+
+    auto const [active_first, active_last] = worker.range(m_active.size());
+    evaluate(state, active_first, active_last);
+    for (size_t k = active_first; k < active_last; k++) {
+        auto const i = m_active[k];
+        state.acc_x[i] = m_new_acc_x[i];
+        state.acc_y[i] = m_new_acc_y[i];
+        state.acc_z[i] = m_new_acc_z[i];
+        m_jerk_x[i] = m_new_jerk_x[i];
+        m_jerk_y[i] = m_new_jerk_y[i];
+        m_jerk_z[i] = m_new_jerk_z[i];
+
+        // Without higher derivatives, use |a| / |j| with a stricter accuracy.
+        double const acc = std::hypot(state.acc_x[i], state.acc_y[i], state.acc_z[i]);
+        double const jerk = std::hypot(m_jerk_x[i], m_jerk_y[i], m_jerk_z[i]);
+        m_level[i] = level_for_step(m_accuracy / 2 * acc / jerk, 0);
+    }
+    worker.sync();
+}
+
+// Next block time is the earliest end of step of an object. Objects that end
+// their step then form the active block. Leaves m_active empty when all
+// objects reached the end of the tick.
+void Hermite::find_next_block(PhysicsState const& state) {
+    m_active.clear();
+    m_block_time = TickLength + 1;
+    for (auto const s : state.active) {
+        if (m_time[s] == TickLength)
+            continue;
+        auto end = m_time[s] + level_length(m_level[s]);
+        if (end < m_block_time) {
+            m_block_time = end;
+            m_active.clear();
+        }
+        if (end == m_block_time)
+            m_active.push_back(s);
+    }
+    if (!m_active.empty()) {
+        m_force_evaluations += m_active.size();
+        m_block_count++;
+    }
+}
+
+// Taylor expansion of every object from its last state to the block time.
+void Hermite::predict(PhysicsState const& state, size_t first, size_t last) {
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        double const dt = seconds(m_block_time - m_time[s]);
+        double const dt2 = dt * dt / 2;
+        double const dt3 = dt2 * dt / 3;
+        m_predicted_pos_x[s] = state.pos_x[s] + state.vel_x[s] * dt + state.acc_x[s] * dt2 + m_jerk_x[s] * dt3;
+        m_predicted_pos_y[s] = state.pos_y[s] + state.vel_y[s] * dt + state.acc_y[s] * dt2 + m_jerk_y[s] * dt3;
+        m_predicted_pos_z[s] = state.pos_z[s] + state.vel_z[s] * dt + state.acc_z[s] * dt2 + m_jerk_z[s] * dt3;
+        m_predicted_vel_x[s] = state.vel_x[s] + state.acc_x[s] * dt + m_jerk_x[s] * dt2;
+        m_predicted_vel_y[s] = state.vel_y[s] + state.acc_y[s] * dt + m_jerk_y[s] * dt2;
+        m_predicted_vel_z[s] = state.vel_z[s] + state.acc_z[s] * dt + m_jerk_z[s] * dt2;
+    }
+}
+
+// Direct summation of acceleration and jerk of active objects [first, last)
+// from predicted state of all objects, into m_new_*.
+void Hermite::evaluate(PhysicsState const& state, size_t first, size_t last) {
+    for (size_t k = first; k < last; k++) {
+        auto const i = m_active[k];
+        double const this_x = m_predicted_pos_x[i];
+        double const this_y = m_predicted_pos_y[i];
+        double const this_z = m_predicted_pos_z[i];
+        double const this_vel_x = m_predicted_vel_x[i];
+        double const this_vel_y = m_predicted_vel_y[i];
+        double const this_vel_z = m_predicted_vel_z[i];
+        double acc_x = 0, acc_y = 0, acc_z = 0;
+        double jerk_x = 0, jerk_y = 0, jerk_z = 0;
+
+        for (auto const j : state.active) {
+            if (j == i)
+                continue;
+
+            double const dist_x = m_predicted_pos_x[j] - this_x;
+            double const dist_y = m_predicted_pos_y[j] - this_y;
+            double const dist_z = m_predicted_pos_z[j] - this_z;
+            double const dist_squared = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+            if (dist_squared == 0)
+                continue;
+
+            double const dvel_x = m_predicted_vel_x[j] - this_vel_x;
+            double const dvel_y = m_predicted_vel_y[j] - this_vel_y;
+            double const dvel_z = m_predicted_vel_z[j] - this_vel_z;
+
+            double const other_gravity_factor = state.gravity_factor[j];
+            double const factor = other_gravity_factor / (dist_squared * std::sqrt(dist_squared));
+            double const attraction_x = dist_x * factor;
+            double const attraction_y = dist_y * factor;
+            double const attraction_z = dist_z * factor;
+            acc_x += attraction_x;
+            acc_y += attraction_y;
+            acc_z += attraction_z;
+
+            // d/dt (r / |r|^3) = v / |r|^3 - 3 (r . v) r / |r|^5
+            double const rv = 3 * (dist_x * dvel_x + dist_y * dvel_y + dist_z * dvel_z) / dist_squared;
+            jerk_x += dvel_x * factor - attraction_x * rv;
+            jerk_y += dvel_y * factor - attraction_y * rv;
+            jerk_z += dvel_z * factor - attraction_z * rv;
+        }
+
+        m_new_acc_x[i] = acc_x;
+        m_new_acc_y[i] = acc_y;
+        m_new_acc_z[i] = acc_z;
+        m_new_jerk_x[i] = jerk_x;
+        m_new_jerk_y[i] = jerk_y;
+        m_new_jerk_z[i] = jerk_z;
+    }
+}
+
+// Hermite corrector for active objects [first, last), and their next level.
+void Hermite::correct(PhysicsState& state, size_t first, size_t last) {
+    for (size_t k = first; k < last; k++) {
+        auto const i = m_active[k];
+        auto const length = level_length(m_level[i]);
+        double const h = seconds(length);
+
+        // Second and third derivative of acceleration at the beginning of
+        // the step, from the Hermite interpolation of a and j at both ends.
+        auto derivatives = [h](double acc, double jerk, double new_acc, double new_jerk) {
+            double const acc_diff = acc - new_acc;
+            double const snap = (-6 * acc_diff - h * (4 * jerk + 2 * new_jerk)) / (h * h);
+            double const crackle = (12 * acc_diff + 6 * h * (jerk + new_jerk)) / (h * h * h);
+            return std::pair { snap, crackle };
+        };
+        auto const [snap_x, crackle_x] = derivatives(state.acc_x[i], m_jerk_x[i], m_new_acc_x[i], m_new_jerk_x[i]);
+        auto const [snap_y, crackle_y] = derivatives(state.acc_y[i], m_jerk_y[i], m_new_acc_y[i], m_new_jerk_y[i]);
+        auto const [snap_z, crackle_z] = derivatives(state.acc_z[i], m_jerk_z[i], m_new_acc_z[i], m_new_jerk_z[i]);
+
+        double const h3 = h * h * h / 6;
+        double const h4 = h3 * h / 4;
+        double const h5 = h4 * h / 5;
+        state.pos_x[i] = m_predicted_pos_x[i] + snap_x * h4 + crackle_x * h5;
+        state.pos_y[i] = m_predicted_pos_y[i] + snap_y * h4 + crackle_y * h5;
+        state.pos_z[i] = m_predicted_pos_z[i] + snap_z * h4 + crackle_z * h5;
+        state.vel_x[i] = m_predicted_vel_x[i] + snap_x * h3 + crackle_x * h4;
+        state.vel_y[i] = m_predicted_vel_y[i] + snap_y * h3 + crackle_y * h4;
+        state.vel_z[i] = m_predicted_vel_z[i] + snap_z * h3 + crackle_z * h4;
+        state.acc_x[i] = m_new_acc_x[i];
+        state.acc_y[i] = m_new_acc_y[i];
+        state.acc_z[i] = m_new_acc_z[i];
+        m_jerk_x[i] = m_new_jerk_x[i];
+        m_jerk_y[i] = m_new_jerk_y[i];
+        m_jerk_z[i] = m_new_jerk_z[i];
+        m_time[i] += length;
+
+        // Aarseth criterion, with the snap moved to the end of the step.
+        double const acc = std::hypot(state.acc_x[i], state.acc_y[i], state.acc_z[i]);
+        double const jerk = std::hypot(m_jerk_x[i], m_jerk_y[i], m_jerk_z[i]);
+        double const snap = std::hypot(snap_x + h * crackle_x, snap_y + h * crackle_y, snap_z + h * crackle_z);
+        double const crackle = std::hypot(crackle_x, crackle_y, crackle_z);
+        double const step = std::sqrt(m_accuracy * (acc * snap + jerk * jerk) / (jerk * crackle + snap * snap));
+
+        // The step may grow only twice at a time, and only if the object is
+        // then still in sync with the bigger blocks.
+        unsigned min_level = m_level[i];
+        if (min_level > 0 && m_time[i] % level_length(min_level - 1) == 0)
+            min_level--;
+        m_level[i] = level_for_step(step, min_level);
+    }
+}
+
+// Biggest level not smaller than min_level whose length is not larger than
+// the given step in seconds. NaN (e.g. for an object without any attraction)
+// gives min_level.
+unsigned Hermite::level_for_step(double step, unsigned min_level) const {
+    double length = std::fabs(seconds(level_length(min_level)));
+    unsigned level = min_level;
+    while (level < MaxLevel && length > step) {
+        level++;
+        length /= 2;
+    }
+    return level;
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+#include "../ThreadPool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Integrator {
+
+// Fourth-order Hermite predictor-corrector with individual block timesteps
+// (Makino & Aarseth 1992).
+//
+// Every object has its own step of tick / 2^level, chosen from its
+// acceleration and its derivatives with the Aarseth criterion. Steps are
+// powers of two, so objects with the same level form blocks that are
+// advanced together, and all objects meet again at the end of the tick. At
+// every block time all objects are predicted from their own last state, but
+// forces are evaluated (with direct summation) only for the active block.
+// Objects that need tiny steps (inner moons) don't force them on the rest of
+// the system.
+//
+// https://ui.adsabs.harvard.edu/abs/1992PASJ...44..141M
+class Hermite {
+public:
+    // Accuracy parameter of the timestep criterion (eta). Lower values give
+    // smaller steps.
+    static constexpr double DefaultAccuracy = 0.02;
+
+    // Smallest possible step is tick / 2^MaxLevel.
+    static constexpr unsigned MaxLevel = 24;
+
+    double accuracy() const { return m_accuracy; }
+    void set_accuracy(double accuracy) { m_accuracy = accuracy; }
+
+    // Advances alive objects of the state by `tick` seconds (negative to go
+    // back in time), updating pos_*, vel_* and acc_*. Must be called by all
+    // workers of a job.
+    //
+    // Accelerations, jerks and levels are kept for the next call. They are
+    // calculated again if the state was modified in between (see
+    // record_state()), or the tick changed.
+    void step(PhysicsState&, double tick, ThreadPool::Worker&);
+
+    // Remembers the state after the tick (and after everything else that
+    // could have modified it), for step() to detect modifications. Must be
+    // called by every worker after step(), in the same job.
+    void record_state(PhysicsState const&, ThreadPool::Worker&);
+
+    // Number of single-object force evaluations done by the last step(). It
+    // is the object count for every evaluation of all objects, like a
+    // Leapfrog tick does.
+    size_t force_evaluations() const { return m_force_evaluations; }
+
+    // Blocks (distinct block times) advanced by the last step().
+    size_t block_count() const { return m_block_count; }
+
+private:
+    static constexpr uint64_t TickLength = uint64_t(1) << MaxLevel;
+
+    bool state_is_recorded(PhysicsState const&, double tick) const;
+    void initialize(PhysicsState&, ThreadPool::Worker&);
+    void find_next_block(PhysicsState const&);
+    void predict(PhysicsState const&, size_t first, size_t last);
+    void evaluate(PhysicsState const&, size_t first, size_t last);
+    void correct(PhysicsState&, size_t first, size_t last);
+
+    double seconds(uint64_t units) const { return static_cast<double>(units) * m_unit; }
+    uint64_t level_length(unsigned level) const { return TickLength >> level; }
+    unsigned level_for_step(double step, unsigned min_level) const;
+
+    double m_accuracy = DefaultAccuracy;
+
+    // Seconds per time unit, negative when going back in time.
+    double m_unit = 0;
+
+    // Per object, indexed like PhysicsState. Time is in units of
+    // tick / 2^MaxLevel since the beginning of the tick.
+    std::vector<uint64_t> m_time;
+    std::vector<uint8_t> m_level;
+    std::vector<double> m_jerk_x, m_jerk_y, m_jerk_z;
+    std::vector<double> m_predicted_pos_x, m_predicted_pos_y, m_predicted_pos_z;
+    std::vector<double> m_predicted_vel_x, m_predicted_vel_y, m_predicted_vel_z;
+    std::vector<double> m_new_acc_x, m_new_acc_y, m_new_acc_z;
+    std::vector<double> m_new_jerk_x, m_new_jerk_y, m_new_jerk_z;
+
+    // Current block: its time and objects that are advanced to it.
+    uint64_t m_block_time = 0;
+    std::vector<size_t> m_active;
+    bool m_initialize = false;
+
+    // State after the last step(), see record_state().
+    struct RecordedState {
+        std::vector<double> pos_x, pos_y, pos_z;
+        std::vector<double> vel_x, vel_y, vel_z;
+        std::vector<double> gravity_factor;
+        std::vector<uint8_t> alive;
+        double tick = 0;
+    };
+    RecordedState m_recorded;
+
+    size_t m_force_evaluations = 0;
+    size_t m_block_count = 0;
+};
+
+}
@@ -0,0 +1,394 @@
+#include "IAS15.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Integrator {
+
+namespace {
+
+// Gauss-Radau spacings within a step.
+constexpr double Spacings[] { 0, 0.0562625605369221464656522, 0.1802406917368923649875799, 0.3526247171131696373739078,
+    0.5471536263305553830014486, 0.7342101772154105315232106, 0.8853209468390957680903598, 0.9775206135612875018911745 };
+
+// Conversion between the Newton form (g) and the power form (b) of the
+// acceleration polynomial. Coefficient (k, j), k < j, is at j * (j - 1) / 2 + k:
+//     b[k] = g[k] + sum of BFromG(k, j) * g[j]
+//     g[k] = b[k] + sum of GFromB(k, j) * b[j]
+constexpr double BFromG[] { -0.0562625605369221464656522, 0.0101408028300636299864818, -0.2365032522738145114532321,
+    -3.575897729251617594934459e-3, 0.0935376952594620658957485, -0.5891279693869841488271399,
+    1.956565409947221076900567e-3, -0.0547553868890686864408084, 0.4158812000823068616886219,
+    -1.1362815957175395318285885, -1.436530236370891542445955e-3, 0.0421585277212687077072973,
+    -0.3600995965020568122897665, 1.2501507118406910258505441, -1.8704917729329500633517991,
+    1.271790309026867749294312e-3, -0.0387603579159067703699046, 0.3609622434528459832253398,
+    -1.4668842084004269643701553, 2.9061362593084293014237913, -2.7558127197720458314421588 };
+constexpr double GFromB[] { 0.0562625605369221464656522, 3.165475718170829249990480e-3, 0.2365032522738145114532321,
+    1.780977692217433881125279e-4, 0.0457929855060279188954539, 0.5891279693869841488271399,
+    1.002023652232912720956722e-5, 8.431857153525701544499974e-3, 0.2535340690545692665214616,
+    1.1362815957175395318285885, 5.637641639318207610383850e-7, 1.529784002500465818949008e-3,
+    0.0978342365324440053653648, 0.8752546646840910912297246, 1.8704917729329500633517991,
+    3.171881540176136647585482e-8, 2.762930909826476593130226e-4, 0.0360285539837364596003871,
+    0.5767330002770787313544596, 2.2485887607691597933926895, 2.7558127197720458314421588 };
+
+constexpr size_t coefficient_index(size_t k, size_t j) { return j * (j - 1) / 2 + k; }
+
+// A step is rejected (and done again) when the next one should be shorter
+// than this times the current one, and steps never grow more than its
+// inverse.
+constexpr double SafetyFactor = 0.25;
+
+// Predictor-corrector iterations stop when coefficients change by less than
+// this relative to accelerations, or stop converging.
+constexpr double ConvergenceThreshold = 1e-16;
+constexpr unsigned MaxIterations = 12;
+
+// Steps shorter than this part of a tick are never rejected, so that a
+// singularity (e.g. objects at the same position) can't stop the simulation.
+constexpr double MinStepRatio = 1e-12;
+
+// Kahan summation: `value - compensation` is the exact sum.
+void add_compensated(double& value, double& compensation, double increment) {
+    double const y = increment - compensation;
+    double const sum = value + y;
+    compensation = (sum - value) - y;
+    value = sum;
+}
+
+}
+
+void IAS15::step(PhysicsState& state, double tick, ThreadPool::Worker& worker, bool forces_are_current, std::function<void()> const& evaluate_forces) {
+    auto const [first, last] = worker.range(state.active.size());
+
+    if (worker.index() == 0)
+        prepare(state, tick, worker.count());
+    worker.sync();
+    if (tick == 0)
+        return;
+
+    auto evaluate = [&]() {
+        evaluate_forces();
+        if (worker.index() == 0)
+            m_force_evaluations += state.active.size();
+    };
+    if (forces_are_current)
+        worker.sync();
+    else
+        evaluate();
+
+    // Every worker makes the same decisions from the same values, so they
+    // are kept locally, and written back only by worker 0 at the end.
+    double step = m_step;
+    double last_step = m_last_step;
+    double remaining = tick;
+    size_t step_count = 0;
+
+    while (true) {
+        // Steps are shortened to end exactly at the end of the tick, without
+        // leaving a sliver of it for a separate step.
+        double current_step = step;
+        bool shortened = false;
+        if (std::abs(step) >= std::abs(remaining)) {
+            current_step = remaining;
+            shortened = true;
+        }
+        else if (std::abs(remaining) - std::abs(step) < std::abs(step) * SafetyFactor) {
+            current_step = remaining / 2;
+            shortened = true;
+        }
+
+        begin_substep(state, first, last);
+
+        double change = std::numeric_limits<double>::infinity();
+        double last_change = 0;
+        for (unsigned iteration = 0; iteration < MaxIterations; iteration++) {
+            if (change < ConvergenceThreshold || (iteration > 2 && last_change <= change))
+                break;
+            last_change = change;
+
+            double max_change = 0;
+            for (size_t node = 1; node <= Order; node++) {
+                predict(state, current_step, node, first, last);
+                evaluate();
+                max_change = correct(state, node, first, last);
+            }
+            m_partial_change[worker.index()] = max_change;
+            m_partial_acceleration[worker.index()] = max_acceleration(state, first, last);
+            worker.sync();
+            change = relative_change();
+            worker.sync();
+        }
+
+        m_partial_timescale[worker.index()] = min_timescale_squared(state, first, last);
+        worker.sync();
+        double const timescale_squared = *std::min_element(m_partial_timescale.begin(), m_partial_timescale.end());
+        worker.sync();
+
+        double ideal_step = current_step / SafetyFactor;
+        if (std::isnormal(timescale_squared))
+            ideal_step = std::sqrt(timescale_squared) * current_step * std::pow(Accuracy * 5040, 1.0 / 7);
+
+        if (std::abs(ideal_step) < std::abs(current_step) * SafetyFactor && std::abs(current_step) > std::abs(tick) * MinStepRatio) {
+            restore_substep(state, first, last);
+            if (last_step != 0)
+                predict_coefficients(state, ideal_step / last_step, first, last);
+            else
+                clear_coefficients(state, first, last);
+            step = ideal_step;
+            continue;
+        }
+        double const new_step = std::clamp(ideal_step, -std::abs(current_step) / SafetyFactor, std::abs(current_step) / SafetyFactor);
+
+        finish_substep(state, current_step, first, last);
+        predict_coefficients(state, new_step / current_step, first, last);
+        last_step = current_step;
+        step_count++;
+        evaluate();
+
+        // A shortened step only tells whether the usual one is too long.
+        if (!shortened)
+            step = new_step;
+        else if (std::abs(ideal_step) < std::abs(step))
+            step = ideal_step;
+
+        if (current_step == remaining)
+            break;
+        remaining -= current_step;
+    }
+
+    if (worker.index() == 0) {
+        m_step = step;
+        m_last_step = last_step;
+        m_step_count = step_count;
+    }
+}
+
+void IAS15::prepare(PhysicsState const& state, double tick, size_t worker_count) {
+    m_force_evaluations = 0;
+    m_step_count = 0;
+    m_partial_change.resize(worker_count);
+    m_partial_acceleration.resize(worker_count);
+    m_partial_timescale.resize(worker_count);
+
+    // Coefficients of other objects are no good guess, and neither are
+    // these of steps in the other direction.
+    bool const same_objects = m_alive == state.alive;
+    bool const same_direction = m_step * tick > 0;
+    if (same_objects && same_direction)
+        return;
+
+    if (!same_direction)
+        m_step = tick;
+    m_last_step = 0;
+    m_alive = state.alive;
+
+    auto const components = 3 * state.size();
+    for (auto* vector : { &m_start_pos, &m_start_vel, &m_start_acc })
+        vector->resize(components);
+    for (auto* vector : { &m_pos_compensation, &m_vel_compensation })
+        vector->assign(components, 0);
+    for (auto* coefficients : { &m_b, &m_g, &m_e, &m_last_b, &m_last_e }) {
+        for (auto& vector : *coefficients)
+            vector.assign(components, 0);
+    }
+}
+
+void IAS15::begin_substep(PhysicsState const& state, size_t first, size_t last) {
+    auto const pos = std::array { &state.pos_x, &state.pos_y, &state.pos_z };
+    auto const vel = std::array { &state.vel_x, &state.vel_y, &state.vel_z };
+    auto const acc = std::array { &state.acc_x, &state.acc_y, &state.acc_z };
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        for (size_t axis = 0; axis < 3; axis++) {
+            auto const c = 3 * s + axis;
+            m_start_pos[c] = (*pos[axis])[s];
+            m_start_vel[c] = (*vel[axis])[s];
+            m_start_acc[c] = (*acc[axis])[s];
+            for (size_t k = 0; k < Order; k++) {
+                double g = m_b[k][c];
+                for (size_t j = k + 1; j < Order; j++)
+                    g += GFromB[coefficient_index(k, j)] * m_b[j][c];
+                m_g[k][c] = g;
+            }
+        }
+    }
+}
+
+// Positions at a spacing from the acceleration polynomial integrated twice.
+void IAS15::predict(PhysicsState& state, double step, size_t node, size_t first, size_t last) const {
+    auto const pos = std::array { &state.pos_x, &state.pos_y, &state.pos_z };
+    double const t = Spacings[node];
+    double const dt = t * step;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        for (size_t axis = 0; axis < 3; axis++) {
+            auto const c = 3 * s + axis;
+            auto const& b = m_b;
+            double const acc_integral = m_start_acc[c] / 2
+                + t * (b[0][c] / 6 + t * (b[1][c] / 12 + t * (b[2][c] / 20 + t * (b[3][c] / 30 + t * (b[4][c] / 42 + t * (b[5][c] / 56 + t * b[6][c] / 72))))));
+            (*pos[axis])[s] = (m_start_pos[c] - m_pos_compensation[c]) + dt * (m_start_vel[c] + dt * acc_integral);
+        }
+    }
+}
+
+// Updates g and b with accelerations at a spacing. Returns the largest
+// change of the coefficient that the spacing determines.
+double IAS15::correct(PhysicsState const& state, size_t node, size_t first, size_t last) {
+    auto const acc = std::array { &state.acc_x, &state.acc_y, &state.acc_z };
+    auto const k = node - 1;
+    double max_change = 0;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        for (size_t axis = 0; axis < 3; axis++) {
+            auto const c = 3 * s + axis;
+            double g = ((*acc[axis])[s] - m_start_acc[c]) / Spacings[node];
+            for (size_t j = 1; j < node; j++)
+                g = (g - m_g[j - 1][c]) / (Spacings[node] - Spacings[j]);
+            double const change = g - m_g[k][c];
+            m_g[k][c] = g;
+            for (size_t j = 0; j < k; j++)
+                m_b[j][c] += change * BFromG[coefficient_index(j, k)];
+            m_b[k][c] += change;
+            max_change = std::max(max_change, std::abs(change));
+        }
+    }
+    return max_change;
+}
+
+double IAS15::max_acceleration(PhysicsState const& state, size_t first, size_t last) const {
+    double result = 0;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        result = std::max({ result, std::abs(state.acc_x[s]), std::abs(state.acc_y[s]), std::abs(state.acc_z[s]) });
+    }
+    return result;
+}
+
+// Shortest timescale on which acceleration of an object changes, from
+// its derivatives at the end of the step, squared and relative to the step
+// (Pham, Rein & Spiegel 2024). Unlike the last coefficient, it doesn't
+// suffer from round-off of positions far from the origin.
+double IAS15::min_timescale_squared(PhysicsState const& state, size_t first, size_t last) const {
+    double result = std::numeric_limits<double>::infinity();
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        double acc_squared = 0;
+        double jerk_squared = 0;
+        double snap_squared = 0;
+        for (size_t axis = 0; axis < 3; axis++) {
+            auto const c = 3 * s + axis;
+            auto const& b = m_b;
+            double const acc = m_start_acc[c] + b[0][c] + b[1][c] + b[2][c] + b[3][c] + b[4][c] + b[5][c] + b[6][c];
+            double const jerk = b[0][c] + 2 * b[1][c] + 3 * b[2][c] + 4 * b[3][c] + 5 * b[4][c] + 6 * b[5][c] + 7 * b[6][c];
+            double const snap = 2 * b[1][c] + 6 * b[2][c] + 12 * b[3][c] + 20 * b[4][c] + 30 * b[5][c] + 42 * b[6][c];
+            acc_squared += acc * acc;
+            jerk_squared += jerk * jerk;
+            snap_squared += snap * snap;
+        }
+        if (!std::isnormal(snap_squared))
+            continue;
+        double const timescale_squared = 2 * acc_squared / (jerk_squared + std::sqrt(snap_squared * acc_squared));
+        if (std::isnormal(timescale_squared))
+            result = std::min(result, timescale_squared);
+    }
+    return result;
+}
+
+void IAS15::finish_substep(PhysicsState& state, double step, size_t first, size_t last) {
+    auto const pos = std::array { &state.pos_x, &state.pos_y, &state.pos_z };
+    auto const vel = std::array { &state.vel_x, &state.vel_y, &state.vel_z };
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        for (size_t axis = 0; axis < 3; axis++) {
+            auto const c = 3 * s + axis;
+            auto const& b = m_b;
+            double const a0 = m_start_acc[c];
+            double const pos_change = step * m_start_vel[c]
+                + step * step * (a0 / 2 + b[0][c] / 6 + b[1][c] / 12 + b[2][c] / 20 + b[3][c] / 30 + b[4][c] / 42 + b[5][c] / 56 + b[6][c] / 72);
+            double const vel_change = step * (a0 + b[0][c] / 2 + b[1][c] / 3 + b[2][c] / 4 + b[3][c] / 5 + b[4][c] / 6 + b[5][c] / 7 + b[6][c] / 8);
+
+            double new_pos = m_start_pos[c];
+            add_compensated(new_pos, m_pos_compensation[c], pos_change);
+            (*pos[axis])[s] = new_pos;
+            double new_vel = m_start_vel[c];
+            add_compensated(new_vel, m_vel_compensation[c], vel_change);
+            (*vel[axis])[s] = new_vel;
+
+            for (size_t k = 0; k < Order; k++) {
+                m_last_b[k][c] = m_b[k][c];
+                m_last_e[k][c] = m_e[k][c];
+            }
+        }
+    }
+}
+
+void IAS15::restore_substep(PhysicsState& state, size_t first, size_t last) const {
+    auto const pos = std::array { &state.pos_x, &state.pos_y, &state.pos_z };
+    auto const acc = std::array { &state.acc_x, &state.acc_y, &state.acc_z };
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        for (size_t axis = 0; axis < 3; axis++) {
+            (*pos[axis])[s] = m_start_pos[3 * s + axis];
+            (*acc[axis])[s] = m_start_acc[3 * s + axis];
+        }
+    }
+}
+
+// Predicts coefficients of the next step from the last accepted one, which
+// was `ratio` times shorter, and keeps the error of the last prediction as a
+// correction.
+void IAS15::predict_coefficients(PhysicsState const& state, double ratio, size_t first, size_t last) {
+    if (std::abs(ratio) > 20) {
+        clear_coefficients(state, first, last);
+        return;
+    }
+
+    double const q1 = ratio;
+    double const q2 = q1 * q1;
+    double const q3 = q2 * q1;
+    double const q4 = q2 * q2;
+    double const q5 = q4 * q1;
+    double const q6 = q3 * q3;
+    double const q7 = q6 * q1;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        for (size_t axis = 0; axis < 3; axis++) {
+            auto const c = 3 * s + axis;
+            auto const& b = m_last_b;
+            std::array<double, Order> prediction_error;
+            for (size_t k = 0; k < Order; k++)
+                prediction_error[k] = b[k][c] - m_last_e[k][c];
+
+            m_e[0][c] = q1 * (b[6][c] * 7 + b[5][c] * 6 + b[4][c] * 5 + b[3][c] * 4 + b[2][c] * 3 + b[1][c] * 2 + b[0][c]);
+            m_e[1][c] = q2 * (b[6][c] * 21 + b[5][c] * 15 + b[4][c] * 10 + b[3][c] * 6 + b[2][c] * 3 + b[1][c]);
+            m_e[2][c] = q3 * (b[6][c] * 35 + b[5][c] * 20 + b[4][c] * 10 + b[3][c] * 4 + b[2][c]);
+            m_e[3][c] = q4 * (b[6][c] * 35 + b[5][c] * 15 + b[4][c] * 5 + b[3][c]);
+            m_e[4][c] = q5 * (b[6][c] * 21 + b[5][c] * 6 + b[4][c]);
+            m_e[5][c] = q6 * (b[6][c] * 7 + b[5][c]);
+            m_e[6][c] = q7 * b[6][c];
+            for (size_t k = 0; k < Order; k++)
+                m_b[k][c] = m_e[k][c] + prediction_error[k];
+        }
+    }
+}
+
+void IAS15::clear_coefficients(PhysicsState const& state, size_t first, size_t last) {
+    for (size_t a = first; a < last; a++) {
+        auto const c = 3 * state.active[a];
+        for (size_t k = 0; k < Order; k++) {
+            std::fill(m_b[k].begin() + c, m_b[k].begin() + c + 3, 0);
+            std::fill(m_e[k].begin() + c, m_e[k].begin() + c + 3, 0);
+        }
+    }
+}
+
+double IAS15::relative_change() const {
+    double const change = *std::max_element(m_partial_change.begin(), m_partial_change.end());
+    double const acceleration = *std::max_element(m_partial_acceleration.begin(), m_partial_acceleration.end());
+    // Nothing accelerates, so polynomials are exact.
+    if (acceleration == 0 && change == 0)
+        return 0;
+    return change / acceleration;
+}
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+#include "../ThreadPool.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Integrator {
+
+// IAS15: 15th order Gauss-Radau integrator with adaptive steps (Rein &
+// Spiegel 2015, after Everhart 1985).
+//
+// Every step, accelerations are approximated by a polynomial in time, whose
+// coefficients are found by evaluating forces at 7 Gauss-Radau spacings
+// within the step and iterating until they converge (predictor-corrector).
+// The next step is chosen from the shortest timescale on which any
+// acceleration changes, so that the error stays at machine precision (the
+// step criterion of Pham, Rein & Spiegel 2024). Close encounters are resolved with many small steps, and quiet
+// phases are passed with steps as long as the whole tick. A step costs 8-15
+// force evaluations, so it's slower than Leapfrog for a tick that Leapfrog
+// handles well.
+//
+// https://ui.adsabs.harvard.edu/abs/2015MNRAS.446.1424R
+class IAS15 {
+public:
+    // Accuracy parameter (epsilon). Steps scale with its 7th root.
+    static constexpr double Accuracy = 1e-9;
+
+    // Advances alive objects of the state by `tick` seconds (negative to go
+    // back in time), in as many steps as needed. Must be called by all
+    // workers of a job.
+    //
+    // `evaluate_forces` is called by all workers to fill acc_* for the
+    // current positions. The first evaluation is skipped if
+    // `forces_are_current`. Forces are left evaluated for the final
+    // positions.
+    //
+    // Steps and polynomial coefficients are kept for the next call, so that
+    // the next tick starts with a good guess.
+    void step(PhysicsState&, double tick, ThreadPool::Worker&, bool forces_are_current, std::function<void()> const& evaluate_forces);
+
+    // Number of single-object force evaluations done by the last step(),
+    // counted like Hermite::force_evaluations().
+    size_t force_evaluations() const { return m_force_evaluations; }
+
+    // Steps (excluding rejected ones) done by the last step().
+    size_t step_count() const { return m_step_count; }
+
+private:
+    static constexpr size_t Order = 7;
+    using Coefficients = std::array<std::vector<double>, Order>;
+
+    void prepare(PhysicsState const&, double tick, size_t worker_count);
+    void begin_substep(PhysicsState const&, size_t first, size_t last);
+    void predict(PhysicsState&, double step, size_t node, size_t first, size_t last) const;
+    double correct(PhysicsState const&, size_t node, size_t first, size_t last);
+    double max_acceleration(PhysicsState const&, size_t first, size_t last) const;
+    double min_timescale_squared(PhysicsState const&, size_t first, size_t last) const;
+    void finish_substep(PhysicsState&, double step, size_t first, size_t last);
+    void restore_substep(PhysicsState&, size_t first, size_t last) const;
+    void predict_coefficients(PhysicsState const&, double ratio, size_t first, size_t last);
+    void clear_coefficients(PhysicsState const&, size_t first, size_t last);
+
+    // Largest of m_partial_change relative to the largest of
+    // m_partial_acceleration. All workers read it after a sync.
+    double relative_change() const;
+
+    // Per component (3 * object index + axis). b are coefficients of the
+    // acceleration polynomial, g the same in Newton form, and e predictions
+    // of b from the previous step.
+    std::vector<double> m_start_pos, m_start_vel, m_start_acc;
+    std::vector<double> m_pos_compensation, m_vel_compensation;
+    Coefficients m_b, m_g, m_e;
+    Coefficients m_last_b, m_last_e;
+
+    // Objects that the coefficients were calculated for.
+    std::vector<uint8_t> m_alive;
+
+    // Step to try next, and the last step done.
+    double m_step = 0;
+    double m_last_step = 0;
+
+    // Per worker extremes, reduced by all workers after a sync.
+    std::vector<double> m_partial_change;
+    std::vector<double> m_partial_acceleration;
+    std::vector<double> m_partial_timescale;
+
+    size_t m_force_evaluations = 0;
+    size_t m_step_count = 0;
+};
+
+}
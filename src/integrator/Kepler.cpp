@@ -0,0 +1,139 @@
+#include "Kepler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Integrator {
+
+namespace {
+
+// Stumpff functions c0..c3 of z. The argument is reduced by quartering it
+// until the series converge quickly, and the results are brought back with
+// the quadrupling formulas (Danby, Fundamentals of Celestial Mechanics).
+std::array<double, 4> stumpff(double z) {
+    if (!std::isfinite(z)) {
+        constexpr auto NaN = std::numeric_limits<double>::quiet_NaN();
+        return { NaN, NaN, NaN, NaN };
+    }
+    unsigned quarterings = 0;
+    while (std::abs(z) > 0.1) {
+        z /= 4;
+        quarterings++;
+    }
+
+    double c2 = (1 - z / 12 * (1 - z / 30 * (1 - z / 56 * (1 - z / 90 * (1 - z / 132 * (1 - z / 182)))))) / 2;
+    double c3 = (1 - z / 20 * (1 - z / 42 * (1 - z / 72 * (1 - z / 110 * (1 - z / 156 * (1 - z / 210)))))) / 6;
+    double c1 = 1 - z * c3;
+    double c0 = 1 - z * c2;
+
+    for (; quarterings > 0; quarterings--) {
+        c3 = (c2 + c0 * c3) / 4;
+        c2 = c1 * c1 / 2;
+        c1 = c0 * c1;
+        c0 = 2 * c0 * c0 - 1;
+    }
+    return { c0, c1, c2, c3 };
+}
+
+}
+
+void kepler_drift(double gm, double time, std::array<double, 3>& pos, std::array<double, 3>& vel) {
+    double const r0 = std::sqrt(pos[0] * pos[0] + pos[1] * pos[1] + pos[2] * pos[2]);
+    if (time == 0 || r0 == 0)
+        return;
+
+    double const eta0 = pos[0] * vel[0] + pos[1] * vel[1] + pos[2] * vel[2];
+    double const v2 = vel[0] * vel[0] + vel[1] * vel[1] + vel[2] * vel[2];
+    double const beta = 2 * gm / r0 - v2;
+    double const zeta0 = gm - beta * r0;
+
+    // Bound orbits are periodic, so keep the universal anomaly small.
+    if (beta > 0) {
+        double const period = 2 * M_PI * gm / (beta * std::sqrt(beta));
+        time = std::fmod(time, period);
+    }
+
+    // Kepler's equation in the universal anomaly s:
+    //     r0 G1(s) + eta0 G2(s) + gm G3(s) = time
+    // where Gn(s) = s^n cn(beta s^2), solved with Laguerre-Conway iteration.
+    // It converges from poor starting points for bound orbits, but not for
+    // long hyperbolic drifts, where G grows exponentially with s. Those start
+    // from the hyperbolic Kepler equation, and if the iteration still doesn't
+    // converge, the root is found by bisection.
+    auto kepler_equation = [&](double s) {
+        auto const c = stumpff(beta * s * s);
+        return r0 * s + eta0 * s * s * c[2] + zeta0 * s * s * s * c[3] - time;
+    };
+
+    double s = time / r0;
+    if (beta < 0 && gm > 0) {
+        // Hyperbolic anomaly H, with r = a (e cosh H - 1) and
+        // e sinh H - H = M, where a = gm / -beta and M grows linearly with
+        // time. For large M, H ~ ln(2M / e) (Danby).
+        double const sqrt_minus_beta = std::sqrt(-beta);
+        double const h2 = std::max(r0 * r0 * v2 - eta0 * eta0, 0.0);
+        double const e = std::sqrt(1 - h2 * beta / (gm * gm));
+        double const anomaly0 = std::asinh(eta0 * sqrt_minus_beta / (e * gm));
+        double const mean_anomaly = e * std::sinh(anomaly0) - anomaly0 + time * -beta * sqrt_minus_beta / gm;
+        double const anomaly = std::copysign(std::log(2 * std::abs(mean_anomaly) / e + 1.8), mean_anomaly);
+        double const guess = (anomaly - anomaly0) / sqrt_minus_beta;
+        if (std::isfinite(guess))
+            s = guess;
+    }
+
+    bool converged = false;
+    for (unsigned iteration = 0; iteration < 50; iteration++) {
+        auto const c = stumpff(beta * s * s);
+        std::array<double, 4> const gn = { c[0], s * c[1], s * s * c[2], s * s * s * c[3] };
+        double const f = r0 * s + eta0 * gn[2] + zeta0 * gn[3] - time;
+        double const r = r0 + eta0 * gn[1] + zeta0 * gn[2];
+        double const r_prime = eta0 * gn[0] + zeta0 * gn[1];
+        double const ds = -5 * f / (r + std::copysign(std::sqrt(std::abs(16 * r * r - 20 * f * r_prime)), r));
+        if (!std::isfinite(ds))
+            break;
+        s += ds;
+        // Rounding can keep the last steps from getting smaller than that.
+        converged = std::abs(ds) <= 1e-12 * std::abs(s);
+        if (std::abs(ds) <= 1e-15 * std::abs(s))
+            break;
+    }
+
+    if (!converged) {
+        // The equation increases with s (its derivative is r > 0), and s has
+        // the sign of time. Values that overflow are past the root.
+        auto past_root = [&](double x) { return !(std::copysign(1.0, time) * kepler_equation(std::copysign(x, time)) < 0); };
+        double low = 0;
+        double high = std::abs(time) / r0;
+        while (!past_root(high) && std::isfinite(high)) {
+            low = high;
+            high *= 2;
+        }
+        for (unsigned iteration = 0; iteration < 2100; iteration++) {
+            double const middle = low + (high - low) / 2;
+            if (middle <= low || middle >= high)
+                break;
+            (past_root(middle) ? high : low) = middle;
+        }
+        s = std::copysign(low + (high - low) / 2, time);
+    }
+
+    auto const c = stumpff(beta * s * s);
+    std::array<double, 4> const gn = { c[0], s * c[1], s * s * c[2], s * s * s * c[3] };
+    double const r = r0 + eta0 * gn[1] + zeta0 * gn[2];
+
+    // Gauss f and g functions.
+    double const f = 1 - gm * gn[2] / r0;
+    double const g = time - gm * gn[3];
+    double const f_dot = -gm * gn[1] / (r0 * r);
+    double const g_dot = 1 - gm * gn[2] / r;
+
+    for (unsigned i = 0; i < 3; i++) {
+        double const p = pos[i];
+        double const v = vel[i];
+        pos[i] = f * p + g * v;
+        vel[i] = f_dot * p + g_dot * v;
+    }
+}
+
+}
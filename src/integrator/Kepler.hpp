@@ -0,0 +1,14 @@
+#pragma once
+
+#include <array>
+
+namespace Integrator {
+
+// Moves a body on its Kepler orbit around a fixed center of gravitational
+// parameter `gm` (G * mass) by `time` seconds (negative to go back). `pos`
+// and `vel` are relative to the center. Works for any orbit (elliptic,
+// parabolic, hyperbolic and radial, but not for pos = 0), because it solves
+// Kepler's equation in universal variables.
+void kepler_drift(double gm, double time, std::array<double, 3>& pos, std::array<double, 3>& vel);
+
+}
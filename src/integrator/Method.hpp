@@ -0,0 +1,80 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+namespace Integrator {
+
+// Method used by World::update() to advance objects by one tick.
+enum class Method {
+    // Second-order Leapfrog KDK with one global step. Uses the selected
+    // gravity solver, like the other kick-drift compositions below (see
+    // Composition.hpp).
+    Leapfrog,
+
+    // Fourth-order Yoshida composition of 3 Leapfrog steps. 3 force
+    // evaluations per tick.
+    Yoshida4,
+
+    // Sixth-order Yoshida composition of 7 Leapfrog steps. 7 force
+    // evaluations per tick.
+    Yoshida6,
+
+    // Fourth-order Forest-Ruth, like Yoshida4 but starting with a drift.
+    // 3 force evaluations per tick.
+    ForestRuth,
+
+    // Wisdom-Holman mapper, see WisdomHolman.hpp. Kepler orbits around the
+    // most massive object are solved exactly, so systems dominated by it
+    // (planets around a star) allow much longer ticks. 1 force evaluation
+    // per tick.
+    WisdomHolman,
+
+    // 15th order Gauss-Radau with adaptive steps within the tick, see
+    // IAS15.hpp. Accurate to machine precision even in close encounters.
+    IAS15,
+
+    // Fourth-order Hermite predictor-corrector with individual block
+    // timesteps, see Hermite.hpp. Always uses direct summation.
+    Hermite,
+};
+
+inline std::optional<Method> method_from_string(std::string_view name) {
+    if (name == "leapfrog")
+        return Method::Leapfrog;
+    if (name == "yoshida4")
+        return Method::Yoshida4;
+    if (name == "yoshida6")
+        return Method::Yoshida6;
+    if (name == "forest_ruth")
+        return Method::ForestRuth;
+    if (name == "wisdom_holman")
+        return Method::WisdomHolman;
+    if (name == "ias15")
+        return Method::IAS15;
+    if (name == "hermite")
+        return Method::Hermite;
+    return {};
+}
+
+inline char const* method_to_string(Method method) {
+    switch (method) {
+    case Method::Leapfrog:
+        return "leapfrog";
+    case Method::Yoshida4:
+        return "yoshida4";
+    case Method::Yoshida6:
+        return "yoshida6";
+    case Method::ForestRuth:
+        return "forest_ruth";
+    case Method::WisdomHolman:
+        return "wisdom_holman";
+    case Method::IAS15:
+        return "ias15";
+    case Method::Hermite:
+        return "hermite";
+    }
+    return "";
+}
+
+}
@@ -0,0 +1,172 @@
+#include "Reversible.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+namespace Integrator {
+
+namespace {
+
+// Units are powers of two, so dividing by them is exact and negating the
+// value negates the result. Nothing if the value doesn't fit (or is NaN).
+std::optional<int64_t> to_fixed(double value, double unit) {
+    double const scaled = value / unit;
+    if (!(std::abs(scaled) < 0x1p63))
+        return {};
+    return std::llround(scaled);
+}
+
+// Adds value rounded to fixed point, unless either doesn't fit.
+bool add_fixed(int64_t& fixed, double value, double unit) {
+    auto const increment = to_fixed(value, unit);
+    if (!increment)
+        return false;
+    if (*increment > 0 ? fixed > std::numeric_limits<int64_t>::max() - *increment : fixed < std::numeric_limits<int64_t>::min() - *increment)
+        return false;
+    fixed += *increment;
+    return true;
+}
+
+double from_fixed(int64_t value, double unit) {
+    return static_cast<double>(value) * unit;
+}
+
+}
+
+void Reversible::step(PhysicsState& state, Composition const& composition, double tick, ThreadPool::Worker& worker, bool forces_are_current,
+    std::function<void()> const& evaluate_forces) {
+    auto const [first, last] = worker.range(state.active.size());
+
+    if (worker.index() == 0)
+        load(state);
+    worker.sync();
+
+    if (composition.kicks[0] != 0) {
+        // Forces for positions before rounding are not exactly the forces
+        // that a negative tick would end with.
+        if (!forces_are_current || m_loaded)
+            evaluate_forces();
+        kick(state, composition.kicks[0] * tick, first, last);
+    }
+
+    for (size_t i = 0; i < composition.drifts.size(); i++) {
+        drift(state, composition.drifts[i] * tick, first, last);
+
+        auto const coefficient = composition.kicks[i + 1];
+        if (coefficient == 0)
+            continue;
+        evaluate_forces();
+        kick(state, coefficient * tick, first, last);
+    }
+}
+
+void Reversible::load(PhysicsState& state) {
+    auto const size = state.size();
+    m_pos_x.resize(size);
+    m_pos_y.resize(size);
+    m_pos_z.resize(size);
+    m_vel_x.resize(size);
+    m_vel_y.resize(size);
+    m_vel_z.resize(size);
+    m_floating.assign(size, 0);
+
+    m_loaded = false;
+    for (auto const s : state.active) {
+        if (from_fixed(m_pos_x[s], PositionUnit) == state.pos_x[s] && from_fixed(m_pos_y[s], PositionUnit) == state.pos_y[s]
+            && from_fixed(m_pos_z[s], PositionUnit) == state.pos_z[s] && from_fixed(m_vel_x[s], VelocityUnit) == state.vel_x[s]
+            && from_fixed(m_vel_y[s], VelocityUnit) == state.vel_y[s] && from_fixed(m_vel_z[s], VelocityUnit) == state.vel_z[s])
+            continue;
+
+        auto const pos_x = to_fixed(state.pos_x[s], PositionUnit);
+        auto const pos_y = to_fixed(state.pos_y[s], PositionUnit);
+        auto const pos_z = to_fixed(state.pos_z[s], PositionUnit);
+        auto const vel_x = to_fixed(state.vel_x[s], VelocityUnit);
+        auto const vel_y = to_fixed(state.vel_y[s], VelocityUnit);
+        auto const vel_z = to_fixed(state.vel_z[s], VelocityUnit);
+        if (!pos_x || !pos_y || !pos_z || !vel_x || !vel_y || !vel_z) {
+            m_floating[s] = 1;
+            continue;
+        }
+
+        m_pos_x[s] = *pos_x;
+        m_pos_y[s] = *pos_y;
+        m_pos_z[s] = *pos_z;
+        m_vel_x[s] = *vel_x;
+        m_vel_y[s] = *vel_y;
+        m_vel_z[s] = *vel_z;
+        state.pos_x[s] = from_fixed(m_pos_x[s], PositionUnit);
+        state.pos_y[s] = from_fixed(m_pos_y[s], PositionUnit);
+        state.pos_z[s] = from_fixed(m_pos_z[s], PositionUnit);
+        state.vel_x[s] = from_fixed(m_vel_x[s], VelocityUnit);
+        state.vel_y[s] = from_fixed(m_vel_y[s], VelocityUnit);
+        state.vel_z[s] = from_fixed(m_vel_z[s], VelocityUnit);
+        m_loaded = true;
+    }
+}
+
+void Reversible::kick(PhysicsState& state, double time, size_t first, size_t last) {
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        if (!m_floating[s]) {
+            auto vel_x = m_vel_x[s], vel_y = m_vel_y[s], vel_z = m_vel_z[s];
+            if (add_fixed(vel_x, state.acc_x[s] * time, VelocityUnit) && add_fixed(vel_y, state.acc_y[s] * time, VelocityUnit)
+                && add_fixed(vel_z, state.acc_z[s] * time, VelocityUnit)) {
+                m_vel_x[s] = vel_x;
+                m_vel_y[s] = vel_y;
+                m_vel_z[s] = vel_z;
+                state.vel_x[s] = from_fixed(vel_x, VelocityUnit);
+                state.vel_y[s] = from_fixed(vel_y, VelocityUnit);
+                state.vel_z[s] = from_fixed(vel_z, VelocityUnit);
+                continue;
+            }
+            m_floating[s] = 1;
+        }
+        state.vel_x[s] += state.acc_x[s] * time;
+        state.vel_y[s] += state.acc_y[s] * time;
+        state.vel_z[s] += state.acc_z[s] * time;
+    }
+}
+
+void Reversible::drift(PhysicsState& state, double time, size_t first, size_t last) {
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        if (!m_floating[s]) {
+            auto pos_x = m_pos_x[s], pos_y = m_pos_y[s], pos_z = m_pos_z[s];
+            if (add_fixed(pos_x, state.vel_x[s] * time, PositionUnit) && add_fixed(pos_y, state.vel_y[s] * time, PositionUnit)
+                && add_fixed(pos_z, state.vel_z[s] * time, PositionUnit)) {
+                m_pos_x[s] = pos_x;
+                m_pos_y[s] = pos_y;
+                m_pos_z[s] = pos_z;
+                state.pos_x[s] = from_fixed(pos_x, PositionUnit);
+                state.pos_y[s] = from_fixed(pos_y, PositionUnit);
+                state.pos_z[s] = from_fixed(pos_z, PositionUnit);
+                continue;
+            }
+            m_floating[s] = 1;
+        }
+        state.pos_x[s] += state.vel_x[s] * time;
+        state.pos_y[s] += state.vel_y[s] * time;
+        state.pos_z[s] += state.vel_z[s] * time;
+    }
+}
+
+bool Reversible::left_range() const {
+    return std::find(m_floating.begin(), m_floating.end(), 1) != m_floating.end();
+}
+
+void Reversible::erase(size_t index) {
+    if (index >= m_pos_x.size())
+        return;
+    auto erase_at = [index](auto& vector) { vector.erase(vector.begin() + index); };
+    erase_at(m_pos_x);
+    erase_at(m_pos_y);
+    erase_at(m_pos_z);
+    erase_at(m_vel_x);
+    erase_at(m_vel_y);
+    erase_at(m_vel_z);
+    erase_at(m_floating);
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+#include "../ThreadPool.hpp"
+#include "Composition.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Integrator {
+
+// Kick-drift compositions (see Composition.hpp) done in fixed point, so that
+// a tick with a negative length undoes the same tick exactly, bit for bit
+// (Rein & Tamayo 2018, "JANUS").
+//
+// Positions and velocities are kept as integer multiples of PositionUnit and
+// VelocityUnit. Every drift adds vel * time rounded to PositionUnit, and
+// every kick adds acc * time rounded to VelocityUnit. Rounding is symmetric
+// (round(-x) = -round(x)) and the increment of one variable depends only on
+// the other one, so each sub-step is undone exactly by the same sub-step
+// with a negated time. All compositions are symmetric, so the sub-steps of
+// a negative tick are exactly the inverses of the positive one in reverse
+// order. This needs the same forces for the same positions: all gravity
+// solvers are deterministic and don't depend on thread count, but the solver
+// must not change in between.
+//
+// Fixed point limits objects to about +-60000 AU from the origin and speeds
+// to about 8000 km/s, with a resolution of about 1 mm and 1e-12 m/s. Objects
+// that leave the range are advanced in floating point for the rest of the
+// step instead of wrapping around, and left_range() tells the caller to stop
+// using reversible ticks.
+//
+// PhysicsState is kept in sync with the fixed point state, converted to
+// doubles. Objects whose state was modified in between (added, edited by GUI
+// or Python) are rounded to the fixed point grid at the beginning of the
+// next step.
+//
+// https://doi.org/10.1093/mnras/stx2870
+class Reversible {
+public:
+    static constexpr double PositionUnit = 1.0 / (uint64_t(1) << 10);
+    static constexpr double VelocityUnit = 1.0 / (uint64_t(1) << 40);
+
+    // Advances alive objects of the state by `tick` seconds (negative to go
+    // back in time). Must be called by all workers of a job.
+    //
+    // `evaluate_forces` is called by all workers to fill acc_* for the current
+    // positions. The first evaluation is skipped if `forces_are_current` and no
+    // object had to be rounded to the grid.
+    void step(PhysicsState&, Composition const&, double tick, ThreadPool::Worker&, bool forces_are_current,
+        std::function<void()> const& evaluate_forces);
+
+    // Whether any object didn't fit in fixed point during the last step, so
+    // that the step can't be undone exactly.
+    bool left_range() const;
+
+    // Shifts indices like PhysicsState::erase().
+    void erase(size_t index);
+
+private:
+    void load(PhysicsState&);
+    void kick(PhysicsState&, double time, size_t first, size_t last);
+    void drift(PhysicsState&, double time, size_t first, size_t last);
+
+    std::vector<int64_t> m_pos_x, m_pos_y, m_pos_z;
+    std::vector<int64_t> m_vel_x, m_vel_y, m_vel_z;
+
+    // Objects advanced in floating point since they left the range. Only
+    // written by the worker that steps the object.
+    std::vector<uint8_t> m_floating;
+
+    // Whether the last load() rounded any object to the grid.
+    bool m_loaded = false;
+};
+
+}
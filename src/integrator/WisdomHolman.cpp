@@ -0,0 +1,229 @@
+#include "WisdomHolman.hpp"
+
+#include "Kepler.hpp"
+
+#include <cmath>
+
+namespace Integrator {
+
+void WisdomHolman::step(PhysicsState& state, double tick, ThreadPool::Worker& worker, bool forces_are_current, std::function<void()> const& evaluate_forces) {
+    auto const [first, last] = worker.range(state.active.size());
+
+    if (worker.index() == 0)
+        find_central_object(state);
+    if (forces_are_current)
+        worker.sync();
+    else
+        evaluate_forces();
+    if (m_central == PhysicsState::NoObject)
+        return;
+
+    // Nothing attracts anything, just move in straight lines.
+    if (m_central_mass == 0) {
+        for (size_t a = first; a < last; a++) {
+            auto const s = state.active[a];
+            state.pos_x[s] += state.vel_x[s] * tick;
+            state.pos_y[s] += state.vel_y[s] * tick;
+            state.pos_z[s] += state.vel_z[s] * tick;
+        }
+        worker.sync();
+        return;
+    }
+
+    kick(state, tick / 2, first, last);
+    to_heliocentric(state, first, last);
+    worker.sync();
+    if (worker.index() == 0)
+        sum_momentum(state);
+    worker.sync();
+
+    jump(state, tick / 2, first, last);
+    kepler_drift(state, tick, first, last);
+    worker.sync();
+    if (worker.index() == 0)
+        sum_momentum(state);
+    worker.sync();
+
+    jump(state, tick / 2, first, last);
+    worker.sync();
+    if (worker.index() == 0)
+        move_central_object(state, tick);
+    worker.sync();
+
+    to_inertial(state, first, last);
+    evaluate_forces();
+    kick(state, tick / 2, first, last);
+    worker.sync();
+    if (worker.index() == 0)
+        correct_central_velocity(state);
+    worker.sync();
+}
+
+void WisdomHolman::find_central_object(PhysicsState const& state) {
+    m_central = PhysicsState::NoObject;
+    m_central_mass = 0;
+    m_total_mass = 0;
+    Vector mass_pos {};
+    Vector mass_vel {};
+    for (auto const s : state.active) {
+        double const mass = state.gravity_factor[s];
+        if (m_central == PhysicsState::NoObject || mass > m_central_mass) {
+            m_central = s;
+            m_central_mass = mass;
+        }
+        m_total_mass += mass;
+        mass_pos[0] += state.pos_x[s] * mass;
+        mass_pos[1] += state.pos_y[s] * mass;
+        mass_pos[2] += state.pos_z[s] * mass;
+        mass_vel[0] += state.vel_x[s] * mass;
+        mass_vel[1] += state.vel_y[s] * mass;
+        mass_vel[2] += state.vel_z[s] * mass;
+    }
+    if (m_total_mass == 0)
+        return;
+    for (unsigned i = 0; i < 3; i++) {
+        m_center_of_mass[i] = mass_pos[i] / m_total_mass;
+        m_center_of_mass_vel[i] = mass_vel[i] / m_total_mass;
+    }
+}
+
+// Velocity change from all objects except the central one. It is the full
+// acceleration minus the attraction of the central object, which is
+// calculated the same way as gravity solvers do.
+void WisdomHolman::kick(PhysicsState& state, double time, size_t first, size_t last) const {
+    auto const central = m_central;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        if (s == central)
+            continue;
+        double const dist_x = state.pos_x[s] - state.pos_x[central];
+        double const dist_y = state.pos_y[s] - state.pos_y[central];
+        double const dist_z = state.pos_z[s] - state.pos_z[central];
+        double denominator = dist_x * dist_x + dist_y * dist_y + dist_z * dist_z;
+        double central_factor = 0;
+        if (denominator != 0) {
+            denominator *= std::sqrt(denominator);
+            central_factor = m_central_mass / denominator;
+        }
+        state.vel_x[s] += (state.acc_x[s] + dist_x * central_factor) * time;
+        state.vel_y[s] += (state.acc_y[s] + dist_y * central_factor) * time;
+        state.vel_z[s] += (state.acc_z[s] + dist_z * central_factor) * time;
+    }
+}
+
+void WisdomHolman::to_heliocentric(PhysicsState& state, size_t first, size_t last) const {
+    auto const central = m_central;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        if (s == central)
+            continue;
+        state.pos_x[s] -= state.pos_x[central];
+        state.pos_y[s] -= state.pos_y[central];
+        state.pos_z[s] -= state.pos_z[central];
+        state.vel_x[s] -= m_center_of_mass_vel[0];
+        state.vel_y[s] -= m_center_of_mass_vel[1];
+        state.vel_z[s] -= m_center_of_mass_vel[2];
+    }
+}
+
+void WisdomHolman::sum_momentum(PhysicsState const& state) {
+    m_momentum = {};
+    for (auto const s : state.active) {
+        if (s == m_central)
+            continue;
+        double const mass = state.gravity_factor[s];
+        m_momentum[0] += state.vel_x[s] * mass;
+        m_momentum[1] += state.vel_y[s] * mass;
+        m_momentum[2] += state.vel_z[s] * mass;
+    }
+}
+
+// Heliocentric positions change with the velocity of the central object,
+// which is the opposite of the momentum of everything else.
+void WisdomHolman::jump(PhysicsState& state, double time, size_t first, size_t last) const {
+    double const factor = time / m_central_mass;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        if (s == m_central)
+            continue;
+        state.pos_x[s] += m_momentum[0] * factor;
+        state.pos_y[s] += m_momentum[1] * factor;
+        state.pos_z[s] += m_momentum[2] * factor;
+    }
+}
+
+void WisdomHolman::kepler_drift(PhysicsState& state, double time, size_t first, size_t last) const {
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        if (s == m_central)
+            continue;
+        Vector pos { state.pos_x[s], state.pos_y[s], state.pos_z[s] };
+        Vector vel { state.vel_x[s], state.vel_y[s], state.vel_z[s] };
+        Integrator::kepler_drift(m_central_mass, time, pos, vel);
+        state.pos_x[s] = pos[0];
+        state.pos_y[s] = pos[1];
+        state.pos_z[s] = pos[2];
+        state.vel_x[s] = vel[0];
+        state.vel_y[s] = vel[1];
+        state.vel_z[s] = vel[2];
+    }
+}
+
+// The center of mass moves uniformly, and the central object is placed so
+// that it stays the center of mass.
+void WisdomHolman::move_central_object(PhysicsState& state, double time) {
+    Vector mass_pos {};
+    for (auto const s : state.active) {
+        if (s == m_central)
+            continue;
+        double const mass = state.gravity_factor[s];
+        mass_pos[0] += state.pos_x[s] * mass;
+        mass_pos[1] += state.pos_y[s] * mass;
+        mass_pos[2] += state.pos_z[s] * mass;
+    }
+    for (unsigned i = 0; i < 3; i++)
+        m_center_of_mass[i] += m_center_of_mass_vel[i] * time;
+
+    auto const central = m_central;
+    state.pos_x[central] = m_center_of_mass[0] - mass_pos[0] / m_total_mass;
+    state.pos_y[central] = m_center_of_mass[1] - mass_pos[1] / m_total_mass;
+    state.pos_z[central] = m_center_of_mass[2] - mass_pos[2] / m_total_mass;
+    state.vel_x[central] = m_center_of_mass_vel[0] - m_momentum[0] / m_central_mass;
+    state.vel_y[central] = m_center_of_mass_vel[1] - m_momentum[1] / m_central_mass;
+    state.vel_z[central] = m_center_of_mass_vel[2] - m_momentum[2] / m_central_mass;
+}
+
+void WisdomHolman::to_inertial(PhysicsState& state, size_t first, size_t last) const {
+    auto const central = m_central;
+    for (size_t a = first; a < last; a++) {
+        auto const s = state.active[a];
+        if (s == central)
+            continue;
+        state.pos_x[s] += state.pos_x[central];
+        state.pos_y[s] += state.pos_y[central];
+        state.pos_z[s] += state.pos_z[central];
+        state.vel_x[s] += m_center_of_mass_vel[0];
+        state.vel_y[s] += m_center_of_mass_vel[1];
+        state.vel_z[s] += m_center_of_mass_vel[2];
+    }
+}
+
+// Approximate gravity solvers don't conserve momentum exactly, so the
+// central object takes whatever is needed to keep it.
+void WisdomHolman::correct_central_velocity(PhysicsState& state) const {
+    Vector momentum {};
+    for (auto const s : state.active) {
+        if (s == m_central)
+            continue;
+        double const mass = state.gravity_factor[s];
+        momentum[0] += state.vel_x[s] * mass;
+        momentum[1] += state.vel_y[s] * mass;
+        momentum[2] += state.vel_z[s] * mass;
+    }
+    auto const central = m_central;
+    state.vel_x[central] = (m_center_of_mass_vel[0] * m_total_mass - momentum[0]) / m_central_mass;
+    state.vel_y[central] = (m_center_of_mass_vel[1] * m_total_mass - momentum[1]) / m_central_mass;
+    state.vel_z[central] = (m_center_of_mass_vel[2] * m_total_mass - momentum[2]) / m_central_mass;
+}
+
+}
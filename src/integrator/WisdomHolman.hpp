@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../PhysicsState.hpp"
+#include "../ThreadPool.hpp"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+
+namespace Integrator {
+
+// Wisdom-Holman symplectic mapper in democratic heliocentric coordinates
+// (Duncan, Levison & Lee 1998).
+//
+// The motion of every object around the most massive one (the "central"
+// object, e.g. the Sun) is solved exactly as a Kepler orbit, and only the
+// much weaker interactions between the other objects are integrated with
+// kicks:
+//
+//     Kick(tick / 2) Jump(tick / 2) Kepler(tick) Jump(tick / 2) Kick(tick / 2)
+//
+// Positions are heliocentric and velocities barycentric, so no ordering of
+// the objects is needed (unlike Jacobi coordinates), and "Jump" accounts for
+// the motion of the central object. Errors are proportional to the ratio of
+// the interactions to the central attraction, so in systems dominated by one
+// object the tick can be a sizeable fraction of the shortest orbital period.
+// In other systems (binary stars, close encounters) it is worse than Leapfrog.
+//
+// https://ui.adsabs.harvard.edu/abs/1998AJ....116.2067D
+class WisdomHolman {
+public:
+    // Advances alive objects of the state by `tick` seconds (negative to go
+    // back in time). Must be called by all workers of a job.
+    //
+    // `evaluate_forces` is called by all workers to fill acc_* with full
+    // gravity of all objects for the current positions, like a Leapfrog
+    // step does. The attraction of the central object is then subtracted
+    // from it, so any gravity solver can be used. The first evaluation is
+    // skipped if `forces_are_current`. Forces are left evaluated for the
+    // final positions.
+    void step(PhysicsState&, double tick, ThreadPool::Worker&, bool forces_are_current, std::function<void()> const& evaluate_forces);
+
+    // The object that others orbit in the last step(), or NoObject.
+    size_t central_object() const { return m_central; }
+
+private:
+    using Vector = std::array<double, 3>;
+
+    void find_central_object(PhysicsState const&);
+    void kick(PhysicsState&, double time, size_t first, size_t last) const;
+    void to_heliocentric(PhysicsState&, size_t first, size_t last) const;
+    void sum_momentum(PhysicsState const&);
+    void jump(PhysicsState&, double time, size_t first, size_t last) const;
+    void kepler_drift(PhysicsState&, double time, size_t first, size_t last) const;
+    void move_central_object(PhysicsState&, double time);
+    void to_inertial(PhysicsState&, size_t first, size_t last) const;
+    void correct_central_velocity(PhysicsState&) const;
+
+    // Masses are in the units of gravity_factor (G * mass), which cancel out.
+    size_t m_central = PhysicsState::NoObject;
+    double m_central_mass = 0;
+    double m_total_mass = 0;
+    Vector m_center_of_mass {};
+    Vector m_center_of_mass_vel {};
+
+    // Sum of mass * barycentric velocity of all objects but the central one.
+    Vector m_momentum {};
+};
+
+}
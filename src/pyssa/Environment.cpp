@@ -1,5 +1,6 @@
 #include "Environment.hpp"
 
+#include "../SimulationView.hpp"
 #include "../World.hpp"
 #include "Object.hpp"
 #include "TupleParser.hpp"
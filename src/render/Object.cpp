@@ -0,0 +1,138 @@
+// keep first!
+#include <GL/glew.h>
+
+#include "../Object.hpp"
+
+#include "../SimulationView.hpp"
+#include "../World.hpp"
+#include "../glwrapper/Helpers.hpp"
+#include "../glwrapper/Sphere.hpp"
+#include <Essa/GUI/Application.hpp>
+#include <Essa/GUI/Graphics/Drawing/Ellipse.hpp>
+#include <Essa/GUI/Graphics/Painter.hpp>
+#include <Essa/GUI/Graphics/Text.hpp>
+#include <Essa/LLGL/OpenGL/Vertex.hpp>
+
+#include <EssaUtil/Constants.hpp>
+#include <EssaUtil/DelayedInit.hpp>
+#include <EssaUtil/UnitDisplay.hpp>
+
+#include <cmath>
+#include <fmt/format.h>
+#include <sstream>
+#include <vector>
+
+static Util::DelayedInit<Sphere> s_sphere;
+
+Sphere& Object::sphere() {
+    if (!s_sphere.is_initialized()) {
+        s_sphere.construct();
+    }
+
+    return *s_sphere;
+}
+
+void Object::draw(Gfx::Painter& painter, SimulationView const& view) {
+    GUI::WorldDrawScope::verify();
+
+    auto scaled_pos = render_position();
+
+    s_sphere->set_radius(m_radius / Util::Constants::AU);
+    s_sphere->set_position(scaled_pos);
+    s_sphere->set_color(m_color);
+    if (m_world)
+        s_sphere->set_light_position(m_world->light_source() ? Util::Point3d::from_deprecated_vector(m_world->light_source()->pos()) / Util::Constants::AU : Util::Point3d());
+    s_sphere->draw(painter, view);
+
+    if (view.show_trails())
+        m_trail.draw(view);
+}
+
+void Object::draw_closest_approaches(Gfx::Painter& painter, SimulationView const& view) {
+    GUI::WorldDrawScope::verify();
+
+    using Vertex = Essa::Shaders::Basic::Vertex;
+    Essa::Shaders::Basic::Uniforms uniforms;
+    uniforms.set_model(view.matrix().convert<float>());
+
+    std::vector<Vertex> closest_approaches_vertexes;
+    for (auto& closest_approach_entry : m_closest_approaches) {
+        if (closest_approach_entry.second.distance > Util::Constants::AU / 10)
+            continue;
+        closest_approaches_vertexes.push_back(Vertex {
+            Util::Point3f::from_deprecated_vector(closest_approach_entry.second.this_position) / Util::Constants::AU,
+            Util::Color { m_color.r, m_color.g, m_color.b, 100 },
+            {},
+        });
+        Util::Color other_color { closest_approach_entry.first->m_color.r, closest_approach_entry.first->m_color.g, closest_approach_entry.first->m_color.b, 100 };
+        closest_approaches_vertexes.push_back(Vertex {
+            Util::Point3f::from_deprecated_vector(closest_approach_entry.second.other_object_position) / Util::Constants::AU,
+            other_color,
+            {},
+        });
+    }
+    GL::draw_with_temporary_vao<Vertex>(painter.renderer(), view.basic_shader(), uniforms, llgl::PrimitiveType::Lines, closest_approaches_vertexes);
+}
+
+void Object::draw_closest_approaches_gui(Gfx::Painter& painter, SimulationView const& view) {
+    for (auto& closest_approach_entry : m_closest_approaches) {
+        if (closest_approach_entry.second.distance > Util::Constants::AU / 10)
+            continue;
+        auto position = (closest_approach_entry.second.this_position + closest_approach_entry.second.other_object_position) / (2 * Util::Constants::AU);
+        std::ostringstream oss;
+        auto str = Util::unit_display(closest_approach_entry.second.distance, Util::Quantity::Length).to_string();
+        oss << "CA with " << closest_approach_entry.first->name() << ": " << str.encode();
+        draw_label(painter, view, position, Util::UString { oss.str() }, closest_approach_entry.first->m_color);
+    }
+}
+
+void Object::draw_label(Gfx::Painter& painter, SimulationView const& sv, Util::DeprecatedVector3d position, Util::UString string, Util::Color color) const {
+    auto screen_position = sv.world_to_screen(position);
+
+    // Don't draw labels of planets outside of clipping box
+    if (screen_position.z() > 1 || screen_position.z() < -1)
+        return;
+
+    Gfx::Text text { string, GUI::Application::the().bold_font() };
+    text.set_font_size(GUI::Application::the().theme().label_font_size);
+    text.set_fill_color(color);
+    text.set_position({ std::roundf(screen_position.x()), std::roundf(screen_position.y()) });
+    text.draw(painter);
+}
+
+void Object::draw_gui(Gfx::Painter& painter, SimulationView const& view) {
+    if (m_display_lagrange_points) {
+        auto most_attracting_object = this->most_attracting_object();
+        if (!most_attracting_object) {
+            return;
+        }
+        auto diff = most_attracting_object->pos() - pos();
+
+        auto l1_2_dist = diff.length() * std::cbrt(mass() / (3 * most_attracting_object->mass()));
+
+        auto l1 = (pos() + diff.with_length(l1_2_dist)) / Util::Constants::AU;
+        auto l2 = (pos() - diff.with_length(l1_2_dist)) / Util::Constants::AU;
+
+        auto draw_lagrange_point = [&](Util::DeprecatedVector3d position, Util::UString const& label) {
+            draw_label(painter, view, position,
+                Util::UString(fmt::format("{}-{} {}", m_name.encode(), most_attracting_object->name().encode(), label.encode())),
+                Util::Colors::Orange);
+
+            painter.draw(Gfx::Drawing::Ellipse(Util::Point2f::from_deprecated_vector(Util::DeprecatedVector2f(view.world_to_screen(l1))), { 2, 2 },
+                Gfx::Drawing::Fill::solid(Util::Colors::Orange)));
+        };
+
+        painter.draw_line({
+                              Util::Point2f::from_deprecated_vector(Util::DeprecatedVector2f(view.world_to_screen(most_attracting_object->render_position()))),
+                              Util::Point2f::from_deprecated_vector(Util::DeprecatedVector2f(view.world_to_screen(l2))),
+                          },
+            Gfx::LineDrawOptions { .color = Util::Colors::Gray });
+
+        draw_lagrange_point(l1, "L1");
+        draw_lagrange_point(l2, "L2");
+    }
+
+    if (!view.show_labels())
+        return;
+    draw_label(painter, view, render_position(), Util::UString { m_name }, m_is_forward_simulated ? Util::Color { 128, 128, 128 } : Util::Colors::White);
+}
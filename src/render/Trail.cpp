@@ -0,0 +1,37 @@
+// keep first!
+#include <GL/glew.h>
+
+#include "../Trail.hpp"
+
+#include "../SimulationView.hpp"
+#include "../glwrapper/Helpers.hpp"
+
+#include <Essa/Engine/3D/Shaders/Basic.hpp>
+#include <Essa/LLGL/Core/Transform.hpp>
+#include <Essa/LLGL/OpenGL/PrimitiveType.hpp>
+#include <Essa/LLGL/OpenGL/Vertex.hpp>
+#include <Essa/LLGL/OpenGL/VertexArray.hpp>
+#include <EssaUtil/Constants.hpp>
+#include <vector>
+
+void Trail::draw(SimulationView const& sv) const {
+    using Vertex = Essa::Shaders::Basic::Vertex;
+
+    Essa::Shaders::Basic::Uniforms uniforms;
+    uniforms.set_transform(llgl::Transform {}.translate(m_offset.cast<float>() / Util::Constants::AU).matrix(),
+        sv.camera().view_matrix(),
+        sv.projection().matrix());
+
+    std::vector<Vertex> vertexes;
+    vertexes.reserve(m_length);
+    for (size_t s = 0; s < static_cast<size_t>(m_length); s++)
+        vertexes.push_back(Vertex { m_vertexes[s], m_color, {} });
+
+    if (static_cast<size_t>(m_length) != m_vertexes.size()) {
+        GL::draw_with_temporary_vao<Vertex>(sv.renderer(), sv.basic_shader(), uniforms, llgl::PrimitiveType::LineStrip, { vertexes.data() + 1, static_cast<size_t>(m_append_offset - 1) });
+    }
+    else {
+        GL::draw_with_temporary_vao<Vertex>(sv.renderer(), sv.basic_shader(), uniforms, llgl::PrimitiveType::LineStrip, { vertexes.data(), static_cast<size_t>(m_append_offset) });
+        GL::draw_with_temporary_vao<Vertex>(sv.renderer(), sv.basic_shader(), uniforms, llgl::PrimitiveType::LineStrip, { vertexes.data() + m_append_offset, static_cast<size_t>(m_length - m_append_offset) });
+    }
+}
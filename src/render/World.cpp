@@ -0,0 +1,64 @@
+// keep first!
+#include <GL/glew.h>
+
+#include "../World.hpp"
+
+#include "../Object.hpp"
+#include "../SimulationView.hpp"
+#include "../glwrapper/Helpers.hpp"
+
+#include <Essa/Engine/3D/Shaders/Basic.hpp>
+#include <Essa/GUI/Graphics/Painter.hpp>
+#include <Essa/LLGL/Core/Transform.hpp>
+#include <Essa/LLGL/OpenGL/PrimitiveType.hpp>
+#include <EssaUtil/Constants.hpp>
+#include <vector>
+
+void World::draw(Gfx::Painter& painter, SimulationView const& view) const {
+    // Alive flags are updated by the next tick, which doesn't come while
+    // paused, so objects are checked one by one after changes.
+    auto for_each_alive_object = [this](auto callback) {
+        if (!m_alive_flags_valid) {
+            for (auto& p : m_object_list) {
+                if (!p->deleted())
+                    callback(*p);
+            }
+            return;
+        }
+        for (auto const s : m_physics.active)
+            callback(*m_object_list[s]);
+    };
+
+    {
+        GUI::WorldDrawScope scope { painter, GUI::WorldDrawScope::ClearDepth::Yes };
+        for_each_alive_object([&](Object& object) { object.draw(painter, view); });
+        draw_test_particles(view);
+    }
+    for_each_alive_object([&](Object& object) { object.draw_gui(painter, view); });
+}
+
+void World::draw_test_particles(SimulationView const& view) const {
+    using Vertex = Essa::Shaders::Basic::Vertex;
+    auto const& particles = m_test_particles;
+    if (particles.size() == 0)
+        return;
+
+    Essa::Shaders::Basic::Uniforms uniforms;
+    uniforms.set_transform(llgl::Transform {}.matrix(), view.camera().view_matrix(), view.projection().matrix());
+
+    auto& vertices = view.test_particle_vertices();
+    vertices.resize(particles.size());
+    for (size_t p = 0; p < particles.size(); p++) {
+        vertices[p] = Vertex {
+            Util::Point3f::from_deprecated_vector(particles.pos(p) / Util::Constants::AU),
+            particles.color[p],
+            {},
+        };
+    }
+    GL::draw_with_temporary_vao<Vertex>(view.renderer(), view.basic_shader(), uniforms, llgl::PrimitiveType::Points, vertices);
+
+    if (view.show_trails()) {
+        for (auto const& [index, trail] : particles.trails)
+            trail.draw(view);
+    }
+}
@@ -0,0 +1,409 @@
+// Headless simulation: loads a world file, runs it for a given number of
+// ticks without any window and prints the final state and timing. With
+// --replay, prints the states stored in a trajectory file instead.
+
+#include "../History.hpp"
+#include "../Trajectory.hpp"
+#include "../World.hpp"
+#include "../gravity/AccuracyReport.hpp"
+#include "../gravity/Solver.hpp"
+#include "../integrator/Method.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string world_file;
+    int ticks = 1000;
+    std::optional<int> seconds_per_tick;
+    std::optional<Gravity::Solver> gravity_solver;
+    std::optional<Integrator::Method> integrator;
+    std::optional<unsigned> thread_count;
+    std::optional<std::string> output_file;
+    std::optional<std::string> trajectory_file;
+    std::optional<std::string> replay_file;
+    int sample_interval = 1;
+    std::optional<unsigned> history_precision;
+    bool adaptive_tick = false;
+    bool accuracy_report = false;
+    bool check_history = false;
+};
+
+void print_usage() {
+    std::cerr << "Usage: essa-sim <world.essa> [options]\n"
+                 "  --ticks N                Number of ticks to simulate (default: 1000)\n"
+                 "  --seconds-per-tick S     Simulation seconds per tick (default: from the world)\n"
+                 "  --adaptive-tick          Choose tick length from orbital timescales, up to\n"
+                 "                           --seconds-per-tick\n"
+                 "  --gravity-solver NAME    direct, direct_symmetric, barnes_hut or fmm\n"
+                 "  --integrator NAME        leapfrog, yoshida4, yoshida6, forest_ruth,\n"
+                 "                           wisdom_holman, ias15 or hermite\n"
+                 "  --threads N              Number of threads (default: number of CPU cores)\n"
+                 "  --output FILE            Write final state and timing to FILE instead of stdout\n"
+                 "  --trajectory FILE        Record positions and velocities of all objects to\n"
+                 "                           FILE (see src/Trajectory.hpp for the format)\n"
+                 "  --sample-interval N      Ticks between trajectory samples (default: 1)\n"
+                 "  --replay FILE            Print every sample of a trajectory file recorded\n"
+                 "                           from the world instead of simulating\n"
+                 "  --accuracy-report        Print accuracy of gravity solvers for the final state\n"
+                 "  --history-precision N    Mantissa bits kept in compressed history, 1 to 52\n"
+                 "                           (default: 52, lossless)\n"
+                 "  --check-history          After the run, go back through the history and\n"
+                 "                           compare it with the --trajectory file\n";
+}
+
+template<class T>
+std::optional<T> parse_number(std::string_view string) {
+    T value {};
+    auto result = std::from_chars(string.data(), string.data() + string.size(), value);
+    if (result.ec != std::errc {} || result.ptr != string.data() + string.size())
+        return {};
+    return value;
+}
+
+std::optional<Options> parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if (!argument.starts_with("--")) {
+            if (!options.world_file.empty()) {
+                std::cerr << "essa-sim: Only one world file can be given\n";
+                return {};
+            }
+            options.world_file = argument;
+            continue;
+        }
+
+        if (argument == "--adaptive-tick") {
+            options.adaptive_tick = true;
+            continue;
+        }
+        if (argument == "--accuracy-report") {
+            options.accuracy_report = true;
+            continue;
+        }
+        if (argument == "--check-history") {
+            options.check_history = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "essa-sim: Missing value for " << argument << "\n";
+            return {};
+        }
+        std::string_view value = argv[++i];
+
+        auto invalid_value = [&]() -> std::optional<Options> {
+            std::cerr << "essa-sim: Invalid value for " << argument << ": '" << value << "'\n";
+            return {};
+        };
+
+        if (argument == "--ticks") {
+            auto ticks = parse_number<int>(value);
+            if (!ticks || *ticks <= 0)
+                return invalid_value();
+            options.ticks = *ticks;
+        }
+        else if (argument == "--seconds-per-tick") {
+            auto seconds = parse_number<int>(value);
+            if (!seconds || *seconds <= 0)
+                return invalid_value();
+            options.seconds_per_tick = *seconds;
+        }
+        else if (argument == "--gravity-solver") {
+            options.gravity_solver = Gravity::solver_from_string(value);
+            if (!options.gravity_solver)
+                return invalid_value();
+        }
+        else if (argument == "--integrator") {
+            options.integrator = Integrator::method_from_string(value);
+            if (!options.integrator)
+                return invalid_value();
+        }
+        else if (argument == "--threads") {
+            options.thread_count = parse_number<unsigned>(value);
+            if (!options.thread_count || *options.thread_count == 0)
+                return invalid_value();
+        }
+        else if (argument == "--output") {
+            options.output_file = value;
+        }
+        else if (argument == "--trajectory") {
+            options.trajectory_file = value;
+        }
+        else if (argument == "--history-precision") {
+            options.history_precision = parse_number<unsigned>(value);
+            if (!options.history_precision || *options.history_precision == 0 || *options.history_precision > History::LosslessPrecision)
+                return invalid_value();
+        }
+        else if (argument == "--replay") {
+            options.replay_file = value;
+        }
+        else if (argument == "--sample-interval") {
+            auto interval = parse_number<int>(value);
+            if (!interval || *interval <= 0)
+                return invalid_value();
+            options.sample_interval = *interval;
+        }
+        else {
+            std::cerr << "essa-sim: Unknown option " << argument << "\n";
+            return {};
+        }
+    }
+
+    if (options.world_file.empty()) {
+        std::cerr << "essa-sim: No world file given\n";
+        return {};
+    }
+    if (options.replay_file && options.trajectory_file) {
+        std::cerr << "essa-sim: --replay and --trajectory can't be used together\n";
+        return {};
+    }
+    if (options.check_history && !options.trajectory_file) {
+        std::cerr << "essa-sim: --check-history needs --trajectory\n";
+        return {};
+    }
+    return options;
+}
+
+constexpr char const* ObjectColumns = "# name pos_x pos_y pos_z vel_x vel_y vel_z mass (SI units)\n";
+
+void print_object(std::ostream& out, Object const& object) {
+    auto pos = object.pos();
+    auto vel = object.vel();
+    out << fmt::format("{} {:.17g} {:.17g} {:.17g} {:.17g} {:.17g} {:.17g} {:.17g}\n",
+        object.name().encode(), pos.x(), pos.y(), pos.z(), vel.x(), vel.y(), vel.z(), object.mass());
+}
+
+void print_state(std::ostream& out, World& world) {
+    out << "# date " << world.date() << "\n";
+    out << ObjectColumns;
+    world.for_each_object([&out](Object& object) {
+        if (!object.deleted())
+            print_object(out, object);
+    });
+    if (world.test_particles().size() > 0)
+        out << "# " << world.test_particles().size() << " test particles\n";
+}
+
+void print_os_error(Util::OsError const& error) {
+    std::cerr << "essa-sim: Failed to write trajectory: " << error.function << ": " << strerror(error.error) << "\n";
+}
+
+// Runs the world, appending a sample every `sample_interval` ticks and after
+// the last tick.
+bool run_with_trajectory(World& world, Options const& options) {
+    auto maybe_writer = Trajectory::Writer::create(*options.trajectory_file, world, options.sample_interval);
+    if (maybe_writer.is_error()) {
+        std::visit(print_os_error, maybe_writer.release_error_variant());
+        return false;
+    }
+    auto writer = maybe_writer.release_value();
+
+    auto append = [&]() {
+        auto result = writer.append(world);
+        if (result.is_error()) {
+            std::visit(print_os_error, result.release_error_variant());
+            return false;
+        }
+        return true;
+    };
+
+    if (!append())
+        return false;
+    for (int done = 0; done < options.ticks;) {
+        auto const ticks = std::min(options.sample_interval, options.ticks - done);
+        world.update(ticks);
+        done += ticks;
+        if (!append())
+            return false;
+    }
+
+    auto result = writer.close();
+    if (result.is_error()) {
+        std::visit(print_os_error, result.release_error_variant());
+        return false;
+    }
+    return true;
+}
+
+std::optional<Trajectory::Reader> open_trajectory(std::string const& path) {
+    auto maybe_reader = Trajectory::Reader::open(path);
+    if (maybe_reader.is_error()) {
+        std::visit(
+            Util::Overloaded {
+                [&](Util::ParseError const& error) {
+                    std::cerr << "essa-sim: Failed to read " << path << ": " << error.message << "\n";
+                },
+                [&](Util::OsError const& error) {
+                    std::cerr << "essa-sim: Failed to read " << path << ": " << error.function << ": " << strerror(error.error) << "\n";
+                },
+            },
+            maybe_reader.release_error_variant());
+        return {};
+    }
+    return maybe_reader.release_value();
+}
+
+// Moves the objects to every sample of the file in turn and prints the ones
+// that existed at its date. Objects are matched by id, so the world file
+// must be the one the trajectory was recorded from; objects added after
+// loading it are not in the world and are skipped.
+bool replay(World& world, std::string const& path, std::ostream& out) {
+    auto reader = open_trajectory(path);
+    if (!reader)
+        return false;
+
+    auto const& entries = reader->objects();
+    std::vector<Object*> objects;
+    for (auto const& entry : entries) {
+        auto* object = world.get_object_by_id(entry.id);
+        if (!object)
+            std::cerr << "essa-sim: Object " << entry.id << " (" << entry.name << ") of " << path << " is not in the world, skipping it\n";
+        objects.push_back(object);
+    }
+
+    for (size_t s = 0; s < reader->sample_count(); s++) {
+        auto sample = reader->sample(s);
+        world.show_trajectory_sample(entries, sample);
+        out << "# tick " << sample.tick << ", date " << sample.date << "\n";
+        out << ObjectColumns;
+        for (size_t o = 0; o < objects.size(); o++) {
+            if (objects[o] && !std::isnan(sample.bodies[o].pos[0]))
+                print_object(out, *objects[o]);
+        }
+    }
+    return true;
+}
+
+// Goes back through the history recorded during the run and compares every
+// sampled tick with the trajectory file: lossless history must restore the
+// states exactly, and reduced precision within its relative error. An object
+// is added and the first one removed before, so that compressed chunks are
+// extended and cut like when objects are edited in the GUI.
+bool check_history(World& world, std::string const& path, std::ostream& out) {
+    auto reader = open_trajectory(path);
+    if (!reader)
+        return false;
+    if (world.history_size() == 0) {
+        std::cerr << "essa-sim: No history was recorded, ticks are reversible\n";
+        return false;
+    }
+
+    world.add_object(std::make_unique<Object>(1, 1, Util::DeprecatedVector3d { 1e15, 0, 0 }, Util::DeprecatedVector3d {}, Util::Colors::White, "History check", 0));
+    world.delete_object_by_ptr(world.object_at(0));
+
+    auto const precision = world.history_precision();
+    double const allowed_error = precision == History::LosslessPrecision ? 0 : std::ldexp(1.0, -static_cast<int>(precision));
+    double max_error = 0;
+    size_t checked = 0;
+    auto const& entries = reader->objects();
+    while (world.history_size() > 0) {
+        world.update(-1);
+        auto index = reader->find_sample(world.tick());
+        if (!index || reader->sample(*index).tick != world.tick())
+            continue;
+        auto sample = reader->sample(*index);
+        for (size_t o = 0; o < entries.size(); o++) {
+            auto const* object = world.get_object_by_id(entries[o].id);
+            auto const& body = sample.bodies[o];
+            if (!object || std::isnan(body.pos[0]))
+                continue;
+            auto const pos = object->pos();
+            auto const vel = object->vel();
+            double const restored[] { pos.x(), pos.y(), pos.z(), vel.x(), vel.y(), vel.z() };
+            double const recorded[] { body.pos[0], body.pos[1], body.pos[2], body.vel[0], body.vel[1], body.vel[2] };
+            for (size_t c = 0; c < 6; c++) {
+                if (restored[c] != recorded[c])
+                    max_error = std::max(max_error, std::abs(restored[c] - recorded[c]) / std::max(std::abs(restored[c]), std::abs(recorded[c])));
+            }
+        }
+        checked++;
+    }
+
+    out << fmt::format("# history check: {} ticks, max relative error {:g} (allowed {:g})\n", checked, max_error, allowed_error);
+    if (checked == 0 || max_error > allowed_error) {
+        std::cerr << "essa-sim: History check failed\n";
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    auto options = parse_options(argc, argv);
+    if (!options) {
+        print_usage();
+        return 1;
+    }
+
+    World world;
+    if (!world.reset(options->world_file))
+        return 1;
+
+    if (options->seconds_per_tick)
+        world.set_simulation_seconds_per_tick(*options->seconds_per_tick);
+    if (options->adaptive_tick)
+        world.set_adaptive_tick(true);
+    if (options->gravity_solver)
+        world.set_gravity_solver(*options->gravity_solver);
+    if (options->integrator)
+        world.set_integrator(*options->integrator);
+    if (options->thread_count)
+        world.set_thread_count(*options->thread_count);
+    if (options->history_precision)
+        world.set_history_precision(*options->history_precision);
+
+    std::ofstream output_file;
+    if (options->output_file) {
+        output_file.open(*options->output_file);
+        if (!output_file) {
+            std::cerr << "essa-sim: Failed to open " << *options->output_file << " for writing\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options->output_file ? output_file : std::cout;
+
+    if (options->replay_file)
+        return replay(world, *options->replay_file, out) ? 0 : 1;
+
+    auto start = std::chrono::steady_clock::now();
+    if (options->trajectory_file) {
+        if (!run_with_trajectory(world, *options))
+            return 1;
+    }
+    else {
+        world.update(options->ticks);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    print_state(out, world);
+    auto tick_description = world.adaptive_tick()
+        ? fmt::format("adaptive ticks of up to {} s (last {} s)", world.simulation_seconds_per_tick(), world.tick_length())
+        : fmt::format("ticks of {} s", world.simulation_seconds_per_tick());
+    out << fmt::format("# {} {}, integrator {}, gravity solver {}, {} threads: {:.3f} s ({:.3f} ms/tick)\n",
+        options->ticks, tick_description, Integrator::method_to_string(world.integrator()),
+        Gravity::solver_to_string(world.gravity_solver()), world.thread_count(),
+        seconds, seconds * 1000 / options->ticks);
+
+    if (options->accuracy_report)
+        Gravity::print_accuracy_report(world.gravity_accuracy_report());
+    if (options->check_history && !check_history(world, *options->trajectory_file, out))
+        return 1;
+    return 0;
+}
@@ -1,51 +1,65 @@
-import math
 import matplotlib.pyplot as plt
 import numpy as np
-import re
 
-def load_file(filename, planet):
-    file1 = open(filename, "r")
+# Trajectory files written by `essa-sim --trajectory`, see src/Trajectory.hpp.
+header_dtype = np.dtype([
+    ("magic", "S8"),
+    ("version", "<u4"),
+    ("header_size", "<u4"),
+    ("object_count", "<u8"),
+    ("sample_size", "<u8"),
+    ("sample_count", "<u8"),
+    ("sample_interval", "<i8"),
+    ("reserved", "V16"),
+])
+
+object_dtype = np.dtype([
+    ("name", "S64"),
+    ("mass", "<f8"),
+    ("radius", "<f8"),
+    ("color", "u1", 4),
+    ("reserved", "V4"),
+    ("id", "<u8"),
+])
+
+body_dtype = np.dtype([
+    ("pos", "<f8", 3),
+    ("vel", "<f8", 3),
+])
 
-    positionsx = {}
-    positionsy = {}
-    velocities = {}
+def load_trajectory(filename):
+    header = np.fromfile(filename, dtype = header_dtype, count = 1)[0]
+    if header["magic"] != b"ESSATRAJ" or header["version"] not in (1, 2):
+        raise ValueError(f"{filename} is not a trajectory file")
 
-    while True:
-        line = file1.readline()
-        if not line:
-            break
-        data = re.findall(r"(\d+);(Sun[12]);\(([^,]+), ([^,]+), [^,]+, 1\);\(([^,]+), ([^,]+), [^,]+, 1\)", line)
-        # print(line, "TEST", data)
-        if len(data) == 0:
-            continue
-        # print(data[0])
-        entry = data[0]
-        time = float(entry[0])
-        name = entry[1]
-        posx = float(entry[2])
-        posy = float(entry[3])
-        velx = float(entry[4])
-        vely = float(entry[5])
-        pos = math.hypot(posx, posy)
-        vel = math.hypot(velx, vely)
+    object_count = int(header["object_count"])
+    objects = np.memmap(filename, dtype = object_dtype, mode = "r", offset = header_dtype.itemsize, shape = (object_count,))
+    sample_dtype = np.dtype([
+        ("tick", "<i8"),
+        ("date", "<i8"),
+        ("bodies", body_dtype, (object_count,)),
+    ])
+    assert sample_dtype.itemsize == header["sample_size"]
+    samples = np.memmap(filename, dtype = sample_dtype, mode = "r", offset = int(header["header_size"]), shape = (int(header["sample_count"]),))
+    return objects, samples
+
+def load_file(filename, planet):
+    objects, samples = load_trajectory(filename)
+    index = list(objects["name"]).index(planet.encode())
+    bodies = samples["bodies"][:, index]
+    velocities = np.hypot(bodies["vel"][:, 0], bodies["vel"][:, 1])
 
-        if name != planet:
-            continue
-        positionsx[time] = posx / 1000000
-        positionsy[time] = posy / 1000000
-        velocities[time] = vel
-    
-    #if (filename == "data-10.txt"):
-        #plt.plot(positionsx.keys(), positionsx.values(), label = planet + " " + filename + " posx")
-        #plt.plot(positionsy.keys(), positionsy.values(), label = planet + " " + filename + " posy")
-        #plt.plot(velocities.keys(), velocities.values(), label = planet + " " + filename + " vel")
-    return velocities
+    #if (filename == "data-10.traj"):
+        #plt.plot(samples["date"], bodies["pos"][:, 0] / 1000000, label = planet + " " + filename + " posx")
+        #plt.plot(samples["date"], bodies["pos"][:, 1] / 1000000, label = planet + " " + filename + " posy")
+        #plt.plot(samples["date"], velocities, label = planet + " " + filename + " vel")
+    return dict(zip(samples["date"].tolist(), velocities.tolist()))
 
-def load_data(idx, planet):
-    v1 = load_file(f"data-10{idx}.txt", planet)
-    #v2 = load_file(f"data-600{idx}.txt", planet)
-    v3 = load_file(f"data-15000{idx}.txt", planet)
-    #v4 = load_file("data-60000.txt")
+def load_data(planet):
+    v1 = load_file(f"data-10.traj", planet)
+    #v2 = load_file(f"data-600.traj", planet)
+    v3 = load_file(f"data-15000.traj", planet)
+    #v4 = load_file("data-60000.traj")
 
     def add_diff(v1, v2):
         vdiff = {}
@@ -64,8 +78,7 @@ def load_data(idx, planet):
     #add_diff(v2, v3)
     #add_diff(v3, v4)
 
-#load_data("", "Sun1")
-load_data("-small", "Sun1")
+load_data("Sun1")
 
 plt.legend()
 plt.show()
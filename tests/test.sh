@@ -4,11 +4,25 @@ pushd ../build
 ninja
 popd
 
+# Runs 2body for 50 days, sampling every 15000 s where the tick allows it,
+# so that analyze.py can compare the same dates.
 function tst() {
-    SS=$1 ../build/out 2>data-$1-small.txt
+    ../build/essa-sim ../worlds/2body.essa --seconds-per-tick $1 --ticks $((50 * 86400 / $1)) \
+        --trajectory data-$1.traj --sample-interval $(($1 < 15000 ? 15000 / $1 : 1))
 }
 
 tst 10
 tst 600
 tst 15000
 tst 60000
+
+# Goes back through the compressed history of a run and compares it with the
+# trajectory, see --check-history.
+function check_history() {
+    ../build/essa-sim ../worlds/$1.essa --ticks 2000 --trajectory history-$1.traj --check-history --history-precision $2 || exit 1
+}
+
+check_history 2body 52
+check_history solar 52
+check_history solar 20
+check_history 8body 8